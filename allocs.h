@@ -0,0 +1,26 @@
+// allocation accounting: `make platformertrack` force-includes this into every file (the game & the gfx code),
+// so every malloc/calloc/realloc/free & SDL surface goes through the tracking functions in platformer.c
+#ifdef TRACK_ALLOCS
+#ifndef ALLOCS_H
+#define ALLOCS_H
+
+#include <stdlib.h>
+#include "SDL.h"
+
+void* trackedMalloc(size_t num_bytes, char* file, int line);
+void* trackedCalloc(size_t num, size_t size, char* file, int line);
+void* trackedRealloc(void* ptr, size_t num_bytes, char* file, int line);
+void trackedFree(void* ptr);
+SDL_Surface* trackedSurface(SDL_Surface* surface, char* file, int line);
+
+#define malloc(num_bytes) trackedMalloc(num_bytes, __FILE__, __LINE__)
+#define calloc(num, size) trackedCalloc(num, size, __FILE__, __LINE__)
+#define realloc(ptr, num_bytes) trackedRealloc(ptr, num_bytes, __FILE__, __LINE__)
+#define free(ptr) trackedFree(ptr)
+
+// SDL allocates surfaces itself, so they're only counted (not in the live/peak bytes)
+#define SDL_CreateRGBSurface(flags, w, h, depth, r_mask, g_mask, b_mask, a_mask) \
+  trackedSurface(SDL_CreateRGBSurface(flags, w, h, depth, r_mask, g_mask, b_mask, a_mask), __FILE__, __LINE__)
+
+#endif
+#endif
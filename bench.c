@@ -0,0 +1,432 @@
+// benchmarks for the game's internals, built & run w/ `make bench` (`./bench <name>` runs just the benchmarks w/ <name> in their name)
+// includes the game & the gfx code, so it measures the real code (minus main()) & can count their allocations
+// results are CSV on stdout, one row per benchmark, w/ anything that doesn't fit a row as a # comment
+#include <stdlib.h>
+
+// count allocations made by the game & the gfx code (SDL's own aren't counted)
+long long bench_allocs;
+
+void* benchMalloc(size_t num_bytes) {
+  bench_allocs++;
+  return malloc(num_bytes);
+}
+
+void* benchCalloc(size_t num, size_t size) {
+  bench_allocs++;
+  return calloc(num, size);
+}
+
+void* benchRealloc(void* ptr, size_t num_bytes) {
+  bench_allocs++;
+  return realloc(ptr, num_bytes);
+}
+
+#define malloc benchMalloc
+#define calloc benchCalloc
+#define realloc benchRealloc
+
+#define PLATFORMER_NO_MAIN
+#include "platformer.c"
+#include "SDL2_gfxPrimitives.c"
+#include "SDL2_rotozoom.c"
+#include "stress.c"
+
+// fixed seeds, so every run measures the same levels
+#define BENCH_SEED 1529597895u
+
+int bench_sink; // results benchmarks add in, so the compiler can't skip computing them
+
+double benchSeconds(Uint64 start) {
+  return (SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+}
+
+// each benchmark repeats its op until it's been at it for BENCH_SECS, so the numbers are stable:
+// benchStart(); do { <op>; ops++; } while (benchMore()); benchReport(...);
+#define BENCH_SECS 0.25
+
+char* bench_filter = "";
+Uint64 bench_start;
+long long bench_start_allocs;
+
+bool benchWanted(char* name) {
+  return strstr(name, bench_filter) != NULL;
+}
+
+void benchStart() {
+  bench_start_allocs = bench_allocs;
+  bench_start = SDL_GetPerformanceCounter();
+}
+
+bool benchMore() {
+  return benchSeconds(bench_start) < BENCH_SECS;
+}
+
+// bytes_per_op is for throughput benchmarks (0 otherwise)
+void benchReport(char* name, int num_entities, long long ops, size_t bytes_per_op) {
+  double secs = benchSeconds(bench_start);
+  printf("%s,%d,%lld,%.1f,%.0f,%.3f,%.1f\n", name, num_entities, ops, secs * 1e9 / ops, ops / secs,
+    (double)(bench_allocs - bench_start_allocs) / ops, bytes_per_op * ops / 1e6 / secs);
+}
+
+// the level serialized chunk by chunk (the same records saveLevel() writes), chunk c's bytes are bench_chunk_bytes[c] to [c + 1]
+byte* bench_raw;
+size_t* bench_chunk_bytes;
+int* bench_chunk_entities;
+
+void benchSerialize() {
+  free(bench_raw);
+  free(bench_chunk_bytes);
+  free(bench_chunk_entities);
+
+  int num_chunks = chunks_w * chunks_h;
+  bench_chunk_bytes = (size_t*)calloc(num_chunks + 1, sizeof(size_t));
+  bench_chunk_entities = (int*)calloc(num_chunks, sizeof(int));
+  for (int i = 0; i < len_entities; ++i) {
+    int c = chunkIndexAt(entities[i].x, entities[i].y);
+    bench_chunk_bytes[c + 1] += entityBytes(&entities[i]);
+    bench_chunk_entities[c]++;
+  }
+  for (int c = 0; c < num_chunks; ++c)
+    bench_chunk_bytes[c + 1] += bench_chunk_bytes[c];
+
+  bench_raw = (byte*)malloc(bench_chunk_bytes[num_chunks]);
+  size_t* ends = (size_t*)malloc(num_chunks * sizeof(size_t));
+  memcpy(ends, bench_chunk_bytes, num_chunks * sizeof(size_t));
+  for (int i = 0; i < len_entities; ++i) {
+    int c = chunkIndexAt(entities[i].x, entities[i].y);
+    ends[c] = (byte*)writeEntity(bench_raw + ends[c], &entities[i]) - bench_raw;
+  }
+  free(ends);
+}
+
+// compress & decompress each chunk on its own, like writeLevel() & readChunkBytes() do (an op is the whole level)
+void benchCompression(int num_entities) {
+  stressLevel(num_entities, BENCH_SEED);
+  benchSerialize();
+
+  int num_chunks = chunks_w * chunks_h;
+  size_t* chunk_bytes = bench_chunk_bytes;
+  size_t raw_len = chunk_bytes[num_chunks];
+  byte* packed = (byte*)malloc(lzBound(raw_len) + num_chunks * 16);
+  size_t* packed_starts = (size_t*)malloc((num_chunks + 1) * sizeof(size_t));
+  long long ops = 0;
+  benchStart();
+  do {
+    packed_starts[0] = 0;
+    for (int c = 0; c < num_chunks; ++c)
+      packed_starts[c + 1] = packed_starts[c] + lzCompress(bench_raw + chunk_bytes[c], chunk_bytes[c + 1] - chunk_bytes[c], packed + packed_starts[c]);
+    ops++;
+  } while (benchMore());
+  benchReport("lzCompress", len_entities, ops, raw_len);
+
+  byte* unpacked = (byte*)malloc(raw_len);
+  ops = 0;
+  benchStart();
+  do {
+    for (int c = 0; c < num_chunks; ++c) {
+      size_t num_bytes = chunk_bytes[c + 1] - chunk_bytes[c];
+      if (lzDecompress(packed + packed_starts[c], packed_starts[c + 1] - packed_starts[c], unpacked + chunk_bytes[c], num_bytes) != num_bytes)
+        error("benchmark decompressing chunk");
+    }
+    ops++;
+  } while (benchMore());
+  benchReport("lzDecompress", len_entities, ops, raw_len);
+
+  if (memcmp(bench_raw, unpacked, raw_len))
+    error("benchmark roundtrip");
+  printf("# %d entities: %.1f MB in %d chunks compresses to %.1f MB (%.1fx)\n",
+    len_entities, raw_len / 1e6, num_chunks, packed_starts[num_chunks] / 1e6, (double)raw_len / packed_starts[num_chunks]);
+
+  free(packed);
+  free(packed_starts);
+  free(unpacked);
+}
+
+// validating every chunk vs. reading every chunk's entities (what readChunk() does after validating), an op is the whole level
+void benchValidation(int num_entities) {
+  stressLevel(num_entities, BENCH_SEED);
+  benchSerialize();
+
+  int num_chunks = chunks_w * chunks_h;
+  size_t raw_len = bench_chunk_bytes[num_chunks];
+  long long ops = 0;
+  benchStart();
+  do {
+    for (int c = 0; c < num_chunks; ++c)
+      if (!validChunk(bench_raw + bench_chunk_bytes[c], bench_chunk_bytes[c + 1] - bench_chunk_bytes[c], bench_chunk_entities[c]))
+        error("benchmark validating chunk");
+    ops++;
+  } while (benchMore());
+  double validate_secs = benchSeconds(bench_start) / ops;
+  benchReport("validChunk", len_entities, ops, raw_len);
+
+  Entity* chunk_entities = (Entity*)malloc((len_entities + 1) * sizeof(Entity));
+  ops = 0;
+  benchStart();
+  do {
+    for (int c = 0; c < num_chunks; ++c) {
+      void* buffer_ix = bench_raw + bench_chunk_bytes[c];
+      for (int i = 0; i < bench_chunk_entities[c]; ++i)
+        buffer_ix = readEntity(buffer_ix, &chunk_entities[i]);
+      for (int i = 0; i < bench_chunk_entities[c]; ++i)
+        freeEntity(&chunk_entities[i]);
+    }
+    ops++;
+  } while (benchMore());
+  double read_secs = benchSeconds(bench_start) / ops;
+  benchReport("readEntity", len_entities, ops, raw_len);
+  free(chunk_entities);
+
+  printf("# %d entities: validation adds %.1f%% to reading chunks\n", len_entities, validate_secs / read_secs * 100);
+}
+
+// collision queries at random spots in the level (the player & enemies make several of these per frame)
+void benchCollides(int num_entities) {
+  stressLevel(num_entities, BENCH_SEED);
+
+  #define NUM_QUERIES 1024
+  int query_x[NUM_QUERIES];
+  int query_y[NUM_QUERIES];
+  for (int i = 0; i < NUM_QUERIES; ++i) {
+    // near the ground, where the player & enemies are
+    query_x[i] = stressRand() % level_w;
+    query_y[i] = level_h - stressRand() % (grid_size * 40);
+  }
+
+  long long ops = 0;
+  benchStart();
+  do {
+    int i = ops % NUM_QUERIES;
+    bench_sink += collides(query_x[i], query_y[i], 10, 10, -1, entities, WALL);
+    ops++;
+  } while (ops % 16 || benchMore());
+  benchReport("collides", len_entities, ops, 0);
+}
+
+// painting tiles: strokes across the empty sky, each cell looked up first like the editor does (an op's a tile painted or erased)
+void benchPaintStroke(int num_entities) {
+  stressLevel(num_entities, BENCH_SEED);
+  tile_mode = true;
+  tile_tool = TOOL_PAINT;
+  mode_type = WALL;
+
+  #define STROKE_TILES 64
+  int y = 10 * grid_size; // (well above the ground & the platforms)
+  long long ops = 0;
+  benchStart();
+  do {
+    // paint a row, then drag back over it from its first tile, which erases it
+    int x = stressRand() % (level_w / grid_size - STROKE_TILES) * grid_size;
+    for (int erase = 0; erase < 2; ++erase) {
+      edit(EDIT_PRESS, x, y);
+      for (int i = 1; i < STROKE_TILES; ++i)
+        edit(EDIT_DRAG, x + i * grid_size, y);
+      edit(EDIT_RELEASE, 0, 0);
+    }
+    ops += STROKE_TILES * 2;
+  } while (benchMore());
+  benchReport("paintStroke", len_entities, ops, 0);
+  freeUndo();
+}
+
+// a tick's enemy step on an enemy-heavy level, w/ more & more workers (each count's a row, stepEnemies_<n>w)
+void benchStepEnemies(int num_entities) {
+  StressMix mix = stress_mix;
+  stress_mix.enemies = 2;
+
+  int max_workers = SDL_GetCPUCount() - 1;
+  double serial_ns = 0;
+  for (int workers = 0; workers <= max_workers && workers <= MAX_WORKERS; workers = workers ? workers * 2 : 1) {
+    stopJobs();
+    num_workers = workers;
+    startJobs();
+    stressLevel(num_entities, BENCH_SEED); // (the enemies have moved, so each count starts over)
+
+    long long ops = 0;
+    benchStart();
+    do {
+      stepEnemies();
+      ops++;
+    } while (benchMore());
+    double ns = benchSeconds(bench_start) * 1e9 / ops;
+    if (!workers)
+      serial_ns = ns;
+
+    char name[32];
+    snprintf(name, sizeof(name), "stepEnemies_%dw", workers);
+    benchReport(name, len_entities, ops, 0);
+    if (workers)
+      printf("# %d entities: %d workers step enemies %.2fx as fast as none\n", len_entities, workers, serial_ns / ns);
+  }
+
+  stopJobs();
+  num_workers = -1;
+  stress_mix = mix;
+}
+
+SDL_Surface* bench_target;
+SDL_Renderer* bench_renderer;
+
+// a whole frame's worth of entities, culled & drawn the way the game does, from random spots in the level
+void benchRenderEntities(int num_entities) {
+  stressLevel(num_entities, BENCH_SEED);
+
+  long long ops = 0;
+  benchStart();
+  do {
+    vp.x = stressRand() % (level_w - vp.w);
+    vp.y = level_h - vp.h;
+    renderEntities(bench_renderer);
+    ops++;
+  } while (benchMore());
+  benchReport("renderEntities", len_entities, ops, 0);
+}
+
+// the drawing kernels the game leans on, each w/ fixed inputs
+void benchRasterization() {
+  short tile_x[5];
+  short tile_y[5];
+  Shape tile = { .x = tile_x, .y = tile_y };
+  addRectPoints(&tile, 0, 0, grid_size, grid_size);
+
+  short freehand_x[48];
+  short freehand_y[48];
+  stress_rng = BENCH_SEED;
+  for (int i = 0; i < 48; ++i) {
+    // a wobbly circle, like a hand-drawn blob
+    float angle = i * 2 * M_PI / 48;
+    float radius = 50 + stressRand() % 20;
+    freehand_x[i] = 60 + radius * cos(angle);
+    freehand_y[i] = 60 + radius * sin(angle);
+  }
+
+  long long ops = 0;
+  if (benchWanted("filledPolygonRGBAMT_tile")) {
+    benchStart();
+    do {
+      filledPolygonRGBAMT(bench_renderer, ops % 1000, ops % 500, tile_x, tile_y, 5, 0x5b, 0x6e, 0xe1, 0xff, NULL, NULL);
+      ops++;
+    } while (benchMore());
+    benchReport("filledPolygonRGBAMT_tile", 0, ops, 0);
+  }
+
+  if (benchWanted("filledPolygonRGBAMT_freehand")) {
+    ops = 0;
+    benchStart();
+    do {
+      filledPolygonRGBAMT(bench_renderer, ops % 1000, ops % 500, freehand_x, freehand_y, 48, 0x5b, 0x6e, 0xe1, 0xff, NULL, NULL);
+      ops++;
+    } while (benchMore());
+    benchReport("filledPolygonRGBAMT_freehand", 0, ops, 0);
+  }
+
+  if (benchWanted("_aalineRGBA")) {
+    ops = 0;
+    benchStart();
+    do {
+      int x = ops % 1000;
+      int y = ops % 500;
+      _aalineRGBA(bench_renderer, x, y, x + 30, y + 17, 0x5b, 0x6e, 0xe1, 0xff, 1);
+      ops++;
+    } while (benchMore());
+    benchReport("_aalineRGBA", 0, ops, 0);
+  }
+
+  if (benchWanted("render_text")) {
+    ops = 0;
+    benchStart();
+    do {
+      render_text(bench_renderer, "Saved 1234567890", ops % 1000, ops % 500, 2);
+      ops++;
+    } while (benchMore());
+    benchReport("render_text", 0, ops, 0);
+  }
+
+  if (benchWanted("characterRGBA")) {
+    ops = 0;
+    benchStart();
+    do {
+      characterRGBA(bench_renderer, ops % 1000, ops % 500, 'A' + ops % 26, 0xff, 0xff, 0xff, 0xff);
+      ops++;
+    } while (benchMore());
+    benchReport("characterRGBA", 0, ops, 0);
+  }
+}
+
+void benchZoom() {
+  SDL_Surface* src = SDL_CreateRGBSurface(0, 256, 256, 32, 0xff, 0xff00, 0xff0000, 0xff000000);
+  if (!src)
+    error("creating benchmark surface");
+  stress_rng = BENCH_SEED;
+  for (int i = 0; i < 256 * 256; ++i)
+    ((Uint32*)src->pixels)[i] = colors[stressRand() % 32];
+
+  long long ops = 0;
+  if (benchWanted("zoomSurface")) {
+    benchStart();
+    do {
+      SDL_FreeSurface(zoomSurface(src, 2, 2, SMOOTHING_ON));
+      ops++;
+    } while (benchMore());
+    benchReport("zoomSurface", 0, ops, 0);
+  }
+
+  if (benchWanted("rotozoomSurface")) {
+    ops = 0;
+    benchStart();
+    do {
+      SDL_FreeSurface(rotozoomSurface(src, 30, 1, SMOOTHING_ON));
+      ops++;
+    } while (benchMore());
+    benchReport("rotozoomSurface", 0, ops, 0);
+  }
+
+  SDL_FreeSurface(src);
+}
+
+int main(int num_args, char* args[]) {
+  if (num_args > 1)
+    bench_filter = args[1];
+
+  // draw into memory, so results don't depend on the GPU or the display
+  vp.w = 1920;
+  vp.h = 1080;
+  bench_target = SDL_CreateRGBSurface(0, vp.w, vp.h, 32, 0xff, 0xff00, 0xff0000, 0xff000000);
+  bench_renderer = bench_target ? SDL_CreateSoftwareRenderer(bench_target) : NULL;
+  if (!bench_renderer)
+    error("creating software renderer");
+  if (SDL_SetRenderDrawBlendMode(bench_renderer, SDL_BLENDMODE_BLEND) < 0)
+    error("setting blend mode");
+
+  printf("benchmark,entities,ops,ns_per_op,ops_per_sec,allocs_per_op,mb_per_sec\n");
+
+  int scene_sizes[] = {100, 1000, 10000, 100000, 1000000};
+  int num_scene_sizes = sizeof(scene_sizes) / sizeof(scene_sizes[0]);
+  for (int i = 0; i < num_scene_sizes; ++i) {
+    if (benchWanted("collides"))
+      benchCollides(scene_sizes[i]);
+    if (benchWanted("renderEntities"))
+      benchRenderEntities(scene_sizes[i]);
+    if (benchWanted("paintStroke"))
+      benchPaintStroke(scene_sizes[i]);
+  }
+
+  benchRasterization();
+  benchZoom();
+
+  // (a bigger level's all collision queries, which the other collides rows already cover)
+  if (benchWanted("stepEnemies"))
+    benchStepEnemies(10000);
+
+  // the level file codec & validator need bigger levels to say much
+  for (int i = 2; i < num_scene_sizes; ++i) {
+    if (benchWanted("lzCompress") || benchWanted("lzDecompress"))
+      benchCompression(scene_sizes[i]);
+    if (benchWanted("validChunk") || benchWanted("readEntity"))
+      benchValidation(scene_sizes[i]);
+  }
+
+  SDL_DestroyRenderer(bench_renderer);
+  SDL_FreeSurface(bench_target);
+  return 0;
+}
@@ -0,0 +1,243 @@
+// many headless worlds at once, for playtesting & training agents, built & run w/ `make env`
+// a level's loaded once & any number of worlds play it in lockstep: each has its own player, checkpoint & copy of the level's
+// movers (see World), & they all share the rest of the level, read only. envStep() takes an action for every world, steps them
+// all (spread across the job pool's workers, see parallelFor()) & fills in an observation for each
+// `./env [--level <path> | --stress <entities>] [--worlds <n>] [--steps <n>] [--workers <n>]` plays random agents & reports env-steps/sec
+// (another program can `#define ENV_NO_MAIN` & include env.c for just the API)
+#define PROFILE 0 // (the profiler's counters are shared, & the worlds are stepped on several threads at once)
+#define PLATFORMER_NO_MAIN
+#include "platformer.c"
+#include "stress.c"
+
+#define ENV_BATCH 64 // worlds per parallelFor() batch
+#define ENV_CELL_TILES 2 // the statics' grid cells are this many tiles on a side
+#define ENV_SEED 1529597895u
+
+// an action's a tick's input, the same bits a recording stores: TICK_LEFT | TICK_RIGHT | TICK_UP | TICK_DOWN
+
+// what an observation's status says
+#define ENV_GROUNDED  0x1 // standing on something (so it can jump)
+#define ENV_REVERSED  0x2 // its gravity's upside down
+#define ENV_RESPAWNED 0x4 // it died this step & is back at its checkpoint
+#define ENV_WON       0x8 // it's reached a finish (until it's reset)
+
+typedef struct {
+  int x;
+  int y;
+  float dx;
+  float dy;
+  byte status;
+} EnvObservation;
+
+typedef struct {
+  byte* actions;
+  EnvObservation* observations;
+} EnvStep;
+
+World* env_worlds;
+int env_len_worlds;
+Entity* env_statics; // the level's entities that never change (copies of `entities`' that share their shapes)
+int env_len_statics;
+Entity* env_movers; // the level's movers as it was loaded, which each world starts w/ a copy of
+int env_len_movers;
+Entity* env_world_movers; // the worlds' copies, env_len_movers apiece
+StaticGrid env_grid;
+EnemyBox* env_boxes[MAX_WORKERS + 1]; // each worker's scratch for boxing movers (see boxMovers())
+World env_start; // the game's world as it was when the env opened
+
+// a world back at the start of the level
+void envReset(int world_ix) {
+  World* w = &env_worlds[world_ix];
+  *w = env_start;
+  w->statics = env_statics;
+  w->len_statics = env_len_statics;
+  w->grid = &env_grid;
+  w->movers = &env_world_movers[world_ix * env_len_movers];
+  w->len_movers = env_len_movers;
+  memcpy(w->movers, env_movers, env_len_movers * sizeof(Entity));
+}
+
+// bucket the statics into env_grid
+void buildGrid() {
+  env_grid.cell_px = grid_size * ENV_CELL_TILES;
+  env_grid.cells_w = level_w / env_grid.cell_px + 1;
+  env_grid.cells_h = level_h / env_grid.cell_px + 1;
+  fillGrid(&env_grid, env_statics, env_len_statics, 0xff, false);
+}
+
+// num_worlds worlds on the level that's loaded (all of it has to be resident, see main()), each at the start
+// (after startJobs(), so each worker gets its scratch)
+void envOpen(int num_worlds) {
+  env_len_statics = 0;
+  env_len_movers = 0;
+  for (int i = 0; i < len_entities; ++i) {
+    if (isDynamic(&entities[i]))
+      env_len_movers++;
+    else
+      env_len_statics++;
+  }
+
+  env_statics = (Entity*)malloc((env_len_statics + 1) * sizeof(Entity));
+  env_movers = (Entity*)malloc((env_len_movers + 1) * sizeof(Entity));
+  env_world_movers = (Entity*)malloc(((size_t)num_worlds * env_len_movers + 1) * sizeof(Entity));
+  env_worlds = (World*)malloc(num_worlds * sizeof(World));
+  if (!env_statics || !env_movers || !env_world_movers || !env_worlds)
+    error("allocating env");
+  for (int w = 0; w <= num_workers; ++w) {
+    env_boxes[w] = (EnemyBox*)malloc((env_len_movers * 2 + 1) * sizeof(EnemyBox));
+    if (!env_boxes[w])
+      error("allocating env");
+  }
+
+  env_len_statics = 0;
+  env_len_movers = 0;
+  for (int i = 0; i < len_entities; ++i) {
+    if (isDynamic(&entities[i]))
+      env_movers[env_len_movers++] = entities[i];
+    else
+      env_statics[env_len_statics++] = entities[i];
+  }
+
+  buildGrid();
+  env_start = world;
+  env_len_worlds = num_worlds;
+  for (int i = 0; i < num_worlds; ++i)
+    envReset(i);
+}
+
+void envClose() {
+  free(env_statics);
+  free(env_movers);
+  free(env_world_movers);
+  free(env_worlds);
+  free(env_grid.starts);
+  free(env_grid.ixs);
+  env_grid.starts = NULL;
+  env_grid.ixs = NULL;
+  env_grid.max_starts = env_grid.max_ixs = 0;
+  for (int w = 0; w <= num_workers; ++w)
+    free(env_boxes[w]);
+  env_len_worlds = 0;
+}
+
+// a parallelFor() job: step a batch of worlds
+void stepWorlds(int start, int end, int worker, void* data) {
+  EnvStep* step = (EnvStep*)data;
+  for (int i = start; i < end; ++i) {
+    World* w = &env_worlds[i];
+    byte action = step->actions[i];
+    w->left_pressed = action & TICK_LEFT;
+    w->right_pressed = action & TICK_RIGHT;
+    w->up_pressed = action & TICK_UP;
+    w->down_pressed = action & TICK_DOWN;
+    w->mover_boxes = env_boxes[worker];
+    bool died = stepPlay(w);
+
+    Entity* player = &w->player;
+    bool grounded = worldCollides(w, player->x, player->y + sign(player->grav_y), player->w, player->h, -1, WALL) > -1;
+    EnvObservation* obs = &step->observations[i];
+    obs->x = player->x;
+    obs->y = player->y;
+    obs->dx = player->dx;
+    obs->dy = player->dy;
+    obs->status = (grounded ? ENV_GROUNDED : 0) | (player->grav_y < 0 ? ENV_REVERSED : 0) | (died ? ENV_RESPAWNED : 0) |
+      (w->won_game ? ENV_WON : 0);
+  }
+}
+
+// step every world a tick, world i w/ actions[i], & fill in observations[i]
+void envStep(byte* actions, EnvObservation* observations) {
+  EnvStep step = { .actions = actions, .observations = observations };
+  parallelFor(env_len_worlds, ENV_BATCH, stepWorlds, &step);
+}
+
+#ifndef ENV_NO_MAIN
+int main(int num_args, char* args[]) {
+  int num_worlds = 1024;
+  int num_steps = 1000;
+  int stress_entities = 0;
+  bool bad_args = false;
+  for (int i = 1; i < num_args; ++i) {
+    bool has_value = i + 1 < num_args;
+    if (!strcmp(args[i], "--level") && has_value)
+      level_path = args[++i];
+    else if (!strcmp(args[i], "--stress") && has_value)
+      stress_entities = atoi(args[++i]);
+    else if (!strcmp(args[i], "--worlds") && has_value)
+      num_worlds = atoi(args[++i]);
+    else if (!strcmp(args[i], "--steps") && has_value)
+      num_steps = atoi(args[++i]);
+    else if (!strcmp(args[i], "--workers") && has_value)
+      num_workers = atoi(args[++i]);
+    else
+      bad_args = true;
+  }
+  if (bad_args || num_worlds < 1 || num_steps < 1 || stress_entities < 0) {
+    printf("usage: env [--level <path> | --stress <entities>] [--worlds <n>] [--steps <n>] [--workers <n>]\n");
+    return 1;
+  }
+
+  if (SDL_Init(SDL_INIT_TIMER) < 0)
+    error("initializing SDL");
+  startJobs();
+  headless = true;
+  vp.w = 1920;
+  vp.h = 1080;
+
+  // the worlds play the whole level, so it's all loaded up front (& kept, since the chunks are never updated again)
+  if (stress_entities) {
+    stressLevel(stress_entities, ENV_SEED);
+  }
+  else {
+    loadLevel();
+    updateChunks(0, 0, level_w, level_h);
+    settleChunks();
+  }
+  envOpen(num_worlds);
+  printf("%d worlds on %s: %d static entities (shared) & %d movers apiece, %d workers\n", num_worlds,
+    stress_entities ? "a stress level" : level_path, env_len_statics, env_len_movers, num_workers);
+
+  // random agents: each holds a random input for a random number of steps, & starts over once it's won
+  byte* actions = (byte*)calloc(num_worlds, 1);
+  int* holds = (int*)calloc(num_worlds, sizeof(int));
+  EnvObservation* observations = (EnvObservation*)calloc(num_worlds, sizeof(EnvObservation));
+  if (!actions || !holds || !observations)
+    error("allocating agents");
+
+  long long deaths = 0;
+  long long wins = 0;
+  Uint64 stepping = 0;
+  for (int step = 0; step < num_steps; ++step) {
+    for (int i = 0; i < num_worlds; ++i) {
+      if (observations[i].status & ENV_WON) {
+        wins++;
+        envReset(i);
+      }
+      if (observations[i].status & ENV_RESPAWNED)
+        deaths++;
+      if (--holds[i] <= 0) {
+        actions[i] = stressRand() & (TICK_LEFT | TICK_RIGHT | TICK_UP | TICK_DOWN);
+        holds[i] = 1 + stressRand() % 30;
+      }
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    envStep(actions, observations);
+    stepping += SDL_GetPerformanceCounter() - start;
+  }
+
+  double secs = stepping / (double)SDL_GetPerformanceFrequency();
+  printf("%lld env-steps in %.3f s: %.0f env-steps/sec (%lld deaths, %lld wins)\n", (long long)num_worlds * num_steps, secs,
+    num_worlds * (double)num_steps / secs, deaths, wins);
+
+  free(actions);
+  free(holds);
+  free(observations);
+  envClose();
+  if (!stress_entities)
+    unloadLevel();
+  stopJobs();
+  SDL_Quit();
+  return 0;
+}
+#endif
@@ -0,0 +1,89 @@
+// libFuzzer harness for the level file & journal validators, built w/ `make fuzz`
+// (w/ FUZZ_STANDALONE defined it instead runs the files named on the command line, for compilers w/out libFuzzer)
+#define PLATFORMER_NO_MAIN
+#include "platformer.c"
+
+// parse data the way loadLevel() & readChunk() do: anything the validators pass has to read w/out going out of bounds
+void fuzzLevel(byte* data, size_t size) {
+  LevelHeader header;
+  if (size < sizeof(header))
+    return;
+  memcpy(&header, data, sizeof(header));
+  if (!validLevelHeader(&header))
+    return;
+  bool compressed = header.flags & LEVEL_COMPRESSED;
+
+  size_t num_chunks = (size_t)header.chunks_w * header.chunks_h;
+  if (num_chunks > (size - sizeof(header)) / sizeof(ChunkEntry))
+    return;
+  int64_t data_offset = sizeof(header) + num_chunks * sizeof(ChunkEntry);
+
+  for (size_t c = 0; c < num_chunks; ++c) {
+    ChunkEntry entry;
+    memcpy(&entry, data + sizeof(header) + c * sizeof(ChunkEntry), sizeof(entry));
+    if (!validChunkEntry(&entry, compressed, data_offset, size))
+      return;
+
+    byte* buffer = (byte*)malloc(entry.num_bytes + 1);
+    if (!compressed)
+      memcpy(buffer, data + entry.offset, entry.num_bytes);
+    else if (lzDecompress(data + entry.offset, entry.file_bytes, buffer, entry.num_bytes) != entry.num_bytes) {
+      free(buffer);
+      continue;
+    }
+
+    if (validChunk(buffer, entry.num_bytes, entry.len_entities)) {
+      void* buffer_ix = buffer;
+      for (int i = 0; i < entry.len_entities; ++i) {
+        Entity ent;
+        buffer_ix = readEntity(buffer_ix, &ent);
+        freeEntity(&ent);
+      }
+    }
+    free(buffer);
+  }
+}
+
+// journal ops carry entity records, which are checked one at a time by entityRecordBytes()
+void fuzzRecords(byte* data, size_t size) {
+  byte* data_ix = data;
+  size_t record_bytes;
+  while ((record_bytes = entityRecordBytes(data_ix, data + size - data_ix))) {
+    Entity ent;
+    readEntity(data_ix, &ent);
+    freeEntity(&ent);
+    data_ix += record_bytes;
+  }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  // copy into a buffer of exactly the input's size, so ASan catches even a byte read past the end
+  byte* buffer = (byte*)malloc(size ? size : 1);
+  memcpy(buffer, data, size);
+  fuzzLevel(buffer, size);
+  fuzzRecords(buffer, size);
+  free(buffer);
+  return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+int main(int num_args, char* args[]) {
+  for (int i = 1; i < num_args; ++i) {
+    FILE* file = fopen(args[i], "rb"); // read binary
+    if (!file)
+      error("opening fuzz input");
+    fseek(file, 0, SEEK_END);
+    size_t size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* data = (uint8_t*)malloc(size ? size : 1);
+    if (fread(data, 1, size, file) != size)
+      error("reading fuzz input");
+    fclose(file);
+
+    LLVMFuzzerTestOneInput(data, size);
+    free(data);
+  }
+
+  return 0;
+}
+#endif
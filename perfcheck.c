@@ -0,0 +1,310 @@
+// performance regression gate, built & run w/ `make perfcheck`
+// replays each session in perf/baseline.txt (a recording, perf/<name>.plr) headlessly on the stress level it was recorded on
+// (generated fresh from its entity count & seed), then compares ticks/sec, p99 tick time & peak heap w/ the baseline's numbers
+// & fails if any got worse by more than its tolerance, showing how long each phase of the tick took then & now
+// `./perfcheck --update` rewrites the baseline's numbers from this run (on the machine the gate runs on)
+// `./perfcheck --levels` just writes the levels, for recording new sessions: `./platformer --level perf/<name>.level4 --record perf/<name>.plr`
+#ifndef TRACK_ALLOCS
+#error "perfcheck measures peak memory w/ the allocation tracking, build it w/ -DTRACK_ALLOCS -include allocs.h (see make perfcheck)"
+#endif
+
+#define PLATFORMER_NO_MAIN
+#include "platformer.c"
+#include "stress.c"
+
+#if !PROFILE
+#error "perfcheck breaks tick time down w/ the profiler's phases, so it needs PROFILE"
+#endif
+
+// each session is replayed this many times & the best run counts, so a hiccup on the machine doesn't fail the gate
+#define PERF_RUNS 5
+#define PERF_MAX_SESSIONS 32
+#define PERF_MAX_LINES 256
+
+// what's measured, the first PERF_GATED of them w/ a tolerance (the phases are just for the breakdown)
+#define PERF_TICKS_PER_SEC 0
+#define PERF_P99_MS        1
+#define PERF_PEAK_KB       2
+#define PERF_GATED         3
+#define PERF_METRICS       (PERF_GATED + PHASE_ENEMIES - PHASE_CHUNKS + 1)
+
+char* metric_names[PERF_METRICS] = {"ticks_per_sec", "p99_ms", "peak_kb", "chunks_ms", "gravity_ms", "triggers_ms", "player_ms", "enemies_ms"};
+double tolerances[PERF_GATED] = {20, 50, 10}; // percent, overridden by the baseline's `tolerance` lines
+
+typedef struct {
+  char name[64];
+  int num_entities;
+  uint32_t seed;
+  bool has_baseline[PERF_METRICS];
+  double baseline[PERF_METRICS];
+  double now[PERF_METRICS];
+} PerfSession;
+
+PerfSession sessions[PERF_MAX_SESSIONS];
+int len_sessions;
+char lines[PERF_MAX_LINES][256];
+int len_lines;
+
+// the game's starting state, for resetting between runs
+Entity first_player;
+float first_grav;
+
+int metricIndex(char* name) {
+  for (int i = 0; i < PERF_METRICS; ++i)
+    if (!strcmp(metric_names[i], name))
+      return i;
+  return -1;
+}
+
+PerfSession* findSession(char* name) {
+  for (int i = 0; i < len_sessions; ++i)
+    if (!strcmp(sessions[i].name, name))
+      return &sessions[i];
+  return NULL;
+}
+
+void readBaseline(char* path) {
+  FILE* file = fopen(path, "r");
+  if (!file)
+    error("opening baseline");
+
+  while (len_lines < PERF_MAX_LINES && fgets(lines[len_lines], sizeof(lines[0]), file)) {
+    char* line = lines[len_lines++];
+    char first[64];
+    char metric[64];
+    double value;
+    if (sscanf(line, "%63s", first) != 1 || first[0] == '#')
+      continue;
+
+    if (!strcmp(first, "tolerance")) {
+      int metric_ix;
+      if (sscanf(line, "%*s %63s %lf", metric, &value) != 2 || (metric_ix = metricIndex(metric)) < 0 || metric_ix >= PERF_GATED)
+        error("reading baseline (bad tolerance)");
+      tolerances[metric_ix] = value;
+    }
+    else if (!strcmp(first, "session")) {
+      if (len_sessions == PERF_MAX_SESSIONS)
+        error("reading baseline (too many sessions)");
+      PerfSession* session = &sessions[len_sessions++];
+      if (sscanf(line, "%*s %63s %d %u", session->name, &session->num_entities, &session->seed) != 3)
+        error("reading baseline (bad session)");
+    }
+    else {
+      PerfSession* session = findSession(first);
+      int metric_ix;
+      if (!session || sscanf(line, "%*s %63s %lf", metric, &value) != 2 || (metric_ix = metricIndex(metric)) < 0)
+        error("reading baseline (bad metric)");
+      session->baseline[metric_ix] = value;
+      session->has_baseline[metric_ix] = true;
+    }
+  }
+  fclose(file);
+}
+
+// rewrite the baseline w/ this run's numbers, keeping its comments, tolerances & sessions
+void writeBaseline(char* path) {
+  FILE* file = fopen(path, "w");
+  if (!file)
+    error("writing baseline");
+
+  for (int i = 0; i < len_lines; ++i) {
+    char first[64];
+    if (sscanf(lines[i], "%63s", first) == 1 && findSession(first))
+      continue; // an old number
+
+    fputs(lines[i], file);
+    char name[64];
+    PerfSession* session;
+    if (!strcmp(first, "session") && sscanf(lines[i], "%*s %63s", name) == 1 && (session = findSession(name)))
+      for (int m = 0; m < PERF_METRICS; ++m)
+        fprintf(file, "%s %s %.6g\n", session->name, metric_names[m], session->now[m]);
+  }
+  if (ferror(file))
+    error("writing baseline");
+  fclose(file);
+}
+
+// replay a session once, into now[], or return false if it didn't end up where the recording did
+bool runSession(PerfSession* session, char* rec_path, double* now) {
+  world.player = first_player;
+  world.start_x = 0;
+  world.start_y = 0;
+  world.start_grav = first_grav;
+  world.won_game = false;
+  destroy_mode = false;
+  mode_type = WALL;
+  tile_mode = true;
+  mouse_is_down = false;
+  curr_color_ix = 0;
+  vp = (Viewport){};
+
+  startReplay(rec_path);
+  srand(rec_header.seed);
+  vp.w = rec_header.vp_w;
+  vp.h = rec_header.vp_h;
+
+  SDL_AtomicLock(&alloc_lock);
+  alloc_peak_bytes = alloc_live_bytes;
+  SDL_AtomicUnlock(&alloc_lock);
+
+  loadLevel();
+  if (levelHash() != rec_header.level_hash) {
+    printf("%s: the level isn't the one %s was recorded on (did the generator or the level format change? record it again)\n", session->name, rec_path);
+    fclose(rec_file);
+    unloadLevel();
+    return false;
+  }
+
+  // (tick times aren't counted in the peak)
+  int max_ticks = 4096;
+  int len_ticks = 0;
+  Uint64* tick_times = (Uint64*)(malloc)(max_ticks * sizeof(Uint64));
+  Uint64 phase_totals[NUM_PHASES] = {};
+
+  profileFrame();
+  Uint64 start = SDL_GetPerformanceCounter();
+  while (true) {
+    Uint64 tick_start = SDL_GetPerformanceCounter();
+    if (!replayTick())
+      break;
+    stepWorld();
+
+    if (len_ticks == max_ticks) {
+      max_ticks *= 2;
+      tick_times = (Uint64*)(realloc)(tick_times, max_ticks * sizeof(Uint64));
+    }
+    tick_times[len_ticks++] = SDL_GetPerformanceCounter() - tick_start;
+    for (int phase = PHASE_CHUNKS; phase <= PHASE_ENEMIES; ++phase)
+      phase_totals[phase] += profile_times[profile_frame][phase];
+    profileFrame();
+  }
+  double secs = (SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+  bool matched = stopReplay();
+  unloadLevel();
+
+  double ms_per_tick = 1000.0 / SDL_GetPerformanceFrequency();
+  qsort(tick_times, len_ticks, sizeof(Uint64), compareTicks);
+  now[PERF_TICKS_PER_SEC] = len_ticks / secs;
+  now[PERF_P99_MS] = len_ticks ? tick_times[len_ticks * 99 / 100] * ms_per_tick : 0;
+  now[PERF_PEAK_KB] = alloc_peak_bytes / 1024.0;
+  for (int phase = PHASE_CHUNKS; phase <= PHASE_ENEMIES; ++phase)
+    now[PERF_GATED + phase - PHASE_CHUNKS] = len_ticks ? phase_totals[phase] * ms_per_tick / len_ticks : 0;
+  (free)(tick_times);
+  return matched;
+}
+
+// how much worse now is than the baseline, in percent (negative is better)
+double regression(int metric_ix, double baseline, double now) {
+  if (!baseline)
+    return 0;
+  double change = (now - baseline) / baseline * 100;
+  return metric_ix == PERF_TICKS_PER_SEC ? -change : change;
+}
+
+// compare a session w/ its baseline, printing the per-phase breakdown if it regressed
+bool checkSession(PerfSession* session) {
+  bool passed = true;
+  for (int m = 0; m < PERF_GATED; ++m) {
+    if (!session->has_baseline[m]) {
+      printf("  %-14s %10.6g (no baseline, run ./perfcheck --update)\n", metric_names[m], session->now[m]);
+      continue;
+    }
+    double worse = regression(m, session->baseline[m], session->now[m]);
+    bool regressed = worse > tolerances[m];
+    printf("  %-14s %10.6g  baseline %10.6g  %5.1f%% %s (tolerance %g%%)%s\n", metric_names[m], session->now[m],
+      session->baseline[m], fabs(worse), worse > 0 ? "worse " : "better", tolerances[m], regressed ? "  REGRESSED" : "");
+    if (regressed)
+      passed = false;
+  }
+  if (passed)
+    return true;
+
+  // the phase that grew the most is the likely culprit
+  printf("  mean ms per tick, by phase:\n");
+  int culprit = -1;
+  double max_growth = 0;
+  for (int m = PERF_GATED; m < PERF_METRICS; ++m) {
+    double growth = session->now[m] - session->baseline[m];
+    printf("  %-14s %10.4f  baseline %10.4f  %+6.1f%%\n", metric_names[m], session->now[m], session->baseline[m],
+      regression(m, session->baseline[m], session->now[m]));
+    if (session->has_baseline[m] && growth > max_growth) {
+      max_growth = growth;
+      culprit = m;
+    }
+  }
+  if (culprit > -1)
+    printf("  most of it: %s (+%.4f ms per tick)\n", metric_names[culprit], max_growth);
+  return false;
+}
+
+int main(int num_args, char* args[]) {
+  char* baseline_path = "perf/baseline.txt";
+  bool update = false;
+  bool levels_only = false;
+  for (int i = 1; i < num_args; ++i) {
+    if (!strcmp(args[i], "--update"))
+      update = true;
+    else if (!strcmp(args[i], "--levels"))
+      levels_only = true;
+    else
+      baseline_path = args[i];
+  }
+
+  // sessions & levels live next to the baseline
+  char dir[256];
+  snprintf(dir, sizeof(dir), "%s", baseline_path);
+  char* slash = strrchr(dir, '/');
+  if (slash)
+    *slash = '\0';
+  else
+    strcpy(dir, ".");
+
+  if (SDL_Init(SDL_INIT_TIMER) < 0)
+    error("initializing SDL");
+  readBaseline(baseline_path);
+  headless = true;
+  first_player = world.player;
+  first_grav = world.start_grav;
+
+  bool passed = true;
+  for (int i = 0; i < len_sessions; ++i) {
+    PerfSession* session = &sessions[i];
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s.level4", dir, session->name);
+    stressLevel(session->num_entities, session->seed);
+    saveStressLevel(path);
+    if (levels_only) {
+      printf("wrote %s (%d entities)\n", path, session->num_entities);
+      continue;
+    }
+
+    char rec_path[512];
+    snprintf(rec_path, sizeof(rec_path), "%s/%s.plr", dir, session->name);
+    printf("%s: %d entities, best of %d runs\n", session->name, session->num_entities, PERF_RUNS);
+    for (int run = 0; run < PERF_RUNS; ++run) {
+      double now[PERF_METRICS];
+      if (!runSession(session, rec_path, now)) {
+        printf("%s: the replay didn't match the recording, so its numbers don't mean anything\n", session->name);
+        passed = false;
+        break;
+      }
+      for (int m = 0; m < PERF_METRICS; ++m) {
+        bool better = m == PERF_TICKS_PER_SEC ? now[m] > session->now[m] : now[m] < session->now[m];
+        if (!run || better)
+          session->now[m] = now[m];
+      }
+    }
+
+    if (!update && !checkSession(session))
+      passed = false;
+  }
+
+  if (update && !levels_only && passed) {
+    writeBaseline(baseline_path);
+    printf("updated %s\n", baseline_path);
+  }
+  SDL_Quit();
+  if (!levels_only)
+    printf(passed ? "perfcheck passed\n" : "perfcheck FAILED\n");
+  return passed ? 0 : 1;
+}
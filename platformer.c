@@ -11,6 +11,13 @@
 // #include "SDL_mixer.h"
 #include "include/font8x8_basic.h"
 #include "SDL2_gfxPrimitives.h"
+#include "allocs.h"
+#include "telemetry.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 typedef unsigned char byte;
 
@@ -65,6 +72,10 @@ Color colors[32] = {
 // shape types
 byte POLYGON = 0;
 
+// every entity has room for this many shapes, & every shape this many vertices
+#define MAX_SHAPES 64
+#define MAX_VERTICES 64
+
 byte NO_COLOR = 32;
 
 byte curr_color_ix = 0;
@@ -83,8 +94,8 @@ typedef struct {
 typedef struct {
   byte flags;
   byte health;
-  short x;
-  short y;
+  int x;
+  int y;
   short w;
   short h;
   float dx;
@@ -103,55 +114,416 @@ typedef struct {
   int h;
 } Viewport;
 
-Entity* createEntity(byte mode_type, byte color_ix, short x, short y, short w, short h);
+Entity* createEntity(byte mode_type, byte color_ix, int x, int y, short w, short h);
 void updateEntityBBox(Entity* ent);
 void deleteEntity(int entity_ix);
-int indexOfEntity(short x, short y, short w, short h);
+void freeEntity(Entity* ent);
+void reserveEntities(int num_entities);
+int indexOfEntity(int x, int y, short w, short h);
 void addRectPoints(Shape* shape, short x, short y, short w, short h);
 void addPoint(Shape* shape, short x, short y);
 void fillShape(Shape* shape);
+void renderScene(SDL_Renderer* renderer);
+void renderBackground(SDL_Renderer* renderer);
+void renderForeground(SDL_Renderer* renderer, Entity* shown_player, Viewport view, char* shown_note, unsigned int shown_note_time,
+  SDL_Rect fill_rect);
+void showNote(char* text);
+void showMainNote(char* text);
+void renderEntities(SDL_Renderer* renderer);
+void drawEntities(SDL_Renderer* renderer, Entity* ents, int len_ents, Viewport view);
 int render_text(SDL_Renderer* renderer, char str[], int offset_x, int offset_y, int size);
-int will_collide(Entity* ent, byte type);
 int collides(int x, int y, int w, int h, int ix, Entity entities[], byte type);
+int findCollision(int x, int y, int w, int h, int ix, Entity ents[], int len_ents, byte type, int* num_tests);
 int sign(float n);
 void error(char* activity);
+size_t entityBytes(Entity* entity);
+void* writeEntity(void* buffer_ix, Entity* entity);
+void* readEntity(void* buffer_ix, Entity* entity);
+void loadLevel();
+void unloadLevel();
+void saveLevel(bool drawing);
+int chunkIndexAt(int x, int y);
+Entity* readChunk(int chunk_ix);
+void loadChunkNow(int chunk_ix);
+void receiveChunks();
+void updateChunks(int x, int y, int w, int h);
+bool chunksResident(int x, int y, int w, int h);
+int chunkLoader(void* data);
 
 // game globals
 Viewport vp = {};
 
 byte grid_size = 30;
 
-short len_entities;
-#define max_entities 100
-Entity entities[max_entities];
+int len_entities;
+int max_entities;
+Entity* entities;
 
-FILE *level_file;
+char* level_path = "current.level4";
+bool compress_level = true; // whether saves compress the level file
+bool level_compressed; // whether the current level file is compressed (owned by the loader thread once it's running)
 
 // adapted from https://www.reddit.com/r/gamemaker/comments/37y24e/perfect_platformer_code/
-float start_grav = 0.2;
 int jump_speed = 4;
 int move_speed = 2;
 
-int start_x = 0;
-int start_y = 0;
+// input: arrow key & controller events go into a ring w/ their SDL timestamps as they're polled, & latchInput() resolves them
+// into the tick's left/right/up/down right before it's stepped, so a tap that's down & up again between two ticks still counts for one
+#define INPUT_LEFT      0 // the arrow keys
+#define INPUT_RIGHT     1
+#define INPUT_UP        2
+#define INPUT_DOWN      3
+#define INPUT_PAD_LEFT  4 // the controller's stick
+#define INPUT_PAD_RIGHT 5
+#define INPUT_PAD_JUMP  6 // the controller's A button, which jumps whichever way gravity's pulling
+#define NUM_INPUTS      7
+#define INPUT_RING_LEN  256 // must be a power of 2
 
-bool left_pressed = false;
-bool right_pressed = false;
-bool up_pressed = false;
-bool down_pressed = false;
+typedef struct {
+  Uint32 timestamp;
+  byte input;
+  bool down;
+} InputEvent;
 
-short level_w;
-short level_h;
+InputEvent input_ring[INPUT_RING_LEN];
+unsigned int input_read_ix;
+unsigned int input_write_ix;
+bool input_pushed[NUM_INPUTS]; // each input's state as of the newest event in the ring (so repeats aren't pushed)
+bool input_held[NUM_INPUTS]; // each input's state as of the last latched tick
+Uint32 input_oldest; // the timestamp of the oldest event the last latched tick used
+bool input_latched_any; // whether it used any
+SDL_SpinLock input_lock; // (w/ --threaded, events are pushed on the main thread & latched on the sim's)
 
-// dead zone makes it so light taps on controller joysticks doesn't drift the player
-const int JOYSTICK_DEAD_ZONE = 8000;
+void pushInput(byte input, bool down, Uint32 timestamp);
+void pushArrowKey(SDL_KeyboardEvent* key);
+void latchInput();
 
-int main(int num_args, char* args[]) {
-  time_t seed = 1529597895; //time(NULL);
-  srand(seed);
-  // printf("Seed: %lld\n", seed);
+// what a press does in tile mode (w/ anything but enemies, which are always placed one at a time)
+#define TOOL_PAINT 0 // paint (or erase) a tile at a time as the mouse is dragged
+#define TOOL_RECT  1 // fill the empty cells of the rectangle dragged out (or clear what's in it)
+#define TOOL_FLOOD 2 // fill the empty cells reachable from the one clicked
+
+// editor state
+bool destroy_mode = false;
+byte mode_type = WALL;
+bool tile_mode = true;
+byte tile_tool = TOOL_PAINT;
+bool mouse_is_down = false;
+bool dragging_fill = false; // a rectangle's being dragged out w/ TOOL_RECT
+int fill_x1; // the cells at its corners (the press's & the last drag's, in level coords)
+int fill_y1;
+int fill_x2;
+int fill_y2;
+Shape* selected_shape = NULL;
+int palette_color_size = 25;
+int palette_y; // the palette runs along the bottom of the screen
+
+int level_w;
+int level_h;
+
+// frame profiler: how long each phase of the game loop took, for the last PROFILE_FRAMES frames (F1 shows it)
+// build w/ -DPROFILE=0 to compile it out entirely
+#ifndef PROFILE
+#define PROFILE 1
+#endif
+
+#define PHASE_FRAME    0 // the whole loop, start to start
+#define PHASE_INPUT    1
+#define PHASE_CHUNKS   2
+#define PHASE_GRAVITY  3
+#define PHASE_TRIGGERS 4
+#define PHASE_PLAYER   5
+#define PHASE_ENEMIES  6
+#define PHASE_RENDER   7
+#define PHASE_HUD      8 // drawing the profiler itself
+#define PHASE_PRESENT  9
+#define NUM_PHASES     10
+
+#if PROFILE
+#define PROFILE_FRAMES 256
+#define PROFILE_START(phase) (profile_starts[phase] = SDL_GetPerformanceCounter())
+#define PROFILE_STOP(phase) profileStop(phase)
+
+char* phase_names[NUM_PHASES] = {"frame", "input", "chunks", "gravity", "triggers", "player", "enemies", "render", "hud", "present"};
+Uint64 profile_times[PROFILE_FRAMES][NUM_PHASES]; // ring buffer of per-frame phase times, in performance counter ticks
+Uint64 profile_starts[NUM_PHASES];
+int profile_frame; // the frame being timed
+int profile_len_frames; // how many frames before it are filled in
+float profile_stats[NUM_PHASES][4]; // min, avg, p99 & max ms, refreshed every so often while the HUD is up
+bool show_profiler = false;
+
+// collides() calls & the box tests they did (against every entity of the type they asked for, up to the first hit), this frame & the last PROFILE_FRAMES
+int collide_queries;
+int collide_tests;
+int profile_queries[PROFILE_FRAMES];
+int profile_tests[PROFILE_FRAMES];
+float collide_stats[4]; // avg & max queries, avg & max box tests per frame
+
+// input to present latency: for frames whose tick used input events, the ms from the oldest of them to the frame's present
+// (-1 for frames w/out any), & a histogram of the last PROFILE_FRAMES frames' in LATENCY_BUCKET_MS buckets (the last one's everything over)
+#define LATENCY_BUCKETS   16
+#define LATENCY_BUCKET_MS 4
+int profile_latency[PROFILE_FRAMES];
+int latency_counts[LATENCY_BUCKETS];
+float latency_stats[3]; // how many frames had input, avg & max ms
+
+// collision heatmap (F2): the level is cut into cells of HEAT_CELL_TILES x HEAT_CELL_TILES tiles, each counting the queries made from it
+// (by their box's center) & the box tests against entities in it, over windows of HEAT_FRAMES frames (the last full window is shown)
+// w/ this frame's query boxes & the player's & enemies' swept paths drawn over it
+#define HEAT_CELL_TILES 4
+#define HEAT_FRAMES 60
+#define HEAT_MAX_BOXES 1024
+
+typedef struct {
+  int x;
+  int y;
+  int w;
+  int h;
+  bool hit;
+} HeatBox;
+
+bool show_heatmap = false;
+int heat_w; // in cells
+int heat_h;
+int* heat_queries[2]; // [heat_window] is being counted, the other is the last full window
+int* heat_tests[2];
+int heat_window;
+int heat_frames; // how far into the window being counted
+int heat_hot_cell; // the cell w/ the most box tests in the last full window
+int heat_hot_tests;
+HeatBox heat_boxes[HEAT_MAX_BOXES]; // this frame's queries that touch the viewport
+int len_heat_boxes;
+
+void profileFrame();
+void profileStop(int phase);
+void renderProfiler(SDL_Renderer* renderer);
+void toggleHeatmap();
+void freeHeatmap();
+void heatQuery(int x, int y, int w, int h, int ix, byte type, int hit);
+void heatFrame();
+void renderHeatmap(SDL_Renderer* renderer);
+#else
+#define PROFILE_START(phase)
+#define PROFILE_STOP(phase)
+#endif
+
+// tracing: `--trace <file>` writes a Chrome trace_event JSON file (open it in chrome://tracing or ui.perfetto.dev)
+// w/ the profiler's phases as spans, the loader's work as spans on its own thread & instants for engine events
+// each thread buffers its events in its own ring (no locks or allocations), & a writer thread drains them to the file
+#define TRACE_MAIN   0
+#define TRACE_LOADER 1
+#define TRACE_SIM    2 // w/ --threaded
+#define NUM_TRACE_THREADS 3
+#define TRACE_RING_LEN 16384 // must be a power of 2
+
+typedef struct {
+  char* name; // always a string literal, so it outlives the event
+  char type; // 'X' for a span, 'i' for an instant
+  Uint64 start;
+  Uint64 end;
+} TraceEvent;
+
+typedef struct {
+  TraceEvent events[TRACE_RING_LEN];
+  SDL_atomic_t read_ix;
+  SDL_atomic_t write_ix;
+  int num_dropped; // events that didn't fit (only touched by the producer)
+} TraceRing;
+
+bool tracing = false;
+FILE* trace_file;
+Uint64 trace_start;
+TraceRing* trace_rings; // one per thread
+SDL_Thread* trace_thread;
+SDL_atomic_t trace_quit;
+int trace_len_written;
+
+#ifdef TRACK_ALLOCS
+// allocation accounting (see allocs.h): counts & bytes per call site, live & peak bytes,
+// & after a warmup, a warning the first time each call site allocates in the frame loop on the main thread
+#define ALLOC_SITES 1024 // must be a power of 2
+#define ALLOC_HEADER 16 // bytes before each block, w/ its size & call site (a multiple of the alignment malloc gives)
+#define ALLOC_WARMUP_FRAMES 120
+
+typedef struct {
+  char* file;
+  int line;
+  bool flagged; // already warned about allocating in the frame loop
+  long long num_allocs;
+  long long num_bytes;
+  long long live_bytes;
+} AllocSite;
+
+AllocSite alloc_sites[ALLOC_SITES];
+SDL_SpinLock alloc_lock; // the loader & trace threads allocate too
+long long alloc_live_bytes;
+long long alloc_peak_bytes;
+SDL_threadID alloc_main_thread;
+int alloc_frame; // frames since the frame loop started
+bool alloc_in_frame_loop;
+int allocs_this_frame;
+int allocs_last_frame;
+
+void allocFrame();
+void allocReport();
+#endif
+
+// frame pacing: each frame ends at a deadline pace_frame_ms after the last one's (`--fps <n>` sets it), sleeping away what's left
+// of the frame but the last pace_spin_ms (`--spin-ms <ms>`), which are busy-waited, since SDL_Delay() can oversleep by a ms or two
+// (a tick is a frame, so the frame rate is also the game's speed)
+double pace_frame_ms = 10;
+double pace_spin_ms = 1;
+Uint64 pace_deadline; // when the current frame should end (0 to start the schedule over)
+
+void paceFrame();
+
+// jobs: a pool of worker threads that split loops across cores (see parallelFor()), w/ `--workers <n>` of them
+// (0 runs everything on the calling thread, the default is one less than the number of cores). Each worker, & the thread calling
+// parallelFor(), starts w/ an even share of the loop's batches & works through them from the front, then steals the back half
+// of whatever another has left, until there's nothing left anywhere
+#define MAX_WORKERS 32
+#define JOB_MAX_BATCHES 32767 // each worker's range of batches is packed into an atomic int, 16 bits a side
+
+typedef void (*JobFn)(int start, int end, int worker, void* data);
+
+typedef struct {
+  SDL_Thread* thread;
+  SDL_sem* start;
+  SDL_atomic_t batches; // the ones it has left: first << 16 | end
+  char padding[40]; // (so workers' ranges don't share a cache line)
+} JobWorker;
+
+int num_workers = -1; // -1 for the default
+JobWorker job_workers[MAX_WORKERS + 1]; // [0] is whichever thread's calling parallelFor()
+SDL_sem* job_done;
+SDL_atomic_t job_quit;
+JobFn job_fn;
+void* job_data;
+int job_len;
+int job_batch_len;
+
+void startJobs();
+void stopJobs();
+void parallelFor(int len, int batch_len, JobFn fn, void* data);
+
+// the enemy step moves enemies that can't bump into each other this tick in parallel, keeping what each does in
+// enemy_moves, & the rest (& everything, w/ the heatmap up) on the calling thread. Either way it comes out the same as moving
+// them one at a time in entity order, on any number of workers
+#define ENEMY_BATCH 16
+
+typedef struct {
+  int ix;
+  int x1; // everywhere it could be (or look) this tick, & a px more
+  int y1;
+  int x2;
+  int y2;
+  bool conflict; // another enemy's box overlaps it
+} EnemyBox;
+
+typedef struct {
+  int queries;
+  int tests;
+  bool escaped; // an enemy looked outside its box (if it started out stuck in a wall), so the parallel moves don't count
+  char padding[52]; // (so workers' counts don't share a cache line)
+} MoveCounts;
+
+EnemyBox* enemy_boxes;
+int* enemy_ixs; // the enemies moved in parallel, followed by the ones that aren't
+Entity* enemy_moves; // the enemies moved in parallel, after
+int max_enemies;
+MoveCounts move_counts[MAX_WORKERS + 1];
+
+void stepEnemies();
+
+// enemy sleep: only enemies near the viewport are simulated. The level's split into regions of ACTIVE_TILES x ACTIVE_TILES tiles
+// & the ones the viewport's in (& ACTIVE_MARGIN around them) are awake, the rest are asleep & their enemies are frozen where they are
+// when a region wakes, its enemies are caught up on the ticks they slept through (see fastForward()), or, if the level's flags
+// say LEVEL_WAKE_RESET, put back where they spawned
+#define ACTIVE_TILES 16
+#define ACTIVE_MARGIN 1 // regions around the viewport that are awake
+
+typedef struct {
+  int x;
+  int y;
+} Spawn;
+
+int region_px;
+int regions_w;
+int regions_h;
+int* region_slept_at; // the tick each region last fell asleep (NULL w/out a loaded level, like bench's, so everything's awake)
+int active_x1; // the awake regions (inclusive), none before the first tick
+int active_y1;
+int active_x2;
+int active_y2;
+int sim_ticks; // ticks stepped since the level was loaded
+bool wake_reset; // the level's wake policy
+Spawn* spawns; // (w/ wake_reset) where each entity spawned, parallel to `entities`: where it was placed or paged in
+int* awake_movers; // the entities that move (see isDynamic()) & are awake, in order: the ones gravity & stepEnemies() step
+int len_awake_movers;
+int max_awake_movers;
+int awake_version = -1; // world_version when awake_movers was listed (-1 when the awake regions have changed since)
+
+void startActivity(bool reset);
+void stopActivity();
+void trackSpawns(bool track);
+bool isAwake(Entity* ent);
+void listAwakeMovers();
+void updateActivity();
+void fastForward(int ix, int ticks);
+
+// static entities bucketed into a grid of cells, for worlds that query statics a lot (see env.c) & the player's triggers
+// cell c's entities are the statics at ixs[starts[c]] to ixs[starts[c + 1]], in order
+typedef struct {
+  int cell_px;
+  int cells_w;
+  int cells_h;
+  int* starts;
+  int* ixs;
+  int max_starts; // (what starts & ixs have room for, since fillGrid() reuses them)
+  int max_ixs;
+} StaticGrid;
+
+// (while regions wake) every wall, bucketed by region where it was when they woke, for fastForward() to look around in
+StaticGrid wall_map;
+int* forwarded; // the walls fastForward() has moved since, which it looks at wherever they are now
+int len_forwarded;
+int max_forwarded;
+int* near_walls; // the walls fastForward() looks at for an enemy (see gatherWalls()), scratch
+int len_near_walls;
+int max_near_walls;
+
+void gatherWalls(int ix);
+void nearColumn(Entity* ent, int cx, int cy1, int cy2, int* lo, int* hi);
+void nearWall(Entity* ent, int wall_ix, int* lo, int* hi);
+
+// a world: what a playthrough of the level changes (the player, its last checkpoint & whether it's won) & the input it's
+// stepped w/. The game has the one, env.c steps many at once over the same level (see stepPlay())
+typedef struct {
+  Entity player;
+  int start_x;
+  int start_y;
+  float start_grav;
+  bool won_game;
+
+  bool left_pressed;
+  bool right_pressed;
+  bool up_pressed;
+  bool down_pressed;
 
-  Entity player = {
+  // the level it's played in: the game's world has `entities` (& these are NULL), env.c's worlds share the level's
+  // static entities & each have their own copy of its movers (anything w/ a velocity or gravity)
+  Entity* statics;
+  int len_statics;
+  StaticGrid* grid; // (if the statics are bucketed)
+  Entity* movers;
+  int len_movers;
+  // (for stepping its own movers: scratch for 2 * len_movers boxes, to skip checking the ones that can't meet, see boxMovers())
+  EnemyBox* mover_boxes;
+  bool movers_escaped;
+} World;
+
+World world = {
+  .player = {
     .flags = 0,
     .health = 1,
     .x = 0,
@@ -166,114 +538,543 @@ int main(int num_args, char* args[]) {
     .len_shapes = 0,
     .max_shapes = 0,
     .shapes = NULL
-  };
-  
-  // SDL setup
-  SDL_SetHint(SDL_HINT_JOYSTICK_ALLOW_BACKGROUND_EVENTS, "1");
-  if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_GAMECONTROLLER) < 0)
-    error("initializing SDL");
+  },
+  .start_x = 0,
+  .start_y = 0,
+  .start_grav = 0.2,
+  .won_game = false
+};
 
-  SDL_Window* window;
-  window = SDL_CreateWindow("Platformer", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 30 * 128, 30 * 128, SDL_WINDOW_RESIZABLE);
-  if (!window)
-    error("creating window");
+bool stepPlay(World* w);
+int worldCollides(World* w, int x, int y, int wd, int h, int mover_ix, byte type);
+int gridCollision(StaticGrid* grid, Entity statics[], int x, int y, int w, int h, byte type, int* num_tests);
+int playerWillCollide(World* w, byte type);
 
-  if (SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN) < 0)
-    error("Toggling fullscreen mode failed");
-  
-  // toggle_fullscreen(window);
-  SDL_GetWindowSize(window, &vp.w, &vp.h);
-  //vp.h -= header_height;
+// the player's triggers (anything it can touch but walls): the static ones are bucketed into a map of cells of TRIGGER_CELL_TILES
+// tiles, rebuilt whenever entities change, & the player only looks through the map again when it crosses into another cell
+// (so standing or running w/ nothing around costs next to nothing). The moving ones (enemies) in those cells are gathered
+// again each time they've moved, which is once a tick, & it's just those that are tested
+#define TRIGGERS (REVERSE_GRAV | LAVA | FINISH | CHECKPOINT | PORTAL | ENEMY)
+#define TRIGGER_CELL_TILES 8
 
-  level_file = fopen("current.level2", "rb"); // read binary
+StaticGrid trigger_map;
+int trigger_version = -1; // world_version when trigger_map was filled
+int* moving_triggers; // indices of the triggers that move, in order
+int len_moving_triggers;
+int max_moving_triggers;
+int* near_triggers; // the static triggers in the cells the player's next move touches, in order
+int len_near_triggers;
+int max_near_triggers;
+int near_x1; // those cells (inclusive)
+int near_y1;
+int near_x2;
+int near_y2;
+int* near_movers; // the moving triggers in those cells, in order
+int len_near_movers;
+int max_near_movers;
+bool movers_moved = true; // whether the moving triggers have moved since near_movers were gathered
 
-  if (level_file == NULL) {
-    len_entities = 0;
-    level_w = vp.w;
-    level_h = vp.h;
-    
-    // create a default ground entity/shape
-    Entity* ground_ent = createEntity(WALL, 6, 0, vp.h - (vp.h % grid_size) - grid_size, vp.w, grid_size);
-    Shape* ground_shape = &(ground_ent->shapes[0]);
-    fillShape(ground_shape);
-    addRectPoints(ground_shape, 0, 0, vp.w, grid_size);
-  }
-  else {
-    // Load level from file (deserialize)
+void gridRange(StaticGrid* grid, int x, int y, int w, int h, int* cx1, int* cy1, int* cx2, int* cy2);
+void fillGrid(StaticGrid* grid, Entity ents[], int len_ents, byte types, bool movers);
+int triggerCollision(int x, int y, int w, int h, byte type);
+void freeTriggers();
 
-    // seek to the end to find the size
-    if (fseek(level_file, 0, SEEK_END)) {
-      fclose(level_file);
-      error("Error seeking to the end of the level file");
-    }
+// live telemetry (see telemetry.h): `--telemetry [/name]` publishes the last frame's stats to shared memory every frame
+char* telemetry_name;
+Telemetry* telemetry;
+Uint64 telemetry_frame_start;
 
-    size_t num_bytes = ftell(level_file);
+void startTelemetry(char* name);
+void publishTelemetry(bool paused);
+void stopTelemetry();
 
-    if (fseek(level_file, 0, SEEK_SET)) {
-      fclose(level_file);
-      error("Error seeking to the beginning of the level file");
-    }
+// input recording: `--record <file>` writes the resolved input of every tick (the pressed flags, editor actions & viewport size),
+// & `--replay <file>` plays it back instead of reading the keyboard, mouse & controllers (add `--headless` to run it w/out a window, as fast as it goes)
+// a tick is a pass through the game loop that isn't paused. To replay bit-exactly, both sides wait for the chunks they request
+// to arrive in the tick they were requested in, & edits aren't journaled or saved, so the level is still the one the recording was made on
+// file layout: RecordingHeader, then a record per tick (or run of ticks w/ the same input): a TICK_* flags byte,
+// a varint run length if TICK_RUN, the viewport size as varints if TICK_VIEWPORT & the edits if TICK_EDITS
+// (a varint count, then each edit's type & args: x/y as zigzag varint deltas from the last edit's, or a byte for colors & modes)
+// TICK_END is followed by any edits made after the last tick & a hash of the world, so the replay can check it ended up in the same place
+#define TICK_LEFT     0x1
+#define TICK_RIGHT    0x2
+#define TICK_UP       0x4
+#define TICK_DOWN     0x8
+#define TICK_INPUT    0xf
+#define TICK_RUN      0x10 // the same input for this many more ticks
+#define TICK_VIEWPORT 0x20
+#define TICK_EDITS    0x40
+#define TICK_END      0x80
 
-    void* buffer = calloc(1, num_bytes);
-    fread(buffer, num_bytes, 1, level_file); // read bytes into our buffer
-    if (ferror(level_file))
-      printf("reading level file: %s\n", strerror(errno));
-    
-    fclose(level_file);
+// editor actions, resolved from mouse & key events (into level coords, apart from palette clicks) so they replay the same in any window
+#define EDIT_PRESS     0 // mouse down at x/y
+#define EDIT_DRAG      1 // mouse moved to x/y while it does something (painting tiles or placing a vertex)
+#define EDIT_RELEASE   2
+#define EDIT_COLOR     3 // palette click: x is the color ix
+#define EDIT_MODE      4 // x is the type of entity to make
+#define EDIT_TILE_MODE 5 // toggle between tiles & drawing
+#define EDIT_FINISH    6 // finish the shape being drawn
+#define EDIT_WAKE      7 // toggle the level's wake policy (see LEVEL_WAKE_RESET)
+#define EDIT_UNDO      8 // take back the last transaction (see undoEdits())
+#define EDIT_REDO      9
+#define EDIT_TOOL      10 // x is the tile tool (see TOOL_PAINT)
 
-    void* buffer_ix = buffer;
-    memcpy(&len_entities, buffer_ix, sizeof(len_entities));
-    buffer_ix += sizeof(len_entities);
-    memcpy(&level_w, buffer_ix, sizeof(level_w));
-    buffer_ix += sizeof(level_w);
-    memcpy(&level_h, buffer_ix, sizeof(level_h));
-    buffer_ix += sizeof(level_h);
+typedef struct {
+  byte type;
+  int x;
+  int y;
+} EditAction;
 
-    for (int i = 0; i < len_entities; ++i) {
-      Entity* entity = &entities[i];
-      memcpy(entity, buffer_ix, sizeof(Entity));
-      buffer_ix += sizeof(Entity);
+typedef struct {
+  char magic[4];
+  uint32_t seed;
+  int vp_w;
+  int vp_h;
+  uint64_t level_hash; // of the level file & its journals
+} RecordingHeader;
 
-      entity->shapes = (Shape*)calloc(64, sizeof(Shape));
-      for (int j = 0; j < entity->len_shapes; ++j) {
-        Shape* shape = &(entity->shapes[j]);
-        memcpy(shape, buffer_ix, sizeof(Shape));
-        buffer_ix += sizeof(Shape);
+bool recording = false;
+bool replaying = false;
+bool headless = false;
+FILE* rec_file;
+RecordingHeader rec_header;
+byte rec_input; // input of the current run of ticks
+int rec_run; // ticks in the current run so far (recording) or left to go (replaying)
+int rec_vp_w; // viewport size as of the last record
+int rec_vp_h;
+int rec_x; // the last edit's x/y, which the next one's are deltas from
+int rec_y;
+int rec_len_ticks;
+EditAction* rec_edits; // this tick's edits (recording)
+int len_rec_edits;
+int max_rec_edits;
+Uint64 rec_start; // when the replay's first tick started
+bool rec_done; // the replay got to the end of the recording
+uint64_t rec_world_hash; // where the recording ended up
 
-        shape->x = (short*)calloc(64, sizeof(short)),
-        shape->y = (short*)calloc(64, sizeof(short)),
+void edit(byte type, int x, int y);
+bool editDrags();
+void applyEdit(EditAction action);
+SDL_Rect fillPreview();
+byte* mapCells(int* map_x, int* map_y, int* map_w, int* map_h);
+void markCells(byte* cells, int map_x, int map_y, int map_w, int map_h, int x1, int y1, int x2, int y2, byte mark);
+void coverCells(byte* cells, int map_x, int map_y, int map_w, int map_h);
+void fillRect(int x1, int y1, int x2, int y2);
+void floodFill(int x, int y);
+void clearRect(int x1, int y1, int x2, int y2);
+int tileAt(int x, int y);
+void eraseCell(int ix, int x, int y);
+bool stepWorld();
+void startRecording(char* path, uint32_t seed);
+void startReplay(char* path);
+void recordTick();
+bool replayTick();
+void stopRecording();
+bool stopReplay();
+uint64_t levelHash();
+uint64_t worldHash();
+void settleChunks();
 
-        // copy x & y vertices
-        memcpy(shape->x, buffer_ix, shape->len_vertices * sizeof(short));
-        buffer_ix += shape->len_vertices * sizeof(short);
-        memcpy(shape->y, buffer_ix, shape->len_vertices * sizeof(short));
-        buffer_ix += shape->len_vertices * sizeof(short);
-      }
-    }
+// pipelining: w/ `--threaded`, the simulation runs on its own thread at its own pace (see paceFrame()) & publishes a snapshot of
+// what's drawn after every tick, & the main thread polls events & renders the newest snapshot, as fast as they come & no faster
+// snapshots are triple buffered: the sim writes one, one's the newest published & the renderer reads one, & publishing or taking
+// one is an atomic swap, so neither thread ever waits on the other. The main thread queues edits & commands for the sim,
+// which runs them at the start of its next tick (the profiler's sim phases & collision counts are written by the sim &
+// read by the main thread w/out syncing, which is fine for numbers that are only shown)
+#define SNAPSHOT_FRESH 4 // set in snapshot_newest when the sim's published a snapshot the renderer hasn't taken yet
 
-    // sanity check
-    if (buffer_ix - buffer != num_bytes) {
-      printf("%lu - num_bytes\n", num_bytes);
-      printf("%lu - pointer diff\n", buffer_ix - buffer);
-      error("byte mismatch on file save");
-    }
+// not edits: what else the main thread can ask the sim for (see command())
+#define SIM_SAVE   16
+#define SIM_RESIZE 17 // x/y are the window's new size
+
+// entities copied out of `entities` for drawing: each w/ just its first shape, whose vertices are copied too
+typedef struct {
+  Entity* ents;
+  Shape* shapes;
+  short* vertices;
+  int len_ents;
+  int max_ents;
+  int max_vertices;
+} SnapshotLayer;
+
+typedef struct {
+  Entity player;
+  Viewport vp;
+  bool won_game;
+  char* note;
+  unsigned int note_time;
+  SDL_Rect fill_rect; // (see fillPreview())
+  bool input_latched_any;
+  Uint32 input_oldest;
+  // the static entities around the viewport are only copied again when they change or the viewport leaves the region they cover,
+  // the dynamic ones in the viewport are copied every tick
+  int static_version; // world_version when statics was copied
+  SDL_Rect static_rect;
+  SnapshotLayer statics;
+  SnapshotLayer dynamics;
+} Snapshot;
+
+typedef struct {
+  EditAction* actions;
+  int len;
+  int max;
+} CommandQueue;
+
+bool threaded = false;
+int world_version; // bumped whenever entities are added, removed or edited (w/ --threaded, it's what says the snapshots' statics are stale)
+Snapshot snapshots[3];
+int snapshot_back; // the one the sim's writing
+int snapshot_front; // the one the renderer's reading
+SDL_atomic_t snapshot_newest; // the last one published, | SNAPSHOT_FRESH until the renderer takes it
+SDL_sem* snapshot_ready; // posted every publish, for the renderer to wait on
+SDL_Thread* sim_thread;
+SDL_sem* sim_wake; // posted when the sim's got commands or should stop waiting out a pause
+SDL_atomic_t sim_paused;
+SDL_atomic_t sim_quit;
+SDL_atomic_t sim_done; // the replay ran out
+SDL_mutex* sim_commands_lock;
+CommandQueue sim_commands[2];
+int sim_commands_in; // the queue the main thread's adding to (the sim runs the other)
+int trace_world = TRACE_MAIN; // the trace ring the world's events go in (TRACE_SIM's w/ --threaded)
+
+int tick();
+void command(byte type, int x, int y);
+void runCommand(EditAction action);
+void startSim();
+void stopSim();
+void publishSnapshot();
+Snapshot* takeSnapshot(bool* fresh);
+void waitForSnapshot();
+void renderSnapshot(SDL_Renderer* renderer, Snapshot* snap);
+
+void startTrace(char* path);
+void stopTrace();
+void traceEvent(int thread, char* name, char type, Uint64 start, Uint64 end);
+void traceInstant(int thread, char* name);
+
+// the world is split into chunks of CHUNK_TILES x CHUNK_TILES tiles, each stored independently in the level file
+// a background thread pages chunks in & out around the player & viewport,
+// so `entities` only ever holds the entities of resident chunks (plus any that wandered out & haven't been paged out yet)
+#define CHUNK_TILES 64
+#define CHUNK_LOAD_MARGIN 1 // chunks around the viewport to page in
+#define CHUNK_KEEP_MARGIN 2 // chunks around the viewport to keep before paging out (larger, so we don't thrash at borders)
+
+// chunk states (only read & written by the main thread)
+#define CHUNK_UNLOADED 0
+#define CHUNK_LOADING  1
+#define CHUNK_RESIDENT 2
+#define CHUNK_STORING  3
+
+// level file layout: LevelHeader, a ChunkEntry for each chunk (row-major), then each chunk's entity records
+// (each chunk compressed on its own if the level is compressed, so chunks can still be read independently)
+typedef struct {
+  char magic[4];
+  int level_w;
+  int level_h;
+  int chunks_w;
+  int chunks_h;
+  int generation; // bumped every save, so we know which journal(s) to replay on top of it
+  int flags;
+} LevelHeader;
+
+// level flags
+#define LEVEL_COMPRESSED 0x1
+#define LEVEL_WAKE_RESET 0x2 // sleeping enemies go back to where they spawned when they wake, instead of catching up
+
+typedef struct {
+  int64_t offset;
+  int file_bytes; // how much of the file it takes up (compressed, if the level is)
+  int num_bytes;  // size of its entity records
+  int len_entities;
+} ChunkEntry;
+
+typedef struct {
+  byte state;
+  bool dirty; // edited since it was last paged in, so paging it out needs to keep a copy
+  // where the chunk's entity records live while it's not resident: a region of `chunk_file`,
+  // or `data` if it was changed & paged out since the last save
+  // only touched by the loader thread once it's running
+  ChunkEntry stored;
+  void* data;
+} Chunk;
+
+// messages between the main thread & the loader thread (the loader replies w/ the same message)
+#define CHUNK_LOAD  0
+#define CHUNK_STORE 1
+#define CHUNK_SAVE  2
+#define CHUNK_QUIT  3
+
+typedef struct {
+  byte type;
+  bool dirty;
+  bool merge; // add the entities to the chunk's stored ones, instead of replacing them
+  int chunk_ix;
+  int len_entities;
+  Entity* entities;
+  // CHUNK_SAVE only: the chunks that were resident (the first len_resident) or loading when the snapshot was taken,
+  // & which snapshot entity (if any) has its own copy of its shapes, to be freed after writing
+  int len_resident;
+  int len_chunk_ixs;
+  int* chunk_ixs;
+  int copied_ix;
+  int generation;
+  char* failure; // (in the reply) what went wrong, or NULL if it was saved
+  bool fatal; // the level file can't be read anymore, so the game can't go on
+  int level_flags; // (other than LEVEL_COMPRESSED, which is compress_level's)
+} ChunkMsg;
+
+// lock-free single-producer/single-consumer ring
+#define CHUNK_QUEUE_LEN 1024
+
+typedef struct {
+  ChunkMsg msgs[CHUNK_QUEUE_LEN];
+  SDL_atomic_t read_ix;
+  SDL_atomic_t write_ix;
+} ChunkQueue;
+
+int chunk_px;
+int chunks_w;
+int chunks_h;
+Chunk* chunks;
+// chunks that aren't CHUNK_UNLOADED, so we don't have to walk the whole chunk table every frame
+int* live_chunks;
+int len_live_chunks;
+
+FILE* chunk_file;
+SDL_Thread* chunk_thread;
+SDL_sem* chunk_sem;
+ChunkQueue chunk_requests; // main -> loader
+ChunkQueue chunk_replies;  // loader -> main
+// we never have more than CHUNK_QUEUE_LEN messages out, so neither queue can fill up
+int chunk_msgs_out;
+
+// while a save is being written, shapes are shared w/ the loader thread's snapshot,
+// so deleted entities are kept here & freed once it's done
+bool save_in_flight;
+Entity* save_staging; // reused between saves, so the snapshot doesn't page-fault its way through fresh memory
+int max_save_staging;
+Entity* unfreed_entities;
+int len_unfreed_entities;
+int max_unfreed_entities;
+char* note; // a line shown at the top of the screen for a bit, like "Saved" (see showNote())
+unsigned int note_time;
+char* main_note; // w/ --threaded, the main thread's own (the sim's comes in its snapshots)
+unsigned int main_note_time;
+
+// editor operations are appended to a journal next to the level file as they happen, so edits are durable w/o a save
+// journal N holds the edits made on top of the level w/ generation N; a save (compaction) starts journal N + 1
+// & once the new level is renamed into place, journal N is deleted. Loading replays journals N, N + 1, ... in order
+#define JOURNAL_CREATE  0 // full entity record
+#define JOURNAL_DELETE  1
+#define JOURNAL_RECOLOR 2 // color ix
+#define JOURNAL_VERTEX  3 // full entity record (replaces the entity, since adding a vertex can move its bounding box)
+
+// once the journal gets this big, it's folded into a fresh level file in the background
+#define JOURNAL_COMPACT_BYTES (1 << 20)
+
+FILE* journal_file;
+int journal_gen;
+long journal_bytes;
+bool journal_holding; // (undo & redo flush once for a whole transaction, instead of after every op)
+
+// undo & redo: every change an edit makes to `entities` is also logged, w/ what it takes to take it back, to a ring of UNDO_BYTES
+// edits are grouped into transactions (a press & the drags that paint after it are one), so undo takes back a whole stroke
+// records are [int n][op][flags][n - 2 bytes][int n], so they can be walked either way. Ops are the journal's: CREATE & DELETE
+// hold the entity's record, RECOLOR its box & old & new colors & VERTEX its records from before & after the edit
+// when the ring's full, the oldest transactions are dropped, & undone ones can be redone until the next edit
+#define UNDO_BYTES (4 << 20)
+#define UNDO_MIN_BYTES (64 << 10) // (it starts this big & doubles)
+#define UNDO_FIRST    0x1 // the first record of a transaction
+#define UNDO_SELECTED 0x2 // the entity's shape was the one being drawn before the edit
+#define UNDO_SELECTS  0x4 // & after it
+
+byte* undo_log;
+int undo_size;
+long long undo_tail; // offsets into the log as if it never wrapped (offset o is at undo_log[o % undo_size])
+long long undo_cursor; // records before it can be undone, records after it redone
+long long undo_head;
+long long undo_txn; // where the transaction that's being logged starts
+bool undo_begin; // the next record starts a transaction
+bool undo_dropped; // the transaction outgrew the ring, so the rest of it isn't logged
+byte* undo_scratch; // a record's body, copied out of the ring
+int max_undo_scratch;
+
+// entities by their box (x/y/w/h) in an open-addressed hash table, so finding the one at a box doesn't scan `entities`
+// (box_index has all of `entities`: painting, the journal & undo look tiles up in it)
+// each entity's filed under the box it had when it was inserted, so one whose box changes has to be removed & inserted again
+// (movers change theirs every tick, so the ones that've moved are filed again where they are, see boxRefile())
+// the static wide boxes are also filed under each square of WIDE_TILES x WIDE_TILES tiles they overlap, so painting can find
+// a filled rectangle that covers a cell by looking through just the ones around it (see boxCovering())
+#define BOX_WIDE 0x80000000u // (set in a wide box's hashes entry)
+#define WIDE_TILES 16
+
+typedef struct {
+  int* slots; // entity ixs (-1 for empty), probed linearly
+  int mask; // the number of slots (a power of 2) - 1
+  int len;
+  uint32_t* hashes; // each entity's hash as of when it was inserted (& BOX_WIDE if it's filed by square too), by entity ix
+  int max_hashes;
+  int* wide; // a square's x & y & a wide box's entity ix (-1 for empty) in each slot, probed linearly
+  int wide_mask; // the number of wide slots (a power of 2) - 1
+  int len_wide;
+} BoxIndex;
+
+BoxIndex box_index;
+
+void logCreate(Entity* ent);
+void logDelete(Entity* ent);
+void logRecolor(Entity* ent, byte old_color_ix);
+void logVertex(void* before, int before_bytes, Entity* ent);
+void* writeBox(void* buffer_ix, Entity* ent);
+void* readBox(void* buffer_ix, Entity* key);
+void pushUndo(byte op, byte flags, void* a, int a_bytes, void* b, int b_bytes);
+void undoEdits(bool redo);
+void freeUndo();
+void undoWrite(long long offset, void* src, int num_bytes);
+void undoRead(long long offset, void* dst, int num_bytes);
+int undoRecordBytes(long long offset);
+int undoRecordBytesBefore(long long offset);
+byte undoFlags(long long offset);
+byte* undoBody(long long offset, int* n);
+void growUndo();
+void growBoxes(BoxIndex* index, int num_slots);
+void freeBoxes(BoxIndex* index);
+void boxInsert(BoxIndex* index, int ix);
+void boxRemove(BoxIndex* index, int ix);
+void boxMove(BoxIndex* index, int from_ix, int to_ix);
+void boxRefile(BoxIndex* index, int ix);
+int boxFind(BoxIndex* index, int x, int y, short w, short h);
+bool isWideBox(Entity* ent);
+void wideRange(Entity* ent, int* sx1, int* sy1, int* sx2, int* sy2);
+void growWide(BoxIndex* index, int num_slots);
+void wideInsert(BoxIndex* index, int sx, int sy, int ix);
+int wideSlot(BoxIndex* index, int sx, int sy, int ix);
+void wideRemove(BoxIndex* index, int slot);
+int boxCovering(BoxIndex* index, int x, int y, short w, short h);
+bool isRectTile(Entity* ent);
+
+bool isDynamic(Entity* ent);
+void chunkRange(int x, int y, int w, int h, int margin, int* x1, int* y1, int* x2, int* y2);
+void readChunkBytes(int chunk_ix, void* buffer);
+void sendChunkMsg(ChunkMsg msg);
+void storeChunk(int chunk_ix, bool merge);
+void storeStrays();
+void writeLevel(ChunkMsg* msg);
+void swapLevelFile(ChunkMsg* msg, char* tmp_path, ChunkEntry* table);
+void releaseEntity(Entity* ent);
+void journalPath(char* path, int path_len, int generation);
+void removeJournalsBefore(int generation);
+void openJournal(int generation, char* mode);
+void journalOp(byte op, Entity* key, byte color_ix, Entity* ent);
+void flushJournal();
+bool replayJournal(int generation);
+size_t entityRecordBytes(void* buffer, size_t num_bytes);
+bool validChunk(void* buffer, size_t num_bytes, int len_entities);
+bool validLevelHeader(LevelHeader* header);
+bool validChunkEntry(ChunkEntry* entry, bool compressed, int64_t data_offset, int64_t file_len);
+size_t lzBound(size_t num_bytes);
+size_t lzCompress(byte* src, size_t src_len, byte* dst);
+size_t lzDecompress(byte* src, size_t src_len, byte* dst, size_t dst_len);
+void pushChunkMsg(ChunkQueue* queue, ChunkMsg msg);
+bool popChunkMsg(ChunkQueue* queue, ChunkMsg* msg);
+
+// dead zone makes it so light taps on controller joysticks doesn't drift the player
+const int JOYSTICK_DEAD_ZONE = 8000;
+
+// tools like bench.c include this file to get at the game's internals, w/out the game's main()
+#ifndef PLATFORMER_NO_MAIN
+int main(int num_args, char* args[]) {
+  char* record_path = NULL;
+  for (int i = 1; i < num_args; ++i) {
+    if (!strcmp(args[i], "--headless"))
+      headless = true;
+    else if (!strcmp(args[i], "--level") && i + 1 < num_args)
+      level_path = args[++i];
+    else if (!strcmp(args[i], "--trace") && i + 1 < num_args)
+      startTrace(args[++i]);
+    else if (!strcmp(args[i], "--record") && i + 1 < num_args)
+      record_path = args[++i];
+    else if (!strcmp(args[i], "--replay") && i + 1 < num_args)
+      startReplay(args[++i]);
+    else if (!strcmp(args[i], "--fps") && i + 1 < num_args)
+      pace_frame_ms = 1000.0 / atof(args[++i]);
+    else if (!strcmp(args[i], "--spin-ms") && i + 1 < num_args)
+      pace_spin_ms = atof(args[++i]);
+    else if (!strcmp(args[i], "--telemetry"))
+      telemetry_name = i + 1 < num_args && args[i + 1][0] == '/' ? args[++i] : TELEMETRY_NAME;
+    else if (!strcmp(args[i], "--threaded"))
+      threaded = true;
+    else if (!strcmp(args[i], "--workers") && i + 1 < num_args)
+      num_workers = atoi(args[++i]);
+  }
+  recording = record_path && !replaying;
+  threaded = threaded && !headless; // (a headless replay doesn't render, so there's nothing to pipeline)
+  if (telemetry_name)
+    startTelemetry(telemetry_name); // (after --threaded, which turns off the phase times)
+  if (!(pace_frame_ms > 0) || !isfinite(pace_frame_ms) || pace_spin_ms < 0) {
+    printf("--fps needs a positive rate & --spin-ms can't be negative\n");
+    return 1;
+  }
+  if (headless && !replaying) {
+    printf("--headless needs --replay\n");
+    return 1;
+  }
+
+  time_t seed = replaying ? rec_header.seed : 1529597895; //time(NULL);
+  srand(seed);
+  // printf("Seed: %lld\n", seed);
+
+  // SDL setup (a headless replay only needs timers & threads)
+  SDL_SetHint(SDL_HINT_JOYSTICK_ALLOW_BACKGROUND_EVENTS, "1");
+  if (SDL_Init(headless ? SDL_INIT_TIMER : SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_GAMECONTROLLER) < 0)
+    error("initializing SDL");
+  startJobs();
+
+  SDL_Window* window = NULL;
+  if (!headless) {
+    window = SDL_CreateWindow("Platformer", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 30 * 128, 30 * 128, SDL_WINDOW_RESIZABLE);
+    if (!window)
+      error("creating window");
+
+    if (SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN) < 0)
+      error("Toggling fullscreen mode failed");
+
+    // toggle_fullscreen(window);
+    SDL_GetWindowSize(window, &vp.w, &vp.h);
+    //vp.h -= header_height;
+  }
+
+  // a replay plays out in the viewport it was recorded in, whatever the window
+  if (replaying) {
+    vp.w = rec_header.vp_w;
+    vp.h = rec_header.vp_h;
+  }
+
+  loadLevel();
+
+  if (recording)
+    startRecording(record_path, seed);
+  if (replaying && levelHash() != rec_header.level_hash) {
+    printf("replay: the level isn't the one the recording was made on\n");
+    return 1;
   }
 
-  SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-  if (!renderer)
-    error("creating renderer");
+  SDL_Renderer* renderer = NULL;
+  if (!headless) {
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    if (!renderer)
+      error("creating renderer");
 
-  if (SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND) < 0)
-    error("setting blend mode");
+    if (SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND) < 0)
+      error("setting blend mode");
+  }
 
   // setup controllers (& controller joysticks)
-  bool has_controller = false;
-  int max_controllers = SDL_NumJoysticks();
+  int max_controllers = headless ? 0 : SDL_NumJoysticks();
   SDL_GameController* controllers[max_controllers];
   for (int i = 0; i < max_controllers; ++i) {
     if (SDL_IsGameController(i)) {
       controllers[i] = SDL_GameControllerOpen(i); // need to do this in order to receive events
-      has_controller = true;
     }
     else {
       controllers[i] = NULL;
@@ -287,48 +1088,59 @@ int main(int num_args, char* args[]) {
   unsigned int start_time = SDL_GetTicks();
   unsigned int pause_start = 0;
 
-  bool destroy_mode = false;
-  byte mode_type = WALL;
-  bool tile_mode = true;
-  bool mouse_is_down = false;
-  bool won_game = false;
-
-  left_pressed = false;
-  right_pressed = false;
+  world.left_pressed = false;
+  world.right_pressed = false;
 
   int colors_len = sizeof(colors) / sizeof(colors[0]);
-  int palette_color_size = 25;
   int palette_x = 0;
-  int palette_y = vp.h - palette_color_size;
+  palette_y = vp.h - palette_color_size;
   int palette_w = colors_len * palette_color_size;
   int palette_h = palette_color_size;
 
-  Shape* selected_shape = NULL;
+  // w/ --threaded, the frame's drawn from (& mouse clicks land in the viewport of) the newest snapshot the sim's published
+  // (w/out it, that's just the world)
+  Snapshot* snap = NULL;
+  bool snap_fresh = false;
+  if (threaded) {
+    startSim();
+    snap = takeSnapshot(&snap_fresh);
+  }
 
   while (!exit_game) {
-    // reset left/right every time when not using a controller
-    if (!has_controller) {
-      left_pressed = false;
-      right_pressed = false;
-    }
-    up_pressed = false;
-    down_pressed = false;
     bool was_paused = is_paused;
+    Viewport view = snap ? snap->vp : vp;
 
-    // we have to handle arrow keys via getKeyboardState() in order to support multiple keys at a time
-    // SDL_KEYDOWN events only allow one key at a time
-    const uint8_t *key_state = SDL_GetKeyboardState(NULL);
-    
-    while (SDL_PollEvent(&evt)) {
-      // this is above the input section b/c it's a pause condition & the pause short-circuits
-      // you win if you hit a Finish square
-      if (won_game) {
-        is_paused = true;
-        render_text(renderer, "You Won!", vp.w / 2 - 100, vp.h / 2, 4);
-        SDL_RenderPresent(renderer);
-      }
+#if PROFILE
+    // (w/ --threaded the sim times its phases at the same time, so there's no one frame to put them in)
+    if (!threaded)
+      profileFrame();
+#endif
+#ifdef TRACK_ALLOCS
+    allocFrame();
+#endif
+    if (telemetry && !threaded)
+      publishTelemetry(is_paused);
+    PROFILE_START(PHASE_INPUT);
+
+    // this is above the input section b/c it's a pause condition & the pause short-circuits
+    // you win if you hit a Finish square, which pauses the game (w/ "You Won!" drawn once, over the last frame)
+    if ((snap ? snap->won_game : world.won_game) && !is_paused && !headless) {
+      is_paused = true;
+      if (snap)
+        renderSnapshot(renderer, snap);
+      else
+        renderScene(renderer);
+      render_text(renderer, "You Won!", view.w / 2 - 100, view.h / 2, 4);
+      SDL_RenderPresent(renderer);
+    }
+
+    while (!headless && SDL_PollEvent(&evt)) {
+
+      // a replay's input all comes from the recording (apart from quitting, pausing & the profiler & heatmap)
+      SDL_Keycode sym = evt.key.keysym.sym;
+      if (replaying && evt.type != SDL_QUIT && !(evt.type == SDL_KEYDOWN && (sym == SDLK_ESCAPE || sym == SDLK_SPACE || sym == SDLK_F1 || sym == SDLK_F2)))
+        continue;
 
-      int mouse_x, mouse_y;
       switch(evt.type) {
         case SDL_QUIT:
           exit_game = true;
@@ -336,140 +1148,37 @@ int main(int num_args, char* args[]) {
         
         case SDL_WINDOWEVENT:
           if (evt.window.event == SDL_WINDOWEVENT_RESIZED) {
-            SDL_GetWindowSize(window, &vp.w, &vp.h);
+            int window_w, window_h;
+            SDL_GetWindowSize(window, &window_w, &window_h);
+            command(SIM_RESIZE, window_w, window_h);
             // vp.h -= header_height;
           }
           break;
 
         case SDL_MOUSEBUTTONUP:
-          mouse_is_down = false;
+          command(EDIT_RELEASE, 0, 0);
           break;
 
         case SDL_MOUSEBUTTONDOWN:
-          mouse_is_down = true;
-          mouse_x = evt.button.x + vp.x;
-          mouse_y = evt.button.y + vp.y;
-
-          if (mouse_x >= palette_x && mouse_x <= palette_x + palette_w && mouse_y >= palette_y && mouse_y <= palette_y + palette_h) {
-            curr_color_ix = (mouse_x - palette_x) / palette_color_size;
-            if (selected_shape)
-              selected_shape->stroke_color_ix = curr_color_ix;
-          }
-          else if (tile_mode) {
-            short x = mouse_x - (mouse_x % grid_size);
-            short y = mouse_y - (mouse_y % grid_size);
-
-            int existing_tile_ix = indexOfEntity(x, y, grid_size, grid_size);
-
-            if (existing_tile_ix > -1) {
-              destroy_mode = true;
-              deleteEntity(existing_tile_ix);
-            }
-            else {
-              destroy_mode = false;
-              Entity* ent = createEntity(mode_type, curr_color_ix, x, y, grid_size, grid_size);
-              Shape* shape = &(ent->shapes[0]);
-              fillShape(shape);
-              addRectPoints(shape, 0, 0, grid_size, grid_size);
-              if (mode_type == ENEMY) {
-                ent->dx = 1;
-                ent->grav_y = 0.2;
-              }
-            }
-          }
-          else { // drawing-mode
-            if (selected_shape) {
-              // x/y relative to entity
-              short x = mouse_x - entities[len_entities - 1].x;
-              short y = mouse_y - entities[len_entities - 1].y;
-
-              // snap to complete shape
-              if (abs(x - selected_shape->x[0]) < 8 && abs(y - selected_shape->y[0]) < 8 && selected_shape->len_vertices > 1) {
-                x = selected_shape->x[0];
-                y = selected_shape->y[0];
-                fillShape(selected_shape);
-              }
-
-              selected_shape->x[selected_shape->len_vertices - 1] = x;
-              selected_shape->y[selected_shape->len_vertices - 1] = y;
-              // FIX: this is confusing, its just checking whether we ran fillShape() above
-              if (selected_shape->fill_color_ix != NO_COLOR) {
-                selected_shape = NULL;
-              }
-              else {
-                updateEntityBBox(&(entities[len_entities - 1]));
-
-                // create new tentative point
-                addPoint(selected_shape, x, y);
-              }
-            }
-            else {
-              Entity* ent = createEntity(mode_type, curr_color_ix, mouse_x, mouse_y, 0, 0);
-              if (mode_type == ENEMY) {
-                ent->dx = 1;
-                ent->grav_y = 0.2;
-              }
-              selected_shape = &(ent->shapes[0]);
-
-              selected_shape->x[0] = 0;
-              selected_shape->y[0] = 0;
-              selected_shape->len_vertices = 2;
-              selected_shape->x[1] = 0;
-              selected_shape->y[1] = 0;
-            }
-          }
+          // the palette is drawn in screen space, so check it w/ screen coords
+          if (evt.button.x >= palette_x && evt.button.x <= palette_x + palette_w && evt.button.y >= palette_y && evt.button.y <= palette_y + palette_h)
+            command(EDIT_COLOR, (evt.button.x - palette_x) / palette_color_size, 0);
+          else
+            command(EDIT_PRESS, evt.button.x + view.x, evt.button.y + view.y);
           break;
 
         case SDL_MOUSEMOTION:
-          mouse_x = evt.button.x + vp.x;
-          mouse_y = evt.button.y + vp.y;
-          if (mouse_y < palette_y) {
-            if (tile_mode) {
-              if (mouse_is_down && mode_type != ENEMY) {
-                short x = mouse_x - (mouse_x % grid_size);
-                short y = mouse_y - (mouse_y % grid_size);
-                
-                if (destroy_mode) {
-                  int existing_tile_ix = indexOfEntity(x, y, grid_size, grid_size);
-                  if (existing_tile_ix > -1)
-                    deleteEntity(existing_tile_ix);
-                }
-                else {
-                  int existing_tile_ix = indexOfEntity(x, y, grid_size, grid_size);
-                  if (existing_tile_ix == -1) {
-                    Entity* ent = createEntity(mode_type, curr_color_ix, x, y, grid_size, grid_size);
-                    Shape* shape = &(ent->shapes[0]);
-                    fillShape(shape);
-                    addRectPoints(shape, 0, 0, grid_size, grid_size);
-                    if (mode_type == ENEMY) {
-                      ent->dx = 1;
-                      ent->grav_y = 0.2;
-                    }
-                  }
-                }
-              }
-            }
-            else { // drawing mode
-              if (selected_shape) {
-                // x/y relative to entity
-                short x = mouse_x - entities[len_entities - 1].x;
-                short y = mouse_y - entities[len_entities - 1].y;
-                
-                // snap to complete shape
-                if (abs(x - selected_shape->x[0]) < 8 && abs(y - selected_shape->y[0]) < 8) {
-                  x = selected_shape->x[0];
-                  y = selected_shape->y[0];
-                }
-
-                selected_shape->x[selected_shape->len_vertices - 1] = x;
-                selected_shape->y[selected_shape->len_vertices - 1] = y;
-              }
-            }
-          }
+          // (only when it does something, so recordings aren't mostly mouse movement: the sim checks w/ --threaded)
+          if (evt.motion.y < palette_y && (threaded || editDrags()))
+            command(EDIT_DRAG, evt.motion.x + view.x, evt.motion.y + view.y);
+          break;
 
+        case SDL_KEYUP:
+          pushArrowKey(&evt.key);
           break;
 
         case SDL_KEYDOWN:
+          pushArrowKey(&evt.key);
           if (evt.key.keysym.sym == SDLK_ESCAPE) {
             exit_game = true;
           }
@@ -477,144 +1186,99 @@ int main(int num_args, char* args[]) {
             is_paused = !is_paused;
           }
           else if (evt.key.keysym.sym == SDLK_t) {
-            tile_mode = !tile_mode;
+            command(EDIT_TILE_MODE, 0, 0);
           }
           else if (evt.key.keysym.sym == SDLK_s) {
-            level_file = fopen("current.level2", "wb"); // read binary
-
-            if (level_file) {
-              // calc the # of bytes we need
-              size_t num_bytes = sizeof(len_entities) + sizeof(level_w) + sizeof(level_h);
-              for (int i = 0; i < len_entities; ++i) {
-                Entity* entity = &entities[i];
-                num_bytes += sizeof(Entity);
-
-                for (int j = 0; j < entity->len_shapes; ++j) {
-                  Shape* shape = &(entity->shapes[j]);
-                  num_bytes += sizeof(Shape);
-                  num_bytes += shape->len_vertices * sizeof(short) * 2;
-                }
-              }
-
-              // malloc() a buffer & copy the bytes to the buffer
-              void* buffer = malloc(num_bytes);
-              void* buffer_ix = buffer;
-              memcpy(buffer_ix, &len_entities, sizeof(len_entities));
-              buffer_ix += sizeof(len_entities);
-              memcpy(buffer_ix, &level_w, sizeof(level_w));
-              buffer_ix += sizeof(level_w);
-              memcpy(buffer_ix, &level_h, sizeof(level_h));
-              buffer_ix += sizeof(level_h);
-
-              for (int i = 0; i < len_entities; ++i) {
-                Entity* entity = &entities[i];
-                memcpy(buffer_ix, entity, sizeof(Entity));
-                buffer_ix += sizeof(Entity);
-
-                for (int j = 0; j < entity->len_shapes; ++j) {
-                  Shape* shape = &(entity->shapes[j]);
-                  memcpy(buffer_ix, shape, sizeof(Shape));
-                  buffer_ix += sizeof(Shape);
-
-                  // copy x & y vertices
-                  memcpy(buffer_ix, shape->x, shape->len_vertices * sizeof(short));
-                  buffer_ix += shape->len_vertices * sizeof(short);
-                  memcpy(buffer_ix, shape->y, shape->len_vertices * sizeof(short));
-                  buffer_ix += shape->len_vertices * sizeof(short);
-                }
-              }
-
-              // sanity check
-              if (buffer_ix - buffer != num_bytes) {
-                printf("%lu - num_bytes\n", num_bytes);
-                printf("%lu - pointer diff\n", buffer_ix - buffer);
-                error("byte mismatch on file save");
-              }
-              
-              // write the bytes to the file
-              fwrite(buffer, num_bytes, 1, level_file); // write bytes to file
-              if (ferror(level_file))
-                error("writing level file");
-              
-              fclose(level_file);
-              free(buffer);
-            }
+            command(SIM_SAVE, 0, 0);
+          }
+#if PROFILE
+          else if (evt.key.keysym.sym == SDLK_F1) {
+            if (threaded)
+              showMainNote("The profiler isn't available w/ --threaded");
+            else
+              show_profiler = !show_profiler;
           }
+          else if (evt.key.keysym.sym == SDLK_F2) {
+            // (it draws from the live world, which only the sim can look at w/ --threaded)
+            if (threaded)
+              showMainNote("The heatmap isn't available w/ --threaded");
+            else
+              toggleHeatmap();
+          }
+#endif
           else if (evt.key.keysym.sym == SDLK_RETURN) {
-            if (selected_shape) {
-              selected_shape->len_vertices--;
-              selected_shape = NULL;
-            }
+            command(EDIT_FINISH, 0, 0);
           }
           else if (evt.key.keysym.sym == SDLK_g) {
-            mode_type = REVERSE_GRAV;
+            command(EDIT_MODE, REVERSE_GRAV, 0);
           }
           else if (evt.key.keysym.sym == SDLK_w) {
-            mode_type = WALL;
+            command(EDIT_MODE, WALL, 0);
           }
           else if (evt.key.keysym.sym == SDLK_l) {
-            mode_type = LAVA;
+            command(EDIT_MODE, LAVA, 0);
           }
           else if (evt.key.keysym.sym == SDLK_f) {
-            mode_type = FINISH;
+            command(EDIT_MODE, FINISH, 0);
           }
           else if (evt.key.keysym.sym == SDLK_c) {
-            mode_type = CHECKPOINT;
+            command(EDIT_MODE, CHECKPOINT, 0);
           }
           else if (evt.key.keysym.sym == SDLK_p) {
-            mode_type = PORTAL;
+            command(EDIT_MODE, PORTAL, 0);
           }
           else if (evt.key.keysym.sym == SDLK_m) {
-            mode_type = ENEMY;
+            command(EDIT_MODE, ENEMY, 0);
+          }
+          else if (evt.key.keysym.sym == SDLK_r) {
+            command(EDIT_WAKE, 0, 0);
+          }
+          else if (evt.key.keysym.sym == SDLK_z) {
+            command(EDIT_UNDO, 0, 0);
+          }
+          else if (evt.key.keysym.sym == SDLK_y) {
+            command(EDIT_REDO, 0, 0);
+          }
+          else if (evt.key.keysym.sym == SDLK_1) {
+            command(EDIT_TOOL, TOOL_PAINT, 0);
+          }
+          else if (evt.key.keysym.sym == SDLK_2) {
+            command(EDIT_TOOL, TOOL_RECT, 0);
+          }
+          else if (evt.key.keysym.sym == SDLK_3) {
+            command(EDIT_TOOL, TOOL_FLOOD, 0);
           }
           break;
 
         case SDL_JOYAXISMOTION:
           // X axis
           if (evt.jaxis.axis == 0) {
-            if (evt.jaxis.value < -JOYSTICK_DEAD_ZONE) {
-              left_pressed = true;
-            }
-            else if (evt.jaxis.value > JOYSTICK_DEAD_ZONE) {
-              right_pressed = true;
-            }
-            else {
-              right_pressed = false;
-              left_pressed = false;
-            }
+            pushInput(INPUT_PAD_LEFT, evt.jaxis.value < -JOYSTICK_DEAD_ZONE, evt.jaxis.timestamp);
+            pushInput(INPUT_PAD_RIGHT, evt.jaxis.value > JOYSTICK_DEAD_ZONE, evt.jaxis.timestamp);
           }
           break;
 
         case SDL_CONTROLLERBUTTONDOWN:
-          if (evt.cbutton.button == SDL_CONTROLLER_BUTTON_A) {
-            if (player.grav_y > 0.0) {
-              up_pressed = true;
-            }
-            else if (player.grav_y < 0.0) {
-              down_pressed = true;
-            }
-          }
+        case SDL_CONTROLLERBUTTONUP:
+          if (evt.cbutton.button == SDL_CONTROLLER_BUTTON_A)
+            pushInput(INPUT_PAD_JUMP, evt.type == SDL_CONTROLLERBUTTONDOWN, evt.cbutton.timestamp);
           break;
       }
     }
-
-    if (key_state[SDL_SCANCODE_LEFT])
-      left_pressed = true;
-    if (key_state[SDL_SCANCODE_RIGHT])
-      right_pressed = true;
-    if (key_state[SDL_SCANCODE_UP])
-      up_pressed = true;
-    if (key_state[SDL_SCANCODE_DOWN])
-      down_pressed = true;
+    PROFILE_STOP(PHASE_INPUT);
+    if (threaded && SDL_AtomicGet(&sim_paused) != is_paused) {
+      SDL_AtomicSet(&sim_paused, is_paused);
+      SDL_SemPost(sim_wake);
+    }
 
     // handle pause state
     if (was_paused || is_paused) {
       if (!pause_start)
         pause_start = SDL_GetTicks();
 
-      // still paused
+      // still paused: sleep until there's an event to look at (it's left in the queue for the next pass)
       if (is_paused) {
-        SDL_Delay(10);
+        SDL_WaitEvent(NULL);
         continue;
       }
       // coming out of paused state
@@ -626,6 +1290,8 @@ int main(int num_args, char* args[]) {
         // add elapsed pause time to start time, otherwise the pause time is added to the clock
         start_time += last_loop_time - pause_start;
         pause_start = 0;
+        if (!threaded)
+          pace_deadline = 0; // (the sim restarts its own schedule)
       }
     }
 
@@ -633,204 +1299,122 @@ int main(int num_args, char* args[]) {
     unsigned int curr_time = SDL_GetTicks();
     double dt = (curr_time - last_loop_time) / 1000.0; // dt should always be in seconds
 
-
-    // left/right movement
-    if (left_pressed)
-      player.dx = -move_speed;
-    else if (right_pressed)
-      player.dx = move_speed;
-    else
-      player.dx = 0;
-    
-    // gravity
-    if ((player.grav_y > 0 && player.dy < 10) || (player.grav_y < 0 && player.dy > -10))
-      player.dy += player.grav_y;
-
-    for (int i = 0; i < len_entities; ++i) {
-      Entity* ent = &(entities[i]);
-      if (ent->grav_y && ((ent->grav_y > 0 && ent->dy < 10) || (ent->grav_y < 0 && ent->dy > -10)))
-        ent->dy += ent->grav_y;
-    }
-
-    if (will_collide(&player, REVERSE_GRAV) > -1)
-      player.grav_y = -player.grav_y;
-
-    if (will_collide(&player, FINISH) > -1)
-      won_game = true;
-
-    if (will_collide(&player, CHECKPOINT) > -1) {
-      start_x = player.x;
-      start_y = player.y;
-      start_grav = player.grav_y;
-    }
-
-    int portal_ix = will_collide(&player, PORTAL);
-    if (portal_ix > -1) {
-      for (int i = 0; i < len_entities; ++i) {
-        if (i != portal_ix && entities[i].flags & PORTAL) {
-          int delta_x = entities[i].x - entities[portal_ix].x;
-          int delta_y = entities[i].y - entities[portal_ix].y;
-          player.x += delta_x;
-          player.y += delta_y;
-          player.dx = -player.dx;
-          player.dy = -player.dy;
-          break;
-        }
+    if (!threaded) {
+      int stepped = tick();
+      if (stepped < 0)
+        break;
+      if (!stepped) {
+        SDL_Delay(1);
+        continue;
       }
     }
-
-    // start over if you hit lava or an enemy or fall offscreen
-    if ((will_collide(&player, LAVA) > -1) || (will_collide(&player, ENEMY) > -1) ||
-      player.x < 0 || player.x > vp.w || player.y < 0 || player.y > vp.h) {
-      player.grav_y = start_grav;
-      player.dx = 0;
-      player.dy = 0;
-      player.x = start_x;
-      player.y = start_y;
-    }
-
-    // if touching ground, & jump button pressed, jump
-    if (up_pressed && collides(player.x, player.y + 1, player.w, player.h, -1, entities, WALL) > -1)
-      player.dy = -jump_speed;
-    else if (down_pressed && collides(player.x, player.y - 1, player.w, player.h, -1, entities, WALL) > -1)
-      player.dy = jump_speed;
-
-    // if it's going to collide (horiz), inch there 1px at a time
-    if (collides(player.x + player.dx, player.y, player.w, player.h, -1, entities, WALL) > -1 && player.dx) {
-      while (!(collides(player.x + sign(player.dx), player.y, player.w, player.h, -1, entities, WALL) > -1))
-        player.x += sign(player.dx);
-      
-      player.dx = 0;
-    }
-    player.x += player.dx;
-
-    // if it's going to collid (vert), inch there 1px at a time
-    if (collides(player.x, player.y + player.dy, player.w, player.h, -1, entities, WALL) > -1 && player.dy) {
-      while (!(collides(player.x, player.y + sign(player.dy), player.w, player.h, -1, entities, WALL) > -1))
-        player.y += sign(player.dy);
-      
-      player.dy = 0;
+    else if (SDL_AtomicGet(&sim_done)) {
+      break;
     }
-    player.y += player.dy;
 
-    // if an enemy is going to collide, inch there & *reverse* the direction
-    for (int i = 0; i < len_entities; ++i) {
-      Entity* ent = &(entities[i]);
-      if (ent->dx) {
-        if (collides(ent->x + ent->dx, ent->y, ent->w, ent->h, i, entities, WALL) > -1 && ent->dx) {
-          while (!(collides(ent->x + sign(ent->dx), ent->y, ent->w, ent->h, i, entities, WALL) > -1))
-            ent->x += sign(ent->dx);
-          
-          ent->dx = -ent->dx;
-        }
-        else {
-          ent->x += ent->dx;
-        }
-      }
+    if (headless)
+      continue;
 
-      if (ent->dy) {
-        if (collides(ent->x, ent->y + ent->dy, ent->w, ent->h, i, entities, WALL) > -1 && ent->dy) {
-          while (!(collides(ent->x, ent->y + sign(ent->dy), ent->w, ent->h, i, entities, WALL) > -1))
-            ent->y += sign(ent->dy);
-          
-          ent->dy = -ent->dy / 8;
-        }
-        else {
-          ent->y += ent->dy;
-        }
-      }
+    PROFILE_START(PHASE_RENDER);
+    if (threaded) {
+      snap = takeSnapshot(&snap_fresh);
+      renderSnapshot(renderer, snap);
     }
-
-    // if an enemy goes offscreen, delete it
-    // we do this in a separate loop b/c deleteEntity() moves the last entity to earlier in the loop
-    // and will cause the loop to skip that last entity
-    for (int i = 0; i < len_entities; ++i) {
-      Entity* ent = &(entities[i]);
-      if (ent->dx && (ent->x + ent->w < 0 || ent->x > vp.w))
-        deleteEntity(i);
-      else if (ent->dy && (ent->y + ent->h < 0 || ent->y > vp.h))
-        deleteEntity(i);
+    else {
+      renderScene(renderer);
     }
+    PROFILE_STOP(PHASE_RENDER);
 
-    // set BG color
-    if (SDL_SetRenderDrawColor(renderer, 44, 34, 30, 255) < 0)
-      error("setting bg color");
-    if (SDL_RenderClear(renderer) < 0)
-      error("clearing renderer");
-
-    // render polygon
-    for (int i = 0; i < len_entities; ++i) {
-      Entity* ent = &entities[i];
-      Shape* shape = &(ent->shapes[0]);
-
-      short *vx = shape->x;
-      short *vy = shape->y;
-      if (shape->fill_color_ix != NO_COLOR) {
-        aapolygonColor(renderer, ent->x, ent->y, vx, vy, shape->len_vertices, colors[shape->fill_color_ix]);
-        filledPolygonColor(renderer, ent->x, ent->y, vx, vy, shape->len_vertices, colors[shape->fill_color_ix]);// 0xFF000000);
-      }
-      else {
-        for (int j = 0; j < shape->len_vertices - 1; ++j)
-          aalineColor(renderer, vx[j] + ent->x, vy[j] + ent->y, vx[j + 1] + ent->x, vy[j + 1] + ent->y, colors[shape->stroke_color_ix]);
-      }
+#if PROFILE
+    if (show_heatmap || show_profiler) {
+      PROFILE_START(PHASE_HUD);
+      if (show_heatmap)
+        renderHeatmap(renderer);
+      if (show_profiler)
+        renderProfiler(renderer);
+      PROFILE_STOP(PHASE_HUD);
     }
+#endif
 
-    // draw palette
-    for (int i = 0; i < colors_len; ++i)
-      boxColor(renderer, i * palette_color_size, palette_y, i * palette_color_size + palette_color_size, palette_y + palette_h, colors[i]);
-
-    // render player
-    if (SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255) < 0)
-      error("setting player color");
-
-    SDL_Rect player_rect = {
-      .x = player.x - vp.x,
-      .y = player.y - vp.y,
-      .w = player.w,
-      .h = player.h
-    };
-    if (SDL_RenderFillRect(renderer, &player_rect) < 0)
-      error("filling player rect");
-
+    PROFILE_START(PHASE_PRESENT);
     SDL_RenderPresent(renderer);
-    SDL_Delay(10);
+    PROFILE_STOP(PHASE_PRESENT);
+#if PROFILE
+    if (snap && snap_fresh && snap->input_latched_any)
+      profile_latency[profile_frame] = SDL_GetTicks() - snap->input_oldest;
+    else if (!snap && input_latched_any && !was_paused)
+      profile_latency[profile_frame] = SDL_GetTicks() - input_oldest;
+#endif
+    if (threaded)
+      waitForSnapshot();
+    else
+      paceFrame();
   }
 
-  // free dynamically allocated memory
-  for (int i = 0; i < len_entities; ++i) {
-    Entity* ent = &entities[i];
-    for (int j = 0; j < ent->len_shapes; ++j) {
-      Shape* shape = &(ent->shapes[j]);
-      free(shape->x);
-      free(shape->y);
-    }
-    free(ent->shapes);
-  }
+  if (threaded)
+    stopSim();
+  int exit_code = 0;
+  if (recording)
+    stopRecording();
+  if (replaying && !stopReplay())
+    exit_code = 1;
+
+#ifdef TRACK_ALLOCS
+  alloc_in_frame_loop = false;
+#endif
+
+  unloadLevel();
+  stopJobs();
+  if (tracing)
+    stopTrace();
+  if (telemetry)
+    stopTelemetry();
 
   for (int i = 0; i < max_controllers; ++i)
     if (controllers[i])
       SDL_GameControllerClose(controllers[i]);
 
-  if (SDL_SetWindowFullscreen(window, 0) < 0)
-    error("exiting fullscreen");
+  if (window) {
+    if (SDL_SetWindowFullscreen(window, 0) < 0)
+      error("exiting fullscreen");
 
-  SDL_DestroyWindow(window);
+    SDL_DestroyWindow(window);
+  }
   SDL_Quit();
-  return 0;
+#ifdef TRACK_ALLOCS
+  allocReport();
+#endif
+  return exit_code;
 }
+#endif
+
+Entity* createEntity(byte mode_type, byte color_ix, int x, int y, short w, short h) {
+  traceInstant(trace_world, "createEntity");
+  world_version++;
+  reserveEntities(len_entities + 1);
+  chunks[chunkIndexAt(x, y)].dirty = true;
 
-Entity* createEntity(byte mode_type, byte color_ix, short x, short y, short w, short h) {
   entities[len_entities].flags = WALL | mode_type;
-  entities[len_entities].shapes = (Shape*)calloc(64, sizeof(Shape)),
+  entities[len_entities].shapes = (Shape*)calloc(MAX_SHAPES, sizeof(Shape)),
   entities[len_entities].len_shapes++;
-  entities[len_entities].shapes[0].x = (short*)calloc(64, sizeof(short));
-  entities[len_entities].shapes[0].y = (short*)calloc(64, sizeof(short));
+  entities[len_entities].shapes[0].x = (short*)calloc(MAX_VERTICES, sizeof(short));
+  entities[len_entities].shapes[0].y = (short*)calloc(MAX_VERTICES, sizeof(short));
   entities[len_entities].shapes[0].stroke_color_ix = color_ix;
   entities[len_entities].shapes[0].fill_color_ix = NO_COLOR;
   entities[len_entities].x = x;
   entities[len_entities].y = y;
   entities[len_entities].w = w;
   entities[len_entities].h = h;
+  if (mode_type == ENEMY) {
+    // enemies start off walking right (set before it's filed in box_index, which only files static boxes by square)
+    entities[len_entities].dx = 1;
+    entities[len_entities].grav_y = 0.2;
+  }
+  if (spawns) {
+    spawns[len_entities].x = x;
+    spawns[len_entities].y = y;
+  }
+  boxInsert(&box_index, len_entities);
   
   len_entities++;
 
@@ -839,22 +1423,74 @@ Entity* createEntity(byte mode_type, byte color_ix, short x, short y, short w, s
 
 // delete by copying the tip entity over the one to remove
 void deleteEntity(int entity_ix) {
+  traceInstant(trace_world, "deleteEntity");
+  world_version++;
   Entity* ent = &(entities[entity_ix]);
-  // DRY violation: fix
+  chunks[chunkIndexAt(ent->x, ent->y)].dirty = true;
+  if (selected_shape == ent->shapes)
+    selected_shape = NULL; // (it was the shape being drawn)
+  releaseEntity(ent);
+
+  boxRemove(&box_index, entity_ix);
+  if (entity_ix != len_entities - 1)
+    boxMove(&box_index, len_entities - 1, entity_ix);
+  entities[entity_ix] = entities[len_entities - 1];
+  if (spawns)
+    spawns[entity_ix] = spawns[len_entities - 1];
+  memset(&entities[len_entities - 1], 0, sizeof(Entity));
+  len_entities--;
+}
+
+void freeEntity(Entity* ent) {
   for (int j = 0; j < ent->len_shapes; ++j) {
     Shape* shape = &(ent->shapes[j]);
     free(shape->x);
     free(shape->y);
   }
   free(ent->shapes);
+}
 
-  entities[entity_ix] = entities[len_entities - 1];
-  memset(&entities[len_entities - 1], 0, sizeof(Entity));
-  len_entities--;
+// free an entity's shapes, unless a save that's being written might still be reading them
+void releaseEntity(Entity* ent) {
+  if (!save_in_flight) {
+    freeEntity(ent);
+    return;
+  }
+
+  if (len_unfreed_entities == max_unfreed_entities) {
+    max_unfreed_entities = max_unfreed_entities ? max_unfreed_entities * 2 : 64;
+    unfreed_entities = (Entity*)realloc(unfreed_entities, max_unfreed_entities * sizeof(Entity));
+  }
+  unfreed_entities[len_unfreed_entities++] = *ent;
+}
+
+// grow `entities` (by doubling) so it can hold at least num_entities
+void reserveEntities(int num_entities) {
+  if (num_entities <= max_entities)
+    return;
+
+  int new_max = max_entities ? max_entities : 128;
+  while (new_max < num_entities)
+    new_max *= 2;
+
+  Entity* new_entities = (Entity*)realloc(entities, new_max * sizeof(Entity));
+  if (!new_entities)
+    error("growing entities");
+  memset(&new_entities[max_entities], 0, (new_max - max_entities) * sizeof(Entity));
+  if (spawns) {
+    spawns = (Spawn*)realloc(spawns, new_max * sizeof(Spawn));
+    if (!spawns)
+      error("growing spawns");
+  }
+
+  entities = new_entities;
+  max_entities = new_max;
 }
 
+// (ent's one of `entities`, & it's filed in box_index again under its new box)
 void updateEntityBBox(Entity* ent) {
   Shape* shape = &(ent->shapes[0]);
+  boxRemove(&box_index, ent - entities);
 
   // update entity's bounding box by iterating vertices
   short min_x = shape->x[0];
@@ -893,16 +1529,12 @@ void updateEntityBBox(Entity* ent) {
   // the width/height should reflect the max x/y, once points are all relative to the entity
   ent->w = max_x;
   ent->h = max_y;
+  boxInsert(&box_index, ent - entities);
 }
 
-int indexOfEntity(short x, short y, short w, short h) {
-  // check if there's already a tile here
-  int existing_ent_ix = -1;
-  for (int i = 0; i < len_entities; ++i)
-    if (entities[i].x == x && entities[i].y == y && entities[i].h == h && entities[i].w == w)
-      existing_ent_ix = i;
-
-  return existing_ent_ix;
+// the last entity w/ this box (e.g. the tile at a cell), or -1
+int indexOfEntity(int x, int y, short w, short h) {
+  return boxFind(&box_index, x, y, w, h);
 }
 
 // adds 5 points (4 lines) to create a closed rectangle polygon
@@ -915,6 +1547,9 @@ void addRectPoints(Shape* shape, short x, short y, short w, short h) {
 }
 
 void addPoint(Shape* shape, short x, short y) {
+  if (shape->len_vertices == MAX_VERTICES)
+    return;
+
   shape->x[shape->len_vertices] = x;
   shape->y[shape->len_vertices] = y;
   shape->len_vertices++;
@@ -926,72 +1561,4678 @@ void fillShape(Shape* shape) {
   shape->stroke_color_ix = NO_COLOR;
 }
 
-int render_text(SDL_Renderer* renderer, char str[], int offset_x, int offset_y, int size) {
-  int i;
-  for (i = 0; str[i] != '\0'; ++i) {
-    int code = str[i];
-    if (code < 0 || code > 127)
-      error("Text code out of range");
+// whether dragging the mouse does anything right now (painting tiles, dragging out a rectangle or placing a vertex)
+bool editDrags() {
+  return (tile_mode && mouse_is_down && mode_type != ENEMY && tile_tool != TOOL_FLOOD) || (!tile_mode && selected_shape);
+}
 
-    char* bitmap = font8x8_basic[code];
-    int set = 0;
-    for (int y = 0; y < 8; ++y) {
-      for (int x = 0; x < 8; ++x) {
-        set = bitmap[y] & 1 << x;
-        if (!set)
-          continue;
+// an edit or SIM_* command from the main thread: run now, or queued for the sim to run before its next tick w/ --threaded
+void command(byte type, int x, int y) {
+  EditAction action = { .type = type, .x = x, .y = y };
+  if (!threaded) {
+    runCommand(action);
+    return;
+  }
 
-        SDL_Rect r = {
-          .x = offset_x + i * (size) * 8 + x * size,
-          .y = offset_y + y * size,
-          .w = size,
-          .h = size
-        };
-        if (SDL_RenderFillRect(renderer, &r) < 0)
-          error("drawing text block");
+  SDL_LockMutex(sim_commands_lock);
+  CommandQueue* queue = &sim_commands[sim_commands_in];
+  if (queue->len == queue->max) {
+    queue->max = queue->max ? queue->max * 2 : 64;
+    queue->actions = (EditAction*)realloc(queue->actions, queue->max * sizeof(EditAction));
+    if (!queue->actions)
+      error("queueing command");
+  }
+  queue->actions[queue->len++] = action;
+  SDL_UnlockMutex(sim_commands_lock);
+  // (a running sim picks commands up every tick, so only a paused one needs waking, or the posts would pile up)
+  if (SDL_AtomicGet(&sim_paused))
+    SDL_SemPost(sim_wake);
+}
+
+void runCommand(EditAction action) {
+  if (action.type == SIM_SAVE) {
+    saveLevel(selected_shape != NULL);
+  }
+  else if (action.type == SIM_RESIZE) {
+    vp.w = action.x;
+    vp.h = action.y;
+  }
+  else if (action.type != EDIT_DRAG || editDrags()) {
+    edit(action.type, action.x, action.y);
+  }
+}
+
+// record an editor action (when recording) & apply it
+void edit(byte type, int x, int y) {
+  EditAction action = { .type = type, .x = x, .y = y };
+  if (recording) {
+    if (len_rec_edits == max_rec_edits) {
+      max_rec_edits = max_rec_edits ? max_rec_edits * 2 : 64;
+      rec_edits = (EditAction*)realloc(rec_edits, max_rec_edits * sizeof(EditAction));
+    }
+    rec_edits[len_rec_edits++] = action;
+  }
+  applyEdit(action);
+}
+
+// what the mouse & editor keys do (x/y are in level coords)
+void applyEdit(EditAction action) {
+  int mouse_x = action.x;
+  int mouse_y = action.y;
+  world_version++;
+  if (action.type != EDIT_DRAG)
+    undo_begin = true; // (drags are part of the press's transaction)
+
+  if (action.type == EDIT_RELEASE) {
+    if (dragging_fill) {
+      SDL_Rect rect = fillPreview();
+      if (destroy_mode)
+        clearRect(rect.x, rect.y, rect.x + rect.w, rect.y + rect.h);
+      else
+        fillRect(rect.x, rect.y, rect.x + rect.w, rect.y + rect.h);
+      dragging_fill = false;
+    }
+    mouse_is_down = false;
+  }
+  else if (action.type == EDIT_COLOR) {
+    mouse_is_down = true;
+    curr_color_ix = action.x;
+    if (selected_shape) {
+      byte old_color_ix = selected_shape->stroke_color_ix;
+      selected_shape->stroke_color_ix = curr_color_ix;
+      journalOp(JOURNAL_RECOLOR, &entities[len_entities - 1], curr_color_ix, NULL);
+      logRecolor(&entities[len_entities - 1], old_color_ix);
+    }
+  }
+  else if (action.type == EDIT_PRESS) {
+    mouse_is_down = true;
+    if (tile_mode && tile_tool != TOOL_PAINT && mode_type != ENEMY) {
+      int x = mouse_x - (mouse_x % grid_size);
+      int y = mouse_y - (mouse_y % grid_size);
+
+      // starting on something clears the rectangle instead of filling it
+      destroy_mode = collides(x, y, grid_size, grid_size, -1, entities, WALL) > -1;
+      if (tile_tool == TOOL_FLOOD) {
+        floodFill(x, y);
+      }
+      else {
+        dragging_fill = true;
+        fill_x1 = fill_x2 = x;
+        fill_y1 = fill_y2 = y;
+      }
+    }
+    else if (tile_mode) {
+      int x = mouse_x - (mouse_x % grid_size);
+      int y = mouse_y - (mouse_y % grid_size);
+
+      int existing_tile_ix = tileAt(x, y);
+
+      if (existing_tile_ix > -1) {
+        destroy_mode = true;
+        eraseCell(existing_tile_ix, x, y);
+      }
+      else {
+        destroy_mode = false;
+        Entity* ent = createEntity(mode_type, curr_color_ix, x, y, grid_size, grid_size);
+        Shape* shape = &(ent->shapes[0]);
+        fillShape(shape);
+        addRectPoints(shape, 0, 0, grid_size, grid_size);
+        journalOp(JOURNAL_CREATE, ent, 0, ent);
+        logCreate(ent);
+      }
+    }
+    else { // drawing-mode
+      if (selected_shape) {
+        Entity key = entities[len_entities - 1];
+        byte before[entityBytes(&key)];
+        writeEntity(before, &key);
+
+        // x/y relative to entity
+        short x = mouse_x - entities[len_entities - 1].x;
+        short y = mouse_y - entities[len_entities - 1].y;
+
+        // snap to complete shape
+        if (abs(x - selected_shape->x[0]) < 8 && abs(y - selected_shape->y[0]) < 8 && selected_shape->len_vertices > 1) {
+          x = selected_shape->x[0];
+          y = selected_shape->y[0];
+          fillShape(selected_shape);
+        }
+
+        selected_shape->x[selected_shape->len_vertices - 1] = x;
+        selected_shape->y[selected_shape->len_vertices - 1] = y;
+        // FIX: this is confusing, its just checking whether we ran fillShape() above
+        if (selected_shape->fill_color_ix != NO_COLOR) {
+          selected_shape = NULL;
+        }
+        else {
+          updateEntityBBox(&(entities[len_entities - 1]));
+
+          // create new tentative point
+          addPoint(selected_shape, x, y);
+        }
+        journalOp(JOURNAL_VERTEX, &key, 0, &entities[len_entities - 1]);
+        logVertex(before, sizeof(before), &entities[len_entities - 1]);
+      }
+      else {
+        Entity* ent = createEntity(mode_type, curr_color_ix, mouse_x, mouse_y, 0, 0);
+        selected_shape = &(ent->shapes[0]);
+
+        selected_shape->x[0] = 0;
+        selected_shape->y[0] = 0;
+        selected_shape->len_vertices = 2;
+        selected_shape->x[1] = 0;
+        selected_shape->y[1] = 0;
+        journalOp(JOURNAL_CREATE, ent, 0, ent);
+        logCreate(ent);
       }
     }
   }
+  else if (action.type == EDIT_DRAG) {
+    if (dragging_fill) {
+      fill_x2 = mouse_x - (mouse_x % grid_size);
+      fill_y2 = mouse_y - (mouse_y % grid_size);
+    }
+    else if (tile_mode) {
+      if (mouse_is_down && mode_type != ENEMY && tile_tool == TOOL_PAINT) {
+        int x = mouse_x - (mouse_x % grid_size);
+        int y = mouse_y - (mouse_y % grid_size);
 
-  // width of total text string
-  return i * size * 8;
+        if (destroy_mode) {
+          int existing_tile_ix = tileAt(x, y);
+          if (existing_tile_ix > -1)
+            eraseCell(existing_tile_ix, x, y);
+        }
+        else {
+          int existing_tile_ix = tileAt(x, y);
+          if (existing_tile_ix == -1) {
+            Entity* ent = createEntity(mode_type, curr_color_ix, x, y, grid_size, grid_size);
+            Shape* shape = &(ent->shapes[0]);
+            fillShape(shape);
+            addRectPoints(shape, 0, 0, grid_size, grid_size);
+            journalOp(JOURNAL_CREATE, ent, 0, ent);
+            logCreate(ent);
+          }
+        }
+      }
+    }
+    else { // drawing mode
+      if (selected_shape) {
+        // x/y relative to entity
+        short x = mouse_x - entities[len_entities - 1].x;
+        short y = mouse_y - entities[len_entities - 1].y;
+
+        // snap to complete shape
+        if (abs(x - selected_shape->x[0]) < 8 && abs(y - selected_shape->y[0]) < 8) {
+          x = selected_shape->x[0];
+          y = selected_shape->y[0];
+        }
+
+        selected_shape->x[selected_shape->len_vertices - 1] = x;
+        selected_shape->y[selected_shape->len_vertices - 1] = y;
+      }
+    }
+  }
+  else if (action.type == EDIT_MODE) {
+    mode_type = action.x;
+  }
+  else if (action.type == EDIT_TILE_MODE) {
+    tile_mode = !tile_mode;
+  }
+  else if (action.type == EDIT_FINISH) {
+    if (selected_shape) {
+      byte before[entityBytes(&entities[len_entities - 1])];
+      writeEntity(before, &entities[len_entities - 1]);
+      selected_shape->len_vertices--;
+      selected_shape = NULL;
+      journalOp(JOURNAL_VERTEX, &entities[len_entities - 1], 0, &entities[len_entities - 1]);
+      logVertex(before, sizeof(before), &entities[len_entities - 1]);
+    }
+  }
+  else if (action.type == EDIT_WAKE) {
+    // (kept in the level's flags, so it sticks once the level's saved)
+    wake_reset = !wake_reset;
+    trackSpawns(wake_reset);
+    showNote(wake_reset ? "Enemies wake up where they spawned" : "Enemies wake up where they'd be");
+  }
+  else if (action.type == EDIT_UNDO || action.type == EDIT_REDO) {
+    undoEdits(action.type == EDIT_REDO);
+  }
+  else if (action.type == EDIT_TOOL) {
+    char* tool_names[] = { "Paint", "Rectangle fill", "Flood fill" };
+    tile_tool = action.x <= TOOL_FLOOD ? action.x : TOOL_PAINT;
+    showNote(tool_names[tile_tool]);
+  }
 }
 
-int will_collide(Entity* ent, byte type) {
-  return collides(ent->x + ent->dx, ent->y + ent->dy, ent->w, ent->h, -1, entities, type);
+// the rectangle being dragged out w/ TOOL_RECT (in level coords, covering both corners' cells), or an empty one
+SDL_Rect fillPreview() {
+  SDL_Rect rect = { 0, 0, 0, 0 };
+  if (!dragging_fill)
+    return rect;
+
+  rect.x = fill_x1 < fill_x2 ? fill_x1 : fill_x2;
+  rect.y = fill_y1 < fill_y2 ? fill_y1 : fill_y2;
+  rect.w = abs(fill_x2 - fill_x1) + grid_size;
+  rect.h = abs(fill_y2 - fill_y1) + grid_size;
+  return rect;
 }
 
-int collides(int x, int y, int w, int h, int ix, Entity entities[], byte type) {
-  int x2 = x + w;
-  int y2 = y + h;
+// what a fill map's cells hold
+#define CELL_EMPTY 0
+#define CELL_TAKEN 1 // something's there (or might be: its chunk isn't resident)
+#define CELL_FILL  2 // to be filled
+#define CELL_DONE  3 // covered by one of the fill's rectangles
+
+// a map of the level's cells over the resident chunks (w/ the non-resident ones among them all taken), to fill in w/out
+// checking entities cell by cell: its first cell & size (in cells) are returned in map_x/y/w/h, or NULL if nothing's resident
+byte* mapCells(int* map_x, int* map_y, int* map_w, int* map_h) {
+  int chunk_x1 = chunks_w;
+  int chunk_y1 = chunks_h;
+  int chunk_x2 = -1;
+  int chunk_y2 = -1;
+  for (int i = 0; i < len_live_chunks; ++i) {
+    if (chunks[live_chunks[i]].state != CHUNK_RESIDENT)
+      continue;
+    int cx = live_chunks[i] % chunks_w;
+    int cy = live_chunks[i] / chunks_w;
+    if (cx < chunk_x1)
+      chunk_x1 = cx;
+    if (cy < chunk_y1)
+      chunk_y1 = cy;
+    if (cx > chunk_x2)
+      chunk_x2 = cx;
+    if (cy > chunk_y2)
+      chunk_y2 = cy;
+  }
+  if (chunk_x2 < 0)
+    return NULL;
+
+  // (the last chunks run past the level's edge)
+  int level_cells_w = (level_w + grid_size - 1) / grid_size;
+  int level_cells_h = (level_h + grid_size - 1) / grid_size;
+  *map_x = chunk_x1 * CHUNK_TILES;
+  *map_y = chunk_y1 * CHUNK_TILES;
+  *map_w = (chunk_x2 + 1) * CHUNK_TILES < level_cells_w ? (chunk_x2 + 1) * CHUNK_TILES - *map_x : level_cells_w - *map_x;
+  *map_h = (chunk_y2 + 1) * CHUNK_TILES < level_cells_h ? (chunk_y2 + 1) * CHUNK_TILES - *map_y : level_cells_h - *map_y;
+  if (*map_w < 1 || *map_h < 1)
+    return NULL;
+
+  byte* cells = (byte*)calloc((size_t)*map_w * *map_h, 1);
+  if (!cells)
+    error("allocating fill map");
+
+  for (int cy = chunk_y1; cy <= chunk_y2; ++cy) {
+    for (int cx = chunk_x1; cx <= chunk_x2; ++cx) {
+      if (chunks[cy * chunks_w + cx].state != CHUNK_RESIDENT)
+        markCells(cells, *map_x, *map_y, *map_w, *map_h, cx * CHUNK_TILES, cy * CHUNK_TILES, (cx + 1) * CHUNK_TILES - 1,
+          (cy + 1) * CHUNK_TILES - 1, CELL_TAKEN);
+    }
+  }
 
+  // every cell a static entity's box touches (enemies move, so they don't stop a fill)
   for (int i = 0; i < len_entities; ++i) {
-    if (i != ix && entities[i].flags & type) {
-      int other_x = entities[i].x;
-      int other_y = entities[i].y;
-      int other_x2 = entities[i].x + entities[i].w;
-      int other_y2 = entities[i].y + entities[i].h;
+    Entity* ent = &entities[i];
+    if (isDynamic(ent) || ent->x + ent->w <= 0 || ent->y + ent->h <= 0)
+      continue;
+    int x1 = ent->x < 0 ? 0 : ent->x / grid_size;
+    int y1 = ent->y < 0 ? 0 : ent->y / grid_size;
+    int x2 = (ent->x + (ent->w > 0 ? ent->w : 1) - 1) / grid_size;
+    int y2 = (ent->y + (ent->h > 0 ? ent->h : 1) - 1) / grid_size;
+    markCells(cells, *map_x, *map_y, *map_w, *map_h, x1, y1, x2, y2, CELL_TAKEN);
+  }
+  return cells;
+}
 
-      // DO collide if
-      if (x2 > other_x && x < other_x2 &&
-        y2 > other_y && y < other_y2)
-          return i;
+// mark the empty cells of a map from x1/y1 to x2/y2 (level cells, inclusive)
+void markCells(byte* cells, int map_x, int map_y, int map_w, int map_h, int x1, int y1, int x2, int y2, byte mark) {
+  x1 = x1 - map_x < 0 ? 0 : x1 - map_x;
+  y1 = y1 - map_y < 0 ? 0 : y1 - map_y;
+  x2 = x2 - map_x >= map_w ? map_w - 1 : x2 - map_x;
+  y2 = y2 - map_y >= map_h ? map_h - 1 : y2 - map_y;
+  for (int y = y1; y <= y2; ++y) {
+    byte* row = &cells[(size_t)y * map_w];
+    for (int x = x1; x <= x2; ++x) {
+      if (row[x] == CELL_EMPTY)
+        row[x] = mark;
     }
   }
-  return -1;
 }
 
-int sign(float n) {
-  if (n > 0)
-    return 1;
-  else if (n < 0)
-    return -1;
-  else
-    return 0;
+// fill a map's CELL_FILL cells w/ as few rectangles as it greedily can (each kept to a chunk, so its tiles page in & out
+// w/ the chunk like painted ones would) & create them all at once, as one transaction that's journaled w/ a single flush
+void coverCells(byte* cells, int map_x, int map_y, int map_w, int map_h) {
+  SDL_Rect* rects = NULL;
+  int len_rects = 0;
+  int max_rects = 0;
+  for (int y = 0; y < map_h; ++y) {
+    for (int x = 0; x < map_w; ++x) {
+      if (cells[(size_t)y * map_w + x] != CELL_FILL)
+        continue;
+
+      // as wide as the run of cells to fill goes, then as far down as the whole width does
+      int chunk_x2 = ((map_x + x) / CHUNK_TILES + 1) * CHUNK_TILES - map_x;
+      int chunk_y2 = ((map_y + y) / CHUNK_TILES + 1) * CHUNK_TILES - map_y;
+      int w = 1;
+      while (x + w < map_w && x + w < chunk_x2 && cells[(size_t)y * map_w + x + w] == CELL_FILL)
+        w++;
+      int h = 1;
+      while (y + h < map_h && y + h < chunk_y2) {
+        byte* row = &cells[(size_t)(y + h) * map_w + x];
+        int i = 0;
+        while (i < w && row[i] == CELL_FILL)
+          i++;
+        if (i < w)
+          break;
+        h++;
+      }
+      for (int j = 0; j < h; ++j)
+        memset(&cells[(size_t)(y + j) * map_w + x], CELL_DONE, w);
+
+      if (len_rects == max_rects) {
+        max_rects = max_rects ? max_rects * 2 : 64;
+        rects = (SDL_Rect*)realloc(rects, max_rects * sizeof(SDL_Rect));
+        if (!rects)
+          error("allocating fill");
+      }
+      SDL_Rect* rect = &rects[len_rects++];
+      rect->x = (map_x + x) * grid_size;
+      rect->y = (map_y + y) * grid_size;
+      rect->w = w * grid_size;
+      rect->h = h * grid_size;
+    }
+  }
+
+  reserveEntities(len_entities + len_rects);
+  journal_holding = true;
+  for (int i = 0; i < len_rects; ++i) {
+    SDL_Rect* rect = &rects[i];
+    Entity* ent = createEntity(mode_type, curr_color_ix, rect->x, rect->y, rect->w, rect->h);
+    Shape* shape = &(ent->shapes[0]);
+    fillShape(shape);
+    addRectPoints(shape, 0, 0, rect->w, rect->h);
+    journalOp(JOURNAL_CREATE, ent, 0, ent);
+    logCreate(ent);
+  }
+  journal_holding = false;
+  if (len_rects)
+    flushJournal();
+  free(rects);
 }
 
-void error(char* activity) {
-  printf("%s failed: %s\n", activity, strerror(errno));//SDL_GetError());
-  SDL_Quit();
-  exit(-1);
+// fill the empty cells from x1/y1 to x2/y2 (in level coords, exclusive)
+void fillRect(int x1, int y1, int x2, int y2) {
+  int map_x, map_y, map_w, map_h;
+  byte* cells = mapCells(&map_x, &map_y, &map_w, &map_h);
+  if (!cells)
+    return;
+
+  markCells(cells, map_x, map_y, map_w, map_h, x1 / grid_size, y1 / grid_size, (x2 - 1) / grid_size, (y2 - 1) / grid_size, CELL_FILL);
+  coverCells(cells, map_x, map_y, map_w, map_h);
+  free(cells);
+}
+
+// fill the empty cells connected to the one at x/y (through its edges), as far as the resident chunks go
+void floodFill(int x, int y) {
+  int map_x, map_y, map_w, map_h;
+  byte* cells = mapCells(&map_x, &map_y, &map_w, &map_h);
+  if (!cells)
+    return;
+
+  int start_x = x / grid_size - map_x;
+  int start_y = y / grid_size - map_y;
+  if (x < 0 || y < 0 || start_x < 0 || start_y < 0 || start_x >= map_w || start_y >= map_h ||
+    cells[(size_t)start_y * map_w + start_x] != CELL_EMPTY) {
+    free(cells);
+    return;
+  }
+
+  // (each cell's pushed once, as it's marked)
+  int max_stack = 1024;
+  int* stack = (int*)malloc(max_stack * sizeof(int));
+  if (!stack)
+    error("allocating flood fill");
+  int len_stack = 0;
+  stack[len_stack++] = start_y * map_w + start_x;
+  cells[stack[0]] = CELL_FILL;
+  while (len_stack) {
+    int ix = stack[--len_stack];
+    int cx = ix % map_w;
+    int cy = ix / map_w;
+    int neighbors[4] = { cx > 0 ? ix - 1 : -1, cx < map_w - 1 ? ix + 1 : -1, cy > 0 ? ix - map_w : -1, cy < map_h - 1 ? ix + map_w : -1 };
+    for (int i = 0; i < 4; ++i) {
+      if (neighbors[i] < 0 || cells[neighbors[i]] != CELL_EMPTY)
+        continue;
+      cells[neighbors[i]] = CELL_FILL;
+      if (len_stack == max_stack) {
+        max_stack *= 2;
+        stack = (int*)realloc(stack, max_stack * sizeof(int));
+        if (!stack)
+          error("allocating flood fill");
+      }
+      stack[len_stack++] = neighbors[i];
+    }
+  }
+  free(stack);
+
+  coverCells(cells, map_x, map_y, map_w, map_h);
+  free(cells);
+}
+
+// delete the static entities that lie entirely from x1/y1 to x2/y2 (in level coords, exclusive), as one transaction
+void clearRect(int x1, int y1, int x2, int y2) {
+  int* ixs = (int*)malloc((len_entities + 1) * sizeof(int));
+  if (!ixs)
+    error("allocating clear");
+  int len_ixs = 0;
+  for (int i = 0; i < len_entities; ++i) {
+    Entity* ent = &entities[i];
+    if (!isDynamic(ent) && ent->x >= x1 && ent->y >= y1 && ent->x + ent->w <= x2 && ent->y + ent->h <= y2)
+      ixs[len_ixs++] = i;
+  }
+
+  // last to first, so each one deleted only ever swaps in an entity that's staying
+  journal_holding = true;
+  for (int i = len_ixs - 1; i >= 0; --i) {
+    journalOp(JOURNAL_DELETE, &entities[ixs[i]], 0, NULL);
+    logDelete(&entities[ixs[i]]);
+    deleteEntity(ixs[i]);
+  }
+  journal_holding = false;
+  if (len_ixs)
+    flushJournal();
+  free(ixs);
+}
+
+// the tile painting finds at a cell: the last entity w/ the cell's box, or else the last filled rectangle covering it
+int tileAt(int x, int y) {
+  int ix = indexOfEntity(x, y, grid_size, grid_size);
+  return ix > -1 ? ix : boxCovering(&box_index, x, y, grid_size, grid_size);
+}
+
+// delete the tile at a cell (see tileAt()): a filled rectangle's split into the (up to 4) rectangles around the cell,
+// as one transaction, so painting can erase a cell from a fill
+void eraseCell(int ix, int x, int y) {
+  Entity fill = entities[ix]; // (its box, flags & color, since its shapes go w/ it)
+  byte color_ix = fill.shapes[0].fill_color_ix;
+  journal_holding = true;
+  journalOp(JOURNAL_DELETE, &entities[ix], 0, NULL);
+  logDelete(&entities[ix]);
+  deleteEntity(ix);
+
+  if (fill.w > grid_size || fill.h > grid_size) {
+    // the rows above & below the cell, then the rest of its row to the left & right
+    SDL_Rect pieces[4] = {
+      { fill.x, fill.y, fill.w, y - fill.y },
+      { fill.x, y + grid_size, fill.w, fill.y + fill.h - y - grid_size },
+      { fill.x, y, x - fill.x, grid_size },
+      { x + grid_size, y, fill.x + fill.w - x - grid_size, grid_size }
+    };
+    for (int i = 0; i < 4; ++i) {
+      SDL_Rect* piece = &pieces[i];
+      if (piece->w <= 0 || piece->h <= 0)
+        continue;
+      Entity* ent = createEntity(fill.flags, color_ix, piece->x, piece->y, piece->w, piece->h);
+      Shape* shape = &(ent->shapes[0]);
+      fillShape(shape);
+      addRectPoints(shape, 0, 0, piece->w, piece->h);
+      journalOp(JOURNAL_CREATE, ent, 0, ent);
+      logCreate(ent);
+    }
+  }
+  journal_holding = false;
+  flushJournal();
+}
+
+// whether an enemy at x/y would hit a wall (box is where it's allowed to look, when it's being moved in parallel)
+bool enemyHits(World* w, int x, int y, Entity* ent, int ix, EnemyBox* box, MoveCounts* counts) {
+  if (!box)
+    return worldCollides(w, x, y, ent->w, ent->h, ix, WALL) > -1;
+
+  if (x < box->x1 || y < box->y1 || x + ent->w > box->x2 || y + ent->h > box->y2) {
+    counts->escaped = true;
+    return true; // (stops it, since it's going to be moved over again anyway)
+  }
+  counts->queries++;
+  return findCollision(x, y, ent->w, ent->h, ix, entities, len_entities, WALL, &counts->tests) > -1;
+}
+
+// if an enemy is going to collide, inch there & *reverse* the direction
+// (ix is its index in entities or the world's movers, so it doesn't collide w/ itself, & ent can be a copy of it)
+void moveEnemy(World* w, Entity* ent, int ix, EnemyBox* box, MoveCounts* counts) {
+  if (ent->dx) {
+    if (enemyHits(w, ent->x + ent->dx, ent->y, ent, ix, box, counts) && ent->dx) {
+      while (!enemyHits(w, ent->x + sign(ent->dx), ent->y, ent, ix, box, counts))
+        ent->x += sign(ent->dx);
+      
+      ent->dx = -ent->dx;
+    }
+    else {
+      ent->x += ent->dx;
+    }
+  }
+
+  if (ent->dy) {
+    if (enemyHits(w, ent->x, ent->y + ent->dy, ent, ix, box, counts) && ent->dy) {
+      while (!enemyHits(w, ent->x, ent->y + sign(ent->dy), ent, ix, box, counts))
+        ent->y += sign(ent->dy);
+      
+      ent->dy = -ent->dy / 8;
+    }
+    else {
+      ent->y += ent->dy;
+    }
+  }
+}
+
+// a parallelFor() job: move a batch of the enemies that don't conflict (reading entities, writing only their enemy_moves)
+void moveEnemies(int start, int end, int worker, void* data) {
+  for (int i = start; i < end; ++i) {
+    EnemyBox* box = &enemy_boxes[i];
+    enemy_moves[i] = entities[box->ix];
+    moveEnemy(&world, &enemy_moves[i], box->ix, box, &move_counts[worker]);
+  }
+}
+
+int compareEnemyBoxes(const void* a, const void* b) {
+  return ((EnemyBox*)a)->x1 - ((EnemyBox*)b)->x1;
+}
+
+// an enemy's box covers everywhere it could get to this tick (a move truncates, so a px either way is plenty)
+EnemyBox enemyBox(Entity* ent, int ix) {
+  int reach_x = ceilf(fabsf(ent->dx)) + 1;
+  int reach_y = ceilf(fabsf(ent->dy)) + 1;
+  EnemyBox box = { .ix = ix, .x1 = ent->x - reach_x, .y1 = ent->y - reach_y, .x2 = ent->x + ent->w + reach_x,
+    .y2 = ent->y + ent->h + reach_y, .conflict = false };
+  return box;
+}
+
+// sort & sweep along x for overlapping boxes, marking them
+void markConflicts(EnemyBox* boxes, int len) {
+  qsort(boxes, len, sizeof(EnemyBox), compareEnemyBoxes);
+  for (int a = 0; a < len; ++a) {
+    for (int b = a + 1; b < len && boxes[b].x1 < boxes[a].x2; ++b) {
+      if (boxes[b].y1 < boxes[a].y2 && boxes[a].y1 < boxes[b].y2) {
+        boxes[a].conflict = true;
+        boxes[b].conflict = true;
+      }
+    }
+  }
+}
+
+// box a world's movers before they move, so ones whose boxes don't overlap any other's needn't check the others
+// (the first half of mover_boxes is sorted, the second half's by mover)
+void boxMovers(World* w) {
+  for (int i = 0; i < w->len_movers; ++i)
+    w->mover_boxes[i] = enemyBox(&w->movers[i], i);
+  markConflicts(w->mover_boxes, w->len_movers);
+  for (int i = 0; i < w->len_movers; ++i)
+    w->mover_boxes[w->len_movers + w->mover_boxes[i].ix] = w->mover_boxes[i];
+  w->movers_escaped = false;
+}
+
+int compareInts(const void* a, const void* b) {
+  return *(int*)a - *(int*)b;
+}
+
+// move the enemies that are awake
+void stepEnemies() {
+  listAwakeMovers();
+  movers_moved = true;
+  int len_movers = 0;
+  for (int i = 0; i < len_awake_movers; ++i)
+    if (entities[awake_movers[i]].dx || entities[awake_movers[i]].dy)
+      len_movers++;
+
+  bool parallel = num_workers > 0 && len_movers >= ENEMY_BATCH * 2;
+#if PROFILE
+  parallel = parallel && !show_heatmap; // (the heatmap's counting isn't thread safe)
+#endif
+  if (parallel && len_movers > max_enemies) {
+    max_enemies = len_movers * 2;
+    enemy_boxes = (EnemyBox*)realloc(enemy_boxes, max_enemies * sizeof(EnemyBox));
+    enemy_ixs = (int*)realloc(enemy_ixs, max_enemies * sizeof(int));
+    enemy_moves = (Entity*)realloc(enemy_moves, max_enemies * sizeof(Entity));
+    if (!enemy_boxes || !enemy_ixs || !enemy_moves)
+      error("allocating enemy step");
+  }
+
+  int len_parallel = 0;
+  if (parallel) {
+    int len_boxes = 0;
+    for (int i = 0; i < len_awake_movers; ++i)
+      if (entities[awake_movers[i]].dx || entities[awake_movers[i]].dy)
+        enemy_boxes[len_boxes++] = enemyBox(&entities[awake_movers[i]], awake_movers[i]);
+    markConflicts(enemy_boxes, len_boxes); // (enemies that could touch have to move in order)
+
+    // the ones that don't conflict go first (boxes & all), the rest are just indices
+    int len_conflicts = 0;
+    for (int i = 0; i < len_boxes; ++i) {
+      if (enemy_boxes[i].conflict)
+        enemy_ixs[len_boxes - ++len_conflicts] = enemy_boxes[i].ix;
+      else
+        enemy_boxes[len_parallel++] = enemy_boxes[i];
+    }
+
+    memset(move_counts, 0, sizeof(move_counts));
+    parallelFor(len_parallel, ENEMY_BATCH, moveEnemies, NULL);
+
+    bool escaped = false;
+    for (int w = 0; w <= num_workers; ++w)
+      escaped = escaped || move_counts[w].escaped;
+    if (escaped) {
+      parallel = false;
+    }
+    else {
+      for (int i = 0; i < len_parallel; ++i)
+        entities[enemy_boxes[i].ix] = enemy_moves[i];
+#if PROFILE
+      for (int w = 0; w <= num_workers; ++w) {
+        collide_queries += move_counts[w].queries;
+        collide_tests += move_counts[w].tests;
+      }
+#endif
+
+      // the rest, in entity order
+      qsort(enemy_ixs + len_parallel, len_conflicts, sizeof(int), compareInts);
+      for (int i = len_parallel; i < len_boxes; ++i)
+        moveEnemy(&world, &entities[enemy_ixs[i]], enemy_ixs[i], NULL, NULL);
+    }
+  }
+
+  // (w/out workers, w/ few enemies or when one of them escaped its box, nothing's been moved yet)
+  if (!parallel) {
+    for (int i = 0; i < len_awake_movers; ++i)
+      if (entities[awake_movers[i]].dx || entities[awake_movers[i]].dy)
+        moveEnemy(&world, &entities[awake_movers[i]], awake_movers[i], NULL, NULL);
+  }
+
+  // (the ones that've moved are filed again where they are, so they're still found by their box)
+  for (int i = 0; i < len_awake_movers; ++i)
+    boxRefile(&box_index, awake_movers[i]);
+
+  // if an enemy goes off the level, delete it (only the ones that moved can have)
+  // we do this in a separate loop b/c deleteEntity() moves the last entity to earlier in the loop
+  // and will cause the loop to skip that last entity
+  for (int i = 0; i < len_awake_movers && awake_movers[i] < len_entities; ++i) {
+    Entity* ent = &(entities[awake_movers[i]]);
+    if (ent->dx && (ent->x + ent->w < 0 || ent->x > level_w))
+      deleteEntity(awake_movers[i]);
+    else if (ent->dy && (ent->y + ent->h < 0 || ent->y > level_h))
+      deleteEntity(awake_movers[i]);
+  }
+
+  // the ones that've walked out of the awake regions fall asleep where they are
+  // (unless some were deleted, which has them all listed again)
+  if (region_slept_at && awake_version == world_version) {
+    int len_awake = 0;
+    for (int i = 0; i < len_awake_movers; ++i)
+      if (isAwake(&entities[awake_movers[i]]))
+        awake_movers[len_awake++] = awake_movers[i];
+    len_awake_movers = len_awake;
+  }
+}
+
+// split the loaded level into regions, all asleep since the first tick (reset is whether its enemies are reset to spawn when they wake)
+void startActivity(bool reset) {
+  region_px = ACTIVE_TILES * grid_size;
+  regions_w = level_w / region_px + 1;
+  regions_h = level_h / region_px + 1;
+  region_slept_at = (int*)calloc(regions_w * regions_h, sizeof(int));
+  if (!region_slept_at)
+    error("allocating regions");
+  active_x1 = active_y1 = 0;
+  active_x2 = active_y2 = -1;
+  awake_version = -1;
+  sim_ticks = 0;
+  wake_reset = reset;
+  trackSpawns(reset);
+}
+
+void stopActivity() {
+  free(region_slept_at);
+  region_slept_at = NULL;
+  awake_version = -1;
+  trackSpawns(false);
+  free(wall_map.starts);
+  free(wall_map.ixs);
+  free(forwarded);
+  free(near_walls);
+  wall_map.starts = wall_map.ixs = forwarded = near_walls = NULL;
+  wall_map.max_starts = wall_map.max_ixs = max_forwarded = max_near_walls = 0;
+}
+
+// start (or stop) keeping spawns, which start out where everything is now
+void trackSpawns(bool track) {
+  free(spawns);
+  spawns = NULL;
+  if (!track)
+    return;
+
+  spawns = (Spawn*)malloc((max_entities + 1) * sizeof(Spawn));
+  if (!spawns)
+    error("allocating spawns");
+  for (int i = 0; i < len_entities; ++i) {
+    spawns[i].x = entities[i].x;
+    spawns[i].y = entities[i].y;
+  }
+}
+
+int regionIndexAt(int x, int y) {
+  int rx = x < 0 ? 0 : x / region_px;
+  int ry = y < 0 ? 0 : y / region_px;
+  if (rx >= regions_w)
+    rx = regions_w - 1;
+  if (ry >= regions_h)
+    ry = regions_h - 1;
+
+  return ry * regions_w + rx;
+}
+
+bool isAwake(Entity* ent) {
+  if (!region_slept_at)
+    return true;
+
+  int region_ix = regionIndexAt(ent->x, ent->y);
+  int rx = region_ix % regions_w;
+  int ry = region_ix / regions_w;
+  return rx >= active_x1 && rx <= active_x2 && ry >= active_y1 && ry <= active_y2;
+}
+
+// list the awake movers again if entities have changed (or the awake regions have) since they were
+// (in between, stepEnemies() drops the ones that walk out of the awake regions, & nothing else moves)
+void listAwakeMovers() {
+  if (awake_version == world_version)
+    return;
+
+  len_awake_movers = 0;
+  for (int i = 0; i < len_entities; ++i) {
+    if (!isDynamic(&entities[i]) || !isAwake(&entities[i]))
+      continue;
+    if (len_awake_movers == max_awake_movers) {
+      max_awake_movers = max_awake_movers ? max_awake_movers * 2 : 64;
+      awake_movers = (int*)realloc(awake_movers, max_awake_movers * sizeof(int));
+      if (!awake_movers)
+        error("allocating awake movers");
+    }
+    awake_movers[len_awake_movers++] = i;
+  }
+  awake_version = world_version;
+}
+
+// move the awake regions to the ones around the viewport: the ones that are left fall asleep & the new ones' enemies wake up
+void updateActivity() {
+  if (!region_slept_at)
+    return;
+
+  int first = regionIndexAt(vp.x - ACTIVE_MARGIN * region_px, vp.y - ACTIVE_MARGIN * region_px);
+  int last = regionIndexAt(vp.x + vp.w + ACTIVE_MARGIN * region_px, vp.y + vp.h + ACTIVE_MARGIN * region_px);
+  int x1 = first % regions_w;
+  int y1 = first / regions_w;
+  int x2 = last % regions_w;
+  int y2 = last / regions_w;
+  if (x1 == active_x1 && y1 == active_y1 && x2 == active_x2 && y2 == active_y2)
+    return;
+
+  for (int ry = active_y1; ry <= active_y2; ++ry)
+    for (int rx = active_x1; rx <= active_x2; ++rx)
+      if (rx < x1 || rx > x2 || ry < y1 || ry > y2)
+        region_slept_at[ry * regions_w + rx] = sim_ticks;
+
+  // (its enemies are the ones that're awake now but weren't)
+  int old_x1 = active_x1;
+  int old_y1 = active_y1;
+  int old_x2 = active_x2;
+  int old_y2 = active_y2;
+  active_x1 = x1;
+  active_y1 = y1;
+  active_x2 = x2;
+  active_y2 = y2;
+  awake_version = -1;
+  movers_moved = true;
+  wall_map.cell_px = 0; // (filled by the first fastForward())
+  len_forwarded = 0;
+  for (int i = 0; i < len_entities; ++i) {
+    Entity* ent = &entities[i];
+    if (!isDynamic(ent) || !isAwake(ent))
+      continue;
+    int region_ix = regionIndexAt(ent->x, ent->y);
+    int rx = region_ix % regions_w;
+    int ry = region_ix / regions_w;
+    if (rx >= old_x1 && rx <= old_x2 && ry >= old_y1 && ry <= old_y2)
+      continue;
+
+    if (spawns) {
+      // (enemies always start off walking right)
+      ent->x = spawns[i].x;
+      ent->y = spawns[i].y;
+      ent->dx = fabsf(ent->dx);
+      ent->dy = 0;
+    }
+    else {
+      int x = ent->x;
+      fastForward(i, sim_ticks - region_slept_at[region_ix]);
+      if (ent->x != x) {
+        if (len_forwarded == max_forwarded) {
+          max_forwarded = max_forwarded ? max_forwarded * 2 : 64;
+          forwarded = (int*)realloc(forwarded, max_forwarded * sizeof(int));
+          if (!forwarded)
+            error("allocating regions");
+        }
+        forwarded[len_forwarded++] = i;
+      }
+    }
+    boxRefile(&box_index, i);
+  }
+}
+
+int compareSpans(const void* a, const void* b) {
+  return ((int*)a)[0] - ((int*)b)[0];
+}
+
+// catch a sleeping walker up on a number of ticks: on flat ground (or w/out gravity) it just walks back & forth between the
+// walls either side of it, which is worked out w/out stepping it a tick at a time, & if the ground runs out first it stops at
+// the edge, to walk off once it's awake. Anything else (like an enemy in the air) carries on from where it fell asleep
+void fastForward(int ix, int ticks) {
+  static int* ground; // spans of x it can stand at (pairs of first & last), scratch
+  static int max_ground;
+  Entity* ent = &entities[ix];
+  if (!ent->dx || ticks <= 0 || (!ent->grav_y && ent->dy))
+    return;
+
+  // the walls beside it & the ground under it (or above it, if its gravity's upside down)
+  int lo = 0; // how far it can go each way (the level's edges, if there's no wall)
+  int hi = level_w;
+  bool wall_lo = false;
+  bool wall_hi = false;
+  int ground_y = ent->grav_y > 0 ? ent->y + ent->h : ent->y - 1;
+  int len_ground = 0;
+  gatherWalls(ix);
+  for (int n = 0; n < len_near_walls; ++n) {
+    int i = near_walls[n];
+    Entity* other = &entities[i];
+    if (i == ix || !(other->flags & WALL))
+      continue;
+
+    if (other->y < ent->y + ent->h && other->y + other->h > ent->y) {
+      if (other->x + other->w <= ent->x) {
+        if (other->x + other->w >= lo) {
+          lo = other->x + other->w;
+          wall_lo = true;
+        }
+      }
+      else if (other->x >= ent->x + ent->w) {
+        if (other->x <= hi) {
+          hi = other->x;
+          wall_hi = true;
+        }
+      }
+      else {
+        // stuck in it: it just turns around every tick
+        if (ticks % 2)
+          ent->dx = -ent->dx;
+        return;
+      }
+    }
+    else if (ent->grav_y && other->y <= ground_y && other->y + other->h > ground_y) {
+      if (len_ground == max_ground) {
+        max_ground = max_ground ? max_ground * 2 : 64;
+        ground = (int*)realloc(ground, max_ground * 2 * sizeof(int));
+        if (!ground)
+          error("allocating ground");
+      }
+      ground[len_ground * 2] = other->x - ent->w + 1;
+      ground[len_ground * 2 + 1] = other->x + other->w - 1;
+      len_ground++;
+    }
+  }
+  int x_lo = lo;
+  int x_hi = hi - ent->w;
+
+  // the run of ground it's on (spans that meet or overlap make one)
+  if (ent->grav_y) {
+    qsort(ground, len_ground, 2 * sizeof(int), compareSpans);
+    int run_lo = 0;
+    int run_hi = -1;
+    for (int g = 0; g < len_ground; ++g) {
+      int* span = &ground[g * 2];
+      if (g == 0 || span[0] > run_hi + 1) {
+        if (run_hi >= ent->x)
+          break; // (the run it's on is done)
+        run_lo = span[0];
+      }
+      if (g == 0 || span[1] > run_hi)
+        run_hi = span[1];
+    }
+    if (ent->x < run_lo || ent->x > run_hi)
+      return; // (it's not standing on anything)
+    if (run_lo > x_lo) {
+      x_lo = run_lo;
+      wall_lo = false;
+    }
+    if (run_hi < x_hi) {
+      x_hi = run_hi;
+      wall_hi = false;
+    }
+  }
+  if (ent->x < x_lo || ent->x > x_hi)
+    return;
+
+  // each leg's whole steps (a move truncates, like moveEnemy()'s), then the tick it bumps the wall: it inches up to it & turns around
+  while (ticks > 0) {
+    int step = (int)(ent->x + ent->dx) - ent->x;
+    if (!step)
+      return; // (too slow to ever get anywhere)
+    int limit = step > 0 ? x_hi : x_lo;
+    int steps = (limit - ent->x) / step;
+    if (steps >= ticks) {
+      ent->x += ticks * step;
+      return;
+    }
+    ent->x += steps * step;
+    ticks -= steps;
+    if (!(step > 0 ? wall_hi : wall_lo))
+      return;
+
+    ent->x = limit;
+    ent->dx = -ent->dx;
+    ticks--;
+
+    // between 2 walls, it's back here every round trip
+    int there = (int)(ent->x + ent->dx) - ent->x;
+    int back = (int)(ent->x - ent->dx) - ent->x;
+    if (wall_lo && wall_hi && there && back)
+      ticks %= (x_hi - x_lo) / abs(there) + 1 + (x_hi - x_lo) / abs(back) + 1;
+  }
+}
+
+// the walls fastForward() needs to look at for an enemy, into near_walls: the ones in the regions its row (& the row under
+// or over it) runs through, out either way until there's a wall nearer than anything further out (which makes the ground
+// further out moot too), & the ones it's moved since wall_map was filled (some more than once, which doesn't matter)
+void gatherWalls(int ix) {
+  Entity* ent = &entities[ix];
+  if (!wall_map.cell_px) {
+    wall_map.cell_px = region_px;
+    wall_map.cells_w = regions_w;
+    wall_map.cells_h = regions_h;
+    fillGrid(&wall_map, entities, len_entities, WALL, true);
+  }
+
+  len_near_walls = 0;
+  int lo = 0; // the nearest walls either way so far
+  int hi = level_w;
+  for (int f = 0; f < len_forwarded; ++f)
+    nearWall(ent, forwarded[f], &lo, &hi);
+
+  // (a wall that's in none of the columns looked at so far is all the way past the last one)
+  int cx1, cy1, cx2, cy2;
+  gridRange(&wall_map, ent->x, ent->y - 1, ent->w, ent->h + 1, &cx1, &cy1, &cx2, &cy2);
+  for (int cx = cx1; cx <= cx2; ++cx)
+    nearColumn(ent, cx, cy1, cy2, &lo, &hi);
+  for (int cx = cx1 - 1; cx >= 0 && lo < (cx + 1) * wall_map.cell_px; --cx)
+    nearColumn(ent, cx, cy1, cy2, &lo, &hi);
+  for (int cx = cx2 + 1; cx < wall_map.cells_w && hi > cx * wall_map.cell_px; ++cx)
+    nearColumn(ent, cx, cy1, cy2, &lo, &hi);
+}
+
+void nearColumn(Entity* ent, int cx, int cy1, int cy2, int* lo, int* hi) {
+  for (int cy = cy1; cy <= cy2; ++cy) {
+    int cell_ix = cy * wall_map.cells_w + cx;
+    for (int i = wall_map.starts[cell_ix]; i < wall_map.starts[cell_ix + 1]; ++i)
+      nearWall(ent, wall_map.ixs[i], lo, hi);
+  }
+}
+
+// add a wall to near_walls, & move lo or hi up to it if it's beside the enemy
+void nearWall(Entity* ent, int wall_ix, int* lo, int* hi) {
+  if (len_near_walls == max_near_walls) {
+    max_near_walls = max_near_walls ? max_near_walls * 2 : 64;
+    near_walls = (int*)realloc(near_walls, max_near_walls * sizeof(int));
+    if (!near_walls)
+      error("allocating walls");
+  }
+  near_walls[len_near_walls++] = wall_ix;
+
+  Entity* other = &entities[wall_ix];
+  if (other == ent || other->y >= ent->y + ent->h || other->y + other->h <= ent->y)
+    return;
+  if (other->x + other->w <= ent->x && other->x + other->w > *lo)
+    *lo = other->x + other->w;
+  else if (other->x >= ent->x + ent->w && other->x < *hi)
+    *hi = other->x;
+}
+
+// a tick: its input's latched (& recorded) or comes from the recording, then the world's stepped
+// returns 1 if it stepped, 0 if it's waiting on chunks (see stepWorld()) or -1 once a replay's run out
+int tick() {
+  if (!replaying)
+    latchInput();
+  if (replaying && !replayTick())
+    return -1;
+  if (recording)
+    recordTick();
+  return stepWorld();
+}
+
+// a tick of the simulation: page chunks in & out, move everything & point the camera at the player
+// returns false (w/out moving anything) while the chunks around the player are still on their way
+bool stepWorld() {
+  PROFILE_START(PHASE_CHUNKS);
+
+  // fold a big journal into a fresh level file (in the background)
+  if (journal_file && journal_bytes > JOURNAL_COMPACT_BYTES && !save_in_flight)
+    saveLevel(selected_shape != NULL);
+
+  // page chunks in & out around the viewport & player
+  // (not while drawing a shape, since that relies on the shape's entity staying last in `entities`)
+  if (!selected_shape)
+    updateChunks(vp.x, vp.y, vp.w, vp.h);
+  if (recording || replaying)
+    settleChunks();
+
+  // physics only sees resident chunks, so wait for the ones around the player to arrive
+  bool resident = chunksResident(world.player.x - chunk_px / 2, world.player.y - chunk_px / 2, world.player.w + chunk_px,
+    world.player.h + chunk_px);
+  PROFILE_STOP(PHASE_CHUNKS);
+  if (!resident)
+    return false;
+
+  // wake the enemies that've come into range (& put the ones that've gone out of it to sleep)
+  PROFILE_START(PHASE_ENEMIES);
+  updateActivity();
+  PROFILE_STOP(PHASE_ENEMIES);
+
+  stepPlay(&world);
+
+  // if an enemy is going to collide, inch there & *reverse* the direction
+  PROFILE_START(PHASE_ENEMIES);
+  stepEnemies();
+  PROFILE_STOP(PHASE_ENEMIES);
+  sim_ticks++;
+
+  // camera follows the player, clamped to the level bounds
+  vp.x = world.player.x + world.player.w / 2 - vp.w / 2;
+  vp.y = world.player.y + world.player.h / 2 - vp.h / 2;
+  if (vp.x > level_w - vp.w)
+    vp.x = level_w - vp.w;
+  if (vp.y > level_h - vp.h)
+    vp.y = level_h - vp.h;
+  if (vp.x < 0)
+    vp.x = 0;
+  if (vp.y < 0)
+    vp.y = 0;
+
+  return true;
+}
+
+// a tick of play in a world: the player's input, gravity, triggers & moves (& the world's own movers, if it has them,
+// otherwise the level's enemies are moved by stepWorld())
+// returns true if the player died this tick (& is back at its checkpoint)
+bool stepPlay(World* w) {
+  Entity* player = &w->player;
+  Entity* statics = w->statics ? w->statics : entities;
+  int len_statics = w->statics ? w->len_statics : len_entities;
+
+  // left/right movement
+  if (w->left_pressed)
+    player->dx = -move_speed;
+  else if (w->right_pressed)
+    player->dx = move_speed;
+  else
+    player->dx = 0;
+  
+  // gravity
+  PROFILE_START(PHASE_GRAVITY);
+  if ((player->grav_y > 0 && player->dy < 10) || (player->grav_y < 0 && player->dy > -10))
+    player->dy += player->grav_y;
+
+  // (the game's movers are the awake ones)
+  if (!w->statics)
+    listAwakeMovers();
+  int len_movers = w->statics ? w->len_movers : len_awake_movers;
+  for (int i = 0; i < len_movers; ++i) {
+    Entity* ent = w->statics ? &w->movers[i] : &entities[awake_movers[i]];
+    if (ent->grav_y && ((ent->grav_y > 0 && ent->dy < 10) || (ent->grav_y < 0 && ent->dy > -10)))
+      ent->dy += ent->grav_y;
+  }
+  PROFILE_STOP(PHASE_GRAVITY);
+
+  PROFILE_START(PHASE_TRIGGERS);
+  if (playerWillCollide(w, REVERSE_GRAV) > -1)
+    player->grav_y = -player->grav_y;
+
+  if (playerWillCollide(w, FINISH) > -1)
+    w->won_game = true;
+
+  if (playerWillCollide(w, CHECKPOINT) > -1) {
+    w->start_x = player->x;
+    w->start_y = player->y;
+    w->start_grav = player->grav_y;
+  }
+
+  // (portals never move, so they're always statics)
+  int portal_ix = playerWillCollide(w, PORTAL);
+  if (portal_ix > -1 && portal_ix < len_statics) {
+    for (int i = 0; i < len_statics; ++i) {
+      if (i != portal_ix && statics[i].flags & PORTAL) {
+        int delta_x = statics[i].x - statics[portal_ix].x;
+        int delta_y = statics[i].y - statics[portal_ix].y;
+        player->x += delta_x;
+        player->y += delta_y;
+        player->dx = -player->dx;
+        player->dy = -player->dy;
+        traceInstant(trace_world, "portal");
+        break;
+      }
+    }
+  }
+
+  // start over if you hit lava or an enemy or fall offscreen
+  bool died = false;
+  if ((playerWillCollide(w, LAVA) > -1) || (playerWillCollide(w, ENEMY) > -1) ||
+    player->x < 0 || player->x > level_w || player->y < 0 || player->y > level_h) {
+    player->grav_y = w->start_grav;
+    player->dx = 0;
+    player->dy = 0;
+    player->x = w->start_x;
+    player->y = w->start_y;
+    died = true;
+    traceInstant(trace_world, "respawn");
+  }
+  PROFILE_STOP(PHASE_TRIGGERS);
+
+  // if touching ground, & jump button pressed, jump
+  PROFILE_START(PHASE_PLAYER);
+  if (w->up_pressed && worldCollides(w, player->x, player->y + 1, player->w, player->h, -1, WALL) > -1)
+    player->dy = -jump_speed;
+  else if (w->down_pressed && worldCollides(w, player->x, player->y - 1, player->w, player->h, -1, WALL) > -1)
+    player->dy = jump_speed;
+
+  // if it's going to collide (horiz), inch there 1px at a time
+  if (worldCollides(w, player->x + player->dx, player->y, player->w, player->h, -1, WALL) > -1 && player->dx) {
+    while (!(worldCollides(w, player->x + sign(player->dx), player->y, player->w, player->h, -1, WALL) > -1))
+      player->x += sign(player->dx);
+    
+    player->dx = 0;
+  }
+  player->x += player->dx;
+
+  // if it's going to collid (vert), inch there 1px at a time
+  if (worldCollides(w, player->x, player->y + player->dy, player->w, player->h, -1, WALL) > -1 && player->dy) {
+    while (!(worldCollides(w, player->x, player->y + sign(player->dy), player->w, player->h, -1, WALL) > -1))
+      player->y += sign(player->dy);
+    
+    player->dy = 0;
+  }
+  player->y += player->dy;
+  PROFILE_STOP(PHASE_PLAYER);
+
+  if (!w->statics)
+    return died;
+
+  // its own movers, like stepEnemies() moves the game's one at a time (& drops any that leave the level, last one first)
+  if (w->mover_boxes)
+    boxMovers(w);
+  for (int i = 0; i < w->len_movers; ++i)
+    moveEnemy(w, &w->movers[i], i, NULL, NULL);
+  for (int i = 0; i < w->len_movers; ++i) {
+    Entity* ent = &w->movers[i];
+    if ((ent->dx && (ent->x + ent->w < 0 || ent->x > level_w)) || (ent->dy && (ent->y + ent->h < 0 || ent->y > level_h)))
+      *ent = w->movers[--w->len_movers];
+  }
+  return died;
+}
+
+// draw everything but the HUD: the background, the entities in the viewport, the palette & the player
+void renderScene(SDL_Renderer* renderer) {
+  renderBackground(renderer);
+  renderEntities(renderer);
+  renderForeground(renderer, &world.player, vp, note, note_time, fillPreview());
+}
+
+// the same, from a snapshot the sim published (w/ --threaded)
+void renderSnapshot(SDL_Renderer* renderer, Snapshot* snap) {
+  renderBackground(renderer);
+  drawEntities(renderer, snap->statics.ents, snap->statics.len_ents, snap->vp);
+  drawEntities(renderer, snap->dynamics.ents, snap->dynamics.len_ents, snap->vp);
+  bool main_newer = main_note && (!snap->note || main_note_time >= snap->note_time);
+  renderForeground(renderer, &snap->player, snap->vp, main_newer ? main_note : snap->note, main_newer ? main_note_time : snap->note_time,
+    snap->fill_rect);
+}
+
+void renderBackground(SDL_Renderer* renderer) {
+  // set BG color
+  if (SDL_SetRenderDrawColor(renderer, 44, 34, 30, 255) < 0)
+    error("setting bg color");
+  if (SDL_RenderClear(renderer) < 0)
+    error("clearing renderer");
+}
+
+// what's drawn over the level: the rectangle being filled, the palette, the note (see showNote()) & the player
+void renderForeground(SDL_Renderer* renderer, Entity* shown_player, Viewport view, char* shown_note, unsigned int shown_note_time,
+  SDL_Rect fill_rect) {
+  if (fill_rect.w)
+    rectangleColor(renderer, fill_rect.x - view.x, fill_rect.y - view.y, fill_rect.x + fill_rect.w - view.x - 1,
+      fill_rect.y + fill_rect.h - view.y - 1, 0xffffffff);
+
+  // draw palette
+  int colors_len = sizeof(colors) / sizeof(colors[0]);
+  for (int i = 0; i < colors_len; ++i)
+    boxColor(renderer, i * palette_color_size, palette_y, i * palette_color_size + palette_color_size, palette_y + palette_color_size, colors[i]);
+
+  // e.g. let the user know their last save made it to disk
+  if (shown_note && SDL_GetTicks() - shown_note_time < 1000)
+    render_text(renderer, shown_note, 10, 10, 2);
+
+  // render player
+  if (SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255) < 0)
+    error("setting player color");
+
+  SDL_Rect player_rect = {
+    .x = shown_player->x - view.x,
+    .y = shown_player->y - view.y,
+    .w = shown_player->w,
+    .h = shown_player->h
+  };
+  if (SDL_RenderFillRect(renderer, &player_rect) < 0)
+    error("filling player rect");
+}
+
+// show a line of text at the top of the screen for a second (a string literal, since it's drawn from snapshots too)
+void showNote(char* text) {
+  note = text;
+  note_time = SDL_GetTicks();
+}
+
+// the same, from the main thread w/ --threaded (where the note belongs to the sim)
+void showMainNote(char* text) {
+  main_note = text;
+  main_note_time = SDL_GetTicks();
+}
+
+// draw the entities in the viewport
+void renderEntities(SDL_Renderer* renderer) {
+  drawEntities(renderer, entities, len_entities, vp);
+}
+
+void drawEntities(SDL_Renderer* renderer, Entity* ents, int len_ents, Viewport view) {
+  for (int i = 0; i < len_ents; ++i) {
+    Entity* ent = &ents[i];
+    Shape* shape = &(ent->shapes[0]);
+
+    // skip entities outside the viewport (resident chunks extend past it)
+    if (ent->x > view.x + view.w || ent->x + ent->w < view.x || ent->y > view.y + view.h || ent->y + ent->h < view.y)
+      continue;
+
+    short *vx = shape->x;
+    short *vy = shape->y;
+    int x = ent->x - view.x;
+    int y = ent->y - view.y;
+    if (shape->fill_color_ix != NO_COLOR) {
+      aapolygonColor(renderer, x, y, vx, vy, shape->len_vertices, colors[shape->fill_color_ix]);
+      filledPolygonColor(renderer, x, y, vx, vy, shape->len_vertices, colors[shape->fill_color_ix]);// 0xFF000000);
+    }
+    else {
+      for (int j = 0; j < shape->len_vertices - 1; ++j)
+        aalineColor(renderer, vx[j] + x, vy[j] + y, vx[j + 1] + x, vy[j + 1] + y, colors[shape->stroke_color_ix]);
+    }
+  }
+}
+
+int render_text(SDL_Renderer* renderer, char str[], int offset_x, int offset_y, int size) {
+  int i;
+  for (i = 0; str[i] != '\0'; ++i) {
+    int code = str[i];
+    if (code < 0 || code > 127)
+      error("Text code out of range");
+
+    // draw each character's blocks in one call, since there can be a lot of text (like the profiler's)
+    char* bitmap = font8x8_basic[code];
+    SDL_Rect rects[64];
+    int len_rects = 0;
+    int set = 0;
+    for (int y = 0; y < 8; ++y) {
+      for (int x = 0; x < 8; ++x) {
+        set = bitmap[y] & 1 << x;
+        if (!set)
+          continue;
+
+        SDL_Rect r = {
+          .x = offset_x + i * (size) * 8 + x * size,
+          .y = offset_y + y * size,
+          .w = size,
+          .h = size
+        };
+        rects[len_rects++] = r;
+      }
+    }
+    if (len_rects && SDL_RenderFillRects(renderer, rects, len_rects) < 0)
+      error("drawing text block");
+  }
+
+  // width of total text string
+  return i * size * 8;
+}
+
+// the (inclusive) range of a grid's cells a box in world coords touches
+void gridRange(StaticGrid* grid, int x, int y, int w, int h, int* cx1, int* cy1, int* cx2, int* cy2) {
+  *cx1 = x < 0 ? 0 : x / grid->cell_px;
+  *cy1 = y < 0 ? 0 : y / grid->cell_px;
+  *cx2 = (x + w) / grid->cell_px;
+  *cy2 = (y + h) / grid->cell_px;
+  if (*cx2 >= grid->cells_w)
+    *cx2 = grid->cells_w - 1;
+  if (*cy2 >= grid->cells_h)
+    *cy2 = grid->cells_h - 1;
+}
+
+// bucket the entities that never move (or w/ movers, all of them, where they are now) & have any of types into a grid
+// (w/ its cell_px, cells_w & cells_h set): count each cell's, then fill them in, in index order (like gridCollision() expects)
+void fillGrid(StaticGrid* grid, Entity ents[], int len_ents, byte types, bool movers) {
+  int num_cells = grid->cells_w * grid->cells_h;
+  if (num_cells + 1 > grid->max_starts) {
+    grid->max_starts = num_cells + 1;
+    grid->starts = (int*)realloc(grid->starts, grid->max_starts * sizeof(int));
+    if (!grid->starts)
+      error("allocating grid");
+  }
+  memset(grid->starts, 0, (num_cells + 1) * sizeof(int));
+
+  int cx1, cy1, cx2, cy2;
+  for (int i = 0; i < len_ents; ++i) {
+    if (!(ents[i].flags & types) || (!movers && isDynamic(&ents[i])))
+      continue;
+    gridRange(grid, ents[i].x, ents[i].y, ents[i].w, ents[i].h, &cx1, &cy1, &cx2, &cy2);
+    for (int cy = cy1; cy <= cy2; ++cy)
+      for (int cx = cx1; cx <= cx2; ++cx)
+        grid->starts[cy * grid->cells_w + cx + 1]++;
+  }
+  for (int c = 0; c < num_cells; ++c)
+    grid->starts[c + 1] += grid->starts[c];
+
+  if (grid->starts[num_cells] + 1 > grid->max_ixs) {
+    grid->max_ixs = (grid->starts[num_cells] + 1) * 2;
+    grid->ixs = (int*)realloc(grid->ixs, grid->max_ixs * sizeof(int));
+    if (!grid->ixs)
+      error("allocating grid");
+  }
+  for (int i = 0; i < len_ents; ++i) {
+    if (!(ents[i].flags & types) || (!movers && isDynamic(&ents[i])))
+      continue;
+    gridRange(grid, ents[i].x, ents[i].y, ents[i].w, ents[i].h, &cx1, &cy1, &cx2, &cy2);
+    for (int cy = cy1; cy <= cy2; ++cy)
+      for (int cx = cx1; cx <= cx2; ++cx)
+        grid->ixs[grid->starts[cy * grid->cells_w + cx]++] = i;
+  }
+
+  // (filling moved each cell's start up to the next one's)
+  memmove(grid->starts + 1, grid->starts, num_cells * sizeof(int));
+  grid->starts[0] = 0;
+}
+
+// findCollision() on bucketed statics, checking only the ones in the cells the box touches
+// (an entity can be in several cells, so it's the first hit by index that counts, like findCollision()'s)
+int gridCollision(StaticGrid* grid, Entity statics[], int x, int y, int w, int h, byte type, int* num_tests) {
+  int cx1, cy1, cx2, cy2;
+  gridRange(grid, x, y, w, h, &cx1, &cy1, &cx2, &cy2);
+
+  int hit = -1;
+  for (int cy = cy1; cy <= cy2; ++cy) {
+    for (int cx = cx1; cx <= cx2; ++cx) {
+      int cell_ix = cy * grid->cells_w + cx;
+      for (int i = grid->starts[cell_ix]; i < grid->starts[cell_ix + 1]; ++i) {
+        int ix = grid->ixs[i];
+        if (hit > -1 && ix >= hit)
+          break; // (the rest of the cell's come later still)
+        Entity* other = &statics[ix];
+        if (!(other->flags & type))
+          continue;
+        (*num_tests)++;
+        if (x + w > other->x && x < other->x + other->w && y + h > other->y && y < other->y + other->h)
+          hit = ix;
+      }
+    }
+  }
+  return hit;
+}
+
+// collides() in a world: the game's is `entities`, others are the level's statics & then their own movers
+// (mover_ix is the mover asking, in whichever of those it's in, or -1 for the player)
+int worldCollides(World* w, int x, int y, int wd, int h, int mover_ix, byte type) {
+  if (!w->statics)
+    return collides(x, y, wd, h, mover_ix, entities, type);
+
+  int num_tests = 0;
+  int hit = w->grid ? gridCollision(w->grid, w->statics, x, y, wd, h, type, &num_tests) :
+    findCollision(x, y, wd, h, -1, w->statics, w->len_statics, type, &num_tests);
+  if (hit > -1)
+    return hit;
+
+  // a mover that's boxed (see boxMovers()) can only meet the others if its box overlaps theirs, as long as it's looking
+  // inside its box (one stuck in a wall can inch out of it, & then there's no telling where it ends up for the rest)
+  if (mover_ix > -1 && w->mover_boxes && !w->movers_escaped) {
+    EnemyBox* box = &w->mover_boxes[w->len_movers + mover_ix];
+    if (x < box->x1 || y < box->y1 || x + wd > box->x2 || y + h > box->y2)
+      w->movers_escaped = true;
+    else if (!box->conflict)
+      return -1;
+  }
+  hit = findCollision(x, y, wd, h, mover_ix, w->movers, w->len_movers, type, &num_tests);
+  return hit > -1 ? w->len_statics + hit : -1;
+}
+
+// what a world's player will hit (of a type of entity) w/ its next move
+int playerWillCollide(World* w, byte type) {
+  Entity* player = &w->player;
+  int x = player->x + player->dx;
+  int y = player->y + player->dy;
+  if (!w->statics)
+    return triggerCollision(x, y, player->w, player->h, type);
+  return worldCollides(w, x, y, player->w, player->h, -1, type);
+}
+
+// collides() for the player & a type of trigger, from the trigger map (rebuilt if entities have changed since):
+// the static triggers in the cells the box touches are gathered when it's in different cells than last time,
+// & it's those & the moving triggers that are tested
+int triggerCollision(int x, int y, int w, int h, byte type) {
+  if (trigger_version != world_version) {
+    trigger_map.cell_px = TRIGGER_CELL_TILES * grid_size;
+    trigger_map.cells_w = level_w / trigger_map.cell_px + 1;
+    trigger_map.cells_h = level_h / trigger_map.cell_px + 1;
+    fillGrid(&trigger_map, entities, len_entities, TRIGGERS, false);
+
+    len_moving_triggers = 0;
+    for (int i = 0; i < len_entities; ++i) {
+      if (!(entities[i].flags & TRIGGERS) || !isDynamic(&entities[i]))
+        continue;
+      if (len_moving_triggers == max_moving_triggers) {
+        max_moving_triggers = max_moving_triggers ? max_moving_triggers * 2 : 64;
+        moving_triggers = (int*)realloc(moving_triggers, max_moving_triggers * sizeof(int));
+        if (!moving_triggers)
+          error("allocating triggers");
+      }
+      moving_triggers[len_moving_triggers++] = i;
+    }
+    trigger_version = world_version;
+    near_x1 = 0;
+    near_x2 = -1;
+  }
+
+  int cx1, cy1, cx2, cy2;
+  gridRange(&trigger_map, x, y, w, h, &cx1, &cy1, &cx2, &cy2);
+  bool moved_cells = cx1 != near_x1 || cy1 != near_y1 || cx2 != near_x2 || cy2 != near_y2;
+  if (moved_cells) {
+    len_near_triggers = 0;
+    for (int cy = cy1; cy <= cy2; ++cy) {
+      for (int cx = cx1; cx <= cx2; ++cx) {
+        int cell_ix = cy * trigger_map.cells_w + cx;
+        for (int i = trigger_map.starts[cell_ix]; i < trigger_map.starts[cell_ix + 1]; ++i) {
+          if (len_near_triggers == max_near_triggers) {
+            max_near_triggers = max_near_triggers ? max_near_triggers * 2 : 64;
+            near_triggers = (int*)realloc(near_triggers, max_near_triggers * sizeof(int));
+            if (!near_triggers)
+              error("allocating triggers");
+          }
+          near_triggers[len_near_triggers++] = trigger_map.ixs[i];
+        }
+      }
+    }
+    // (in index order, so the first hit's the one collides() would find)
+    qsort(near_triggers, len_near_triggers, sizeof(int), compareInts);
+    near_x1 = cx1;
+    near_y1 = cy1;
+    near_x2 = cx2;
+    near_y2 = cy2;
+  }
+
+  // (the moving ones whose cells overlap those, like they'd be bucketed into the map if they stood still)
+  if (moved_cells || movers_moved) {
+    len_near_movers = 0;
+    for (int t = 0; t < len_moving_triggers; ++t) {
+      Entity* ent = &entities[moving_triggers[t]];
+      int ex1, ey1, ex2, ey2;
+      gridRange(&trigger_map, ent->x, ent->y, ent->w, ent->h, &ex1, &ey1, &ex2, &ey2);
+      if (ex1 > cx2 || ex2 < cx1 || ey1 > cy2 || ey2 < cy1)
+        continue;
+      if (len_near_movers == max_near_movers) {
+        max_near_movers = max_near_movers ? max_near_movers * 2 : 64;
+        near_movers = (int*)realloc(near_movers, max_near_movers * sizeof(int));
+        if (!near_movers)
+          error("allocating triggers");
+      }
+      near_movers[len_near_movers++] = moving_triggers[t];
+    }
+    movers_moved = false;
+  }
+
+  int hit = -1;
+  int num_tests = 0;
+  for (int t = 0; t < len_near_triggers && hit < 0; ++t) {
+    Entity* ent = &entities[near_triggers[t]];
+    if (!(ent->flags & type))
+      continue;
+    num_tests++;
+    if (x + w > ent->x && x < ent->x + ent->w && y + h > ent->y && y < ent->y + ent->h)
+      hit = near_triggers[t];
+  }
+  for (int t = 0; t < len_near_movers && (hit < 0 || near_movers[t] < hit); ++t) {
+    Entity* ent = &entities[near_movers[t]];
+    if (!(ent->flags & type))
+      continue;
+    num_tests++;
+    if (x + w > ent->x && x < ent->x + ent->w && y + h > ent->y && y < ent->y + ent->h)
+      hit = near_movers[t];
+  }
+
+#if PROFILE
+  collide_queries++;
+  collide_tests += num_tests;
+  if (show_heatmap)
+    heatQuery(x, y, w, h, -1, type, hit);
+#endif
+  return hit;
+}
+
+// let the trigger map go (it's sized to the level)
+void freeTriggers() {
+  free(trigger_map.starts);
+  free(trigger_map.ixs);
+  free(moving_triggers);
+  free(near_triggers);
+  free(near_movers);
+  trigger_map.starts = NULL;
+  trigger_map.ixs = NULL;
+  trigger_map.max_starts = trigger_map.max_ixs = 0;
+  moving_triggers = NULL;
+  near_triggers = NULL;
+  near_movers = NULL;
+  max_moving_triggers = max_near_triggers = max_near_movers = 0;
+  len_moving_triggers = len_near_triggers = len_near_movers = 0;
+  movers_moved = true;
+  trigger_version = -1;
+}
+
+int collides(int x, int y, int w, int h, int ix, Entity entities[], byte type) {
+  int num_tests = 0;
+  int hit = findCollision(x, y, w, h, ix, entities, len_entities, type, &num_tests);
+
+#if PROFILE
+  collide_queries++;
+  collide_tests += num_tests;
+  if (show_heatmap)
+    heatQuery(x, y, w, h, ix, type, hit);
+#endif
+  return hit;
+}
+
+// collides() against any array of entities, w/out the profiling (which isn't thread safe), adding the box tests it does to *num_tests
+int findCollision(int x, int y, int w, int h, int ix, Entity ents[], int len_ents, byte type, int* num_tests) {
+  int x2 = x + w;
+  int y2 = y + h;
+  int hit = -1;
+  int tests = 0;
+
+  for (int i = 0; i < len_ents; ++i) {
+    if (i != ix && ents[i].flags & type) {
+      tests++;
+      int other_x = ents[i].x;
+      int other_y = ents[i].y;
+      int other_x2 = ents[i].x + ents[i].w;
+      int other_y2 = ents[i].y + ents[i].h;
+
+      // DO collide if
+      if (x2 > other_x && x < other_x2 &&
+        y2 > other_y && y < other_y2) {
+          hit = i;
+          break;
+      }
+    }
+  }
+
+  *num_tests += tests;
+  return hit;
+}
+
+int sign(float n) {
+  if (n > 0)
+    return 1;
+  else if (n < 0)
+    return -1;
+  else
+    return 0;
+}
+
+void error(char* activity) {
+  printf("%s failed: %s\n", activity, strerror(errno));//SDL_GetError());
+  SDL_Quit();
+  exit(-1);
+}
+
+// number of bytes an entity (w/ its shapes & vertices) takes up in a level file
+size_t entityBytes(Entity* entity) {
+  size_t num_bytes = sizeof(Entity);
+  for (int j = 0; j < entity->len_shapes; ++j)
+    num_bytes += sizeof(Shape) + entity->shapes[j].len_vertices * sizeof(short) * 2;
+
+  return num_bytes;
+}
+
+// copy an entity & its shapes & vertices into a level buffer, returns the position just after it
+// (pointers are written as NULL, so the same level always makes the same bytes & they compress well)
+void* writeEntity(void* buffer_ix, Entity* entity) {
+  Entity record = *entity;
+  record.shapes = NULL;
+  memcpy(buffer_ix, &record, sizeof(Entity));
+  buffer_ix += sizeof(Entity);
+
+  for (int j = 0; j < entity->len_shapes; ++j) {
+    Shape* shape = &(entity->shapes[j]);
+    Shape shape_record = *shape;
+    shape_record.x = NULL;
+    shape_record.y = NULL;
+    memcpy(buffer_ix, &shape_record, sizeof(Shape));
+    buffer_ix += sizeof(Shape);
+
+    // copy x & y vertices
+    memcpy(buffer_ix, shape->x, shape->len_vertices * sizeof(short));
+    buffer_ix += shape->len_vertices * sizeof(short);
+    memcpy(buffer_ix, shape->y, shape->len_vertices * sizeof(short));
+    buffer_ix += shape->len_vertices * sizeof(short);
+  }
+
+  return buffer_ix;
+}
+
+// read an entity out of a level buffer (allocating its shapes & vertices), returns the position just after it
+void* readEntity(void* buffer_ix, Entity* entity) {
+  memcpy(entity, buffer_ix, sizeof(Entity));
+  buffer_ix += sizeof(Entity);
+
+  entity->shapes = (Shape*)calloc(MAX_SHAPES, sizeof(Shape));
+  for (int j = 0; j < entity->len_shapes; ++j) {
+    Shape* shape = &(entity->shapes[j]);
+    memcpy(shape, buffer_ix, sizeof(Shape));
+    buffer_ix += sizeof(Shape);
+
+    shape->x = (short*)calloc(MAX_VERTICES, sizeof(short));
+    shape->y = (short*)calloc(MAX_VERTICES, sizeof(short));
+
+    // copy x & y vertices
+    memcpy(shape->x, buffer_ix, shape->len_vertices * sizeof(short));
+    buffer_ix += shape->len_vertices * sizeof(short);
+    memcpy(shape->y, buffer_ix, shape->len_vertices * sizeof(short));
+    buffer_ix += shape->len_vertices * sizeof(short);
+  }
+
+  return buffer_ix;
+}
+
+// enemies (& anything else w/ velocity or gravity) can move from one chunk to another
+bool isDynamic(Entity* ent) {
+  return ent->dx || ent->dy || ent->grav_y;
+}
+
+// read the chunk table & page in the chunks around the start position
+// (the rest are paged in by the loader thread as the player moves around)
+void loadLevel() {
+  LevelHeader header = {};
+  world_version++;
+  chunk_file = fopen(level_path, "rb"); // read binary
+  if (chunk_file) {
+    if (fread(&header, sizeof(header), 1, chunk_file) != 1 || !validLevelHeader(&header))
+      error("reading level file header");
+  }
+  else {
+    header.level_w = vp.w;
+    header.level_h = vp.h;
+  }
+
+  level_w = header.level_w;
+  level_h = header.level_h;
+  level_compressed = header.flags & LEVEL_COMPRESSED;
+  chunk_px = CHUNK_TILES * grid_size;
+  chunks_w = level_w / chunk_px + 1;
+  chunks_h = level_h / chunk_px + 1;
+
+  // a header can claim a huge level, so check its chunk table's really in the file before allocating for it
+  int64_t file_len = 0;
+  if (chunk_file) {
+    fseek(chunk_file, 0, SEEK_END);
+    file_len = ftell(chunk_file);
+    if ((int64_t)sizeof(header) + (int64_t)chunks_w * chunks_h * (int64_t)sizeof(ChunkEntry) > file_len)
+      error("reading level file chunk table");
+  }
+
+  chunks = (Chunk*)calloc(chunks_w * chunks_h, sizeof(Chunk));
+  live_chunks = (int*)calloc(chunks_w * chunks_h, sizeof(int));
+  if (!chunks || !live_chunks)
+    error("allocating chunks");
+
+  if (chunk_file) {
+    int64_t data_offset = sizeof(header) + chunks_w * chunks_h * sizeof(ChunkEntry);
+    fseek(chunk_file, sizeof(header), SEEK_SET);
+    for (int i = 0; i < chunks_w * chunks_h; ++i)
+      if (fread(&chunks[i].stored, sizeof(ChunkEntry), 1, chunk_file) != 1 ||
+        !validChunkEntry(&chunks[i].stored, level_compressed, data_offset, file_len))
+        error("reading level file chunk table");
+  }
+
+  // the camera can end up anywhere w/in a viewport of the start position, so load all of that
+  int x1, y1, x2, y2;
+  chunkRange(world.start_x - vp.w, world.start_y - vp.h, vp.w * 2, vp.h * 2, CHUNK_LOAD_MARGIN, &x1, &y1, &x2, &y2);
+  for (int cy = y1; cy <= y2; ++cy)
+    for (int cx = x1; cx <= x2; ++cx)
+      loadChunkNow(cy * chunks_w + cx);
+
+  if (!chunk_file) {
+    // create a default ground entity/shape
+    Entity* ground_ent = createEntity(WALL, 6, 0, vp.h - (vp.h % grid_size) - grid_size, vp.w, grid_size);
+    Shape* ground_shape = &(ground_ent->shapes[0]);
+    fillShape(ground_shape);
+    addRectPoints(ground_shape, 0, 0, vp.w, grid_size);
+  }
+
+  // replay edits made since the level was saved (a crash mid-save can leave 2 journals), then keep appending to the last one
+  // journals from before this level's generation are left over from a crash just after a save, so they're stale
+  removeJournalsBefore(header.generation);
+
+  journal_gen = header.generation;
+  replayJournal(journal_gen);
+  while (replayJournal(journal_gen + 1))
+    journal_gen++;
+  startActivity(header.flags & LEVEL_WAKE_RESET);
+  if (!recording && !replaying)
+    openJournal(journal_gen, "ab"); // append binary
+
+  chunk_sem = SDL_CreateSemaphore(0);
+  chunk_thread = SDL_CreateThread(chunkLoader, "chunk loader", NULL);
+  if (!chunk_sem || !chunk_thread)
+    error("starting chunk loader");
+}
+
+// stop the loader & free the level (the opposite of loadLevel())
+void unloadLevel() {
+  ChunkMsg quit_msg = { .type = CHUNK_QUIT };
+  pushChunkMsg(&chunk_requests, quit_msg);
+  SDL_SemPost(chunk_sem);
+  SDL_WaitThread(chunk_thread, NULL);
+  SDL_DestroySemaphore(chunk_sem);
+  if (chunk_file)
+    fclose(chunk_file);
+  if (journal_file)
+    fclose(journal_file);
+  chunk_file = NULL;
+  journal_file = NULL;
+  journal_bytes = 0;
+
+  receiveChunks(); // finishes off a save that was still being written
+  for (int i = 0; i < len_entities; ++i)
+    freeEntity(&entities[i]);
+  free(entities);
+  free(unfreed_entities);
+  free(save_staging);
+  freeBoxes(&box_index);
+  entities = NULL;
+  len_entities = max_entities = 0;
+  unfreed_entities = NULL;
+  len_unfreed_entities = max_unfreed_entities = 0;
+  save_staging = NULL;
+  max_save_staging = 0;
+  selected_shape = NULL;
+#if PROFILE
+  freeHeatmap(); // it's sized to the level
+#endif
+  freeTriggers();
+  freeUndo();
+
+  for (int i = 0; i < chunks_w * chunks_h; ++i)
+    free(chunks[i].data);
+  free(chunks);
+  free(live_chunks);
+  chunks = NULL;
+  live_chunks = NULL;
+  len_live_chunks = 0;
+  stopActivity();
+}
+
+// snapshot the level & hand it to the loader thread to encode & write, so saving never hitches the game
+// the snapshot is just a memcpy of `entities` into a staging buffer: shapes aren't copied b/c they aren't changed or freed until the save is done
+// (except the shape being drawn, which gets its own copy)
+void saveLevel(bool drawing) {
+  if (recording || replaying) {
+    showNote("Not saving while recording or replaying");
+    return;
+  }
+  if (save_in_flight) {
+    showNote("Still saving the last save");
+    return;
+  }
+  if (chunk_msgs_out >= CHUNK_QUEUE_LEN)
+    return;
+
+  Uint64 start = SDL_GetPerformanceCounter();
+
+  if (len_entities > max_save_staging) {
+    max_save_staging = max_entities;
+    save_staging = (Entity*)realloc(save_staging, max_save_staging * sizeof(Entity));
+  }
+  memcpy(save_staging, entities, len_entities * sizeof(Entity));
+
+  ChunkMsg msg = {
+    .type = CHUNK_SAVE,
+    .len_entities = len_entities,
+    .entities = save_staging,
+    .len_resident = 0,
+    .len_chunk_ixs = 0,
+    .chunk_ixs = (int*)malloc(len_live_chunks * sizeof(int)),
+    .copied_ix = -1,
+    .generation = journal_gen + 1,
+    .level_flags = wake_reset ? LEVEL_WAKE_RESET : 0
+  };
+
+  if (drawing) {
+    msg.copied_ix = len_entities - 1;
+    Entity* ent = &msg.entities[msg.copied_ix];
+    Shape* shapes = ent->shapes;
+    ent->shapes = (Shape*)calloc(MAX_SHAPES, sizeof(Shape));
+    for (int j = 0; j < ent->len_shapes; ++j) {
+      ent->shapes[j] = shapes[j];
+      ent->shapes[j].x = (short*)calloc(MAX_VERTICES, sizeof(short));
+      ent->shapes[j].y = (short*)calloc(MAX_VERTICES, sizeof(short));
+      memcpy(ent->shapes[j].x, shapes[j].x, MAX_VERTICES * sizeof(short));
+      memcpy(ent->shapes[j].y, shapes[j].y, MAX_VERTICES * sizeof(short));
+    }
+  }
+
+  for (int i = 0; i < len_live_chunks; ++i)
+    if (chunks[live_chunks[i]].state == CHUNK_RESIDENT)
+      msg.chunk_ixs[msg.len_chunk_ixs++] = live_chunks[i];
+  msg.len_resident = msg.len_chunk_ixs;
+  for (int i = 0; i < len_live_chunks; ++i)
+    if (chunks[live_chunks[i]].state == CHUNK_LOADING)
+      msg.chunk_ixs[msg.len_chunk_ixs++] = live_chunks[i];
+
+  // (traced before waking the loader, which can preempt us on a single core)
+  traceEvent(trace_world, "saveLevel", 'X', start, SDL_GetPerformanceCounter());
+  save_in_flight = true;
+  sendChunkMsg(msg);
+
+  // edits from here on go on top of the new level
+  fclose(journal_file);
+  openJournal(msg.generation, "wb"); // write binary
+  journal_bytes = 0;
+}
+
+// (loader thread) write every chunk to a temp file & rename it over the level file, so a crash mid-save can't corrupt the level
+// resident chunks are written from the snapshot, the rest from what's stored
+// entities that wandered into loading chunks are written too, but not ones in unloaded (or storing) chunks,
+// since the main thread will merge those into what's stored after this
+// if it fails, msg->failure says why (& the level file & journal are left as they were, unless it's fatal)
+void writeLevel(ChunkMsg* msg) {
+  Entity* snapshot = msg->entities;
+  int len_snapshot = msg->len_entities;
+  int num_chunks = chunks_w * chunks_h;
+  byte* snapshot_states = (byte*)calloc(num_chunks, sizeof(byte));
+  for (int i = 0; i < msg->len_chunk_ixs; ++i)
+    snapshot_states[msg->chunk_ixs[i]] = i < msg->len_resident ? CHUNK_RESIDENT : CHUNK_LOADING;
+
+  // bucket the snapshot by chunk (counting sort), so each chunk's records can be written together
+  int* chunk_starts = (int*)calloc(num_chunks + 1, sizeof(int));
+  int* sorted = (int*)malloc(len_snapshot * sizeof(int) + 1);
+  for (int i = 0; i < len_snapshot; ++i) {
+    int chunk_ix = chunkIndexAt(snapshot[i].x, snapshot[i].y);
+    if (snapshot_states[chunk_ix] != CHUNK_UNLOADED)
+      chunk_starts[chunk_ix + 1]++;
+  }
+  for (int c = 0; c < num_chunks; ++c)
+    chunk_starts[c + 1] += chunk_starts[c];
+  int* chunk_fill = (int*)malloc(num_chunks * sizeof(int));
+  memcpy(chunk_fill, chunk_starts, num_chunks * sizeof(int));
+  for (int i = 0; i < len_snapshot; ++i) {
+    int chunk_ix = chunkIndexAt(snapshot[i].x, snapshot[i].y);
+    if (snapshot_states[chunk_ix] != CHUNK_UNLOADED)
+      sorted[chunk_fill[chunk_ix]++] = i;
+  }
+  free(chunk_fill);
+
+  char tmp_path[256];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", level_path);
+  FILE* file = fopen(tmp_path, "wb"); // write binary
+  if (!file) {
+    msg->failure = "opening the temp file";
+    free(snapshot_states);
+    free(chunk_starts);
+    free(sorted);
+    return;
+  }
+
+  LevelHeader header = {
+    .magic = {'P', 'L', 'T', '4'},
+    .level_w = level_w,
+    .level_h = level_h,
+    .chunks_w = chunks_w,
+    .chunks_h = chunks_h,
+    .generation = msg->generation,
+    .flags = (compress_level ? LEVEL_COMPRESSED : 0) | msg->level_flags
+  };
+  ChunkEntry* table = (ChunkEntry*)calloc(num_chunks, sizeof(ChunkEntry));
+  fwrite(&header, sizeof(header), 1, file);
+  fwrite(table, sizeof(ChunkEntry), num_chunks, file); // placeholder, filled in below
+
+  int64_t offset = sizeof(header) + num_chunks * sizeof(ChunkEntry);
+  void* buffer = NULL;
+  size_t buffer_len = 0;
+  byte* packed = NULL;
+  for (int c = 0; c < num_chunks; ++c) {
+    Chunk* chunk = &chunks[c];
+    bool use_stored = snapshot_states[c] != CHUNK_RESIDENT;
+    size_t num_bytes = use_stored ? chunk->stored.num_bytes : 0;
+    for (int i = chunk_starts[c]; i < chunk_starts[c + 1]; ++i)
+      num_bytes += entityBytes(&snapshot[sorted[i]]);
+
+    if (num_bytes > buffer_len) {
+      buffer_len = num_bytes * 2;
+      buffer = realloc(buffer, buffer_len);
+      packed = (byte*)realloc(packed, lzBound(buffer_len));
+    }
+
+    void* buffer_ix = buffer;
+    if (use_stored && chunk->stored.num_bytes) {
+      readChunkBytes(c, buffer_ix);
+      buffer_ix += chunk->stored.num_bytes;
+    }
+    for (int i = chunk_starts[c]; i < chunk_starts[c + 1]; ++i)
+      buffer_ix = writeEntity(buffer_ix, &snapshot[sorted[i]]);
+
+    // sanity check
+    if (buffer_ix - buffer != num_bytes) {
+      msg->failure = "byte mismatch on file save";
+      break;
+    }
+
+    table[c].offset = offset;
+    table[c].num_bytes = num_bytes;
+    table[c].file_bytes = num_bytes;
+    table[c].len_entities = (use_stored ? chunk->stored.len_entities : 0) + chunk_starts[c + 1] - chunk_starts[c];
+    if (num_bytes && compress_level) {
+      table[c].file_bytes = lzCompress(buffer, num_bytes, packed);
+      fwrite(packed, table[c].file_bytes, 1, file);
+    }
+    else if (num_bytes) {
+      fwrite(buffer, num_bytes, 1, file);
+    }
+    offset += table[c].file_bytes;
+  }
+
+  fseek(file, sizeof(header), SEEK_SET);
+  fwrite(table, sizeof(ChunkEntry), num_chunks, file);
+  bool write_failed = ferror(file);
+  if (fclose(file))
+    write_failed = true;
+  if (write_failed && !msg->failure)
+    msg->failure = "writing the level file";
+  if (msg->failure)
+    remove(tmp_path);
+  else
+    swapLevelFile(msg, tmp_path, table);
+
+  free(buffer);
+  free(packed);
+  free(table);
+  free(snapshot_states);
+  free(chunk_starts);
+  free(sorted);
+}
+
+// (loader thread) rename the written temp file over the level file & point every chunk at it
+void swapLevelFile(ChunkMsg* msg, char* tmp_path, ChunkEntry* table) {
+  bool removed_old = false;
+#ifdef _WIN32
+  // windows won't rename over an existing file (or remove an open one)
+  if (chunk_file)
+    fclose(chunk_file);
+  chunk_file = NULL;
+  remove(level_path);
+  removed_old = true;
+#endif
+  if (rename(tmp_path, level_path)) {
+    msg->failure = "renaming the level file";
+    msg->fatal = removed_old;
+    return;
+  }
+
+  if (chunk_file)
+    fclose(chunk_file);
+  chunk_file = fopen(level_path, "rb");
+  if (!chunk_file) {
+    msg->failure = "reopening the level file";
+    msg->fatal = true;
+    return;
+  }
+  level_compressed = compress_level;
+
+  // the new level has all the edits from the previous generations' journals (more than 1 if the last save failed)
+  removeJournalsBefore(msg->generation);
+
+  for (int c = 0; c < chunks_w * chunks_h; ++c) {
+    chunks[c].stored = table[c];
+    free(chunks[c].data);
+    chunks[c].data = NULL;
+  }
+}
+
+int chunkIndexAt(int x, int y) {
+  int cx = x < 0 ? 0 : x / chunk_px;
+  int cy = y < 0 ? 0 : y / chunk_px;
+  if (cx >= chunks_w)
+    cx = chunks_w - 1;
+  if (cy >= chunks_h)
+    cy = chunks_h - 1;
+
+  return cy * chunks_w + cx;
+}
+
+// the (inclusive) range of chunks overlapping a region in world coords, grown by `margin` chunks on each side
+void chunkRange(int x, int y, int w, int h, int margin, int* x1, int* y1, int* x2, int* y2) {
+  int first = chunkIndexAt(x, y);
+  int last = chunkIndexAt(x + w, y + h);
+  *x1 = first % chunks_w - margin;
+  *y1 = first / chunks_w - margin;
+  *x2 = last % chunks_w + margin;
+  *y2 = last / chunks_w + margin;
+  if (*x1 < 0)
+    *x1 = 0;
+  if (*y1 < 0)
+    *y1 = 0;
+  if (*x2 >= chunks_w)
+    *x2 = chunks_w - 1;
+  if (*y2 >= chunks_h)
+    *y2 = chunks_h - 1;
+}
+
+// copy a chunk's stored entity records into buffer
+// (from memory if it was changed & paged out since the last save, otherwise from the level file)
+void readChunkBytes(int chunk_ix, void* buffer) {
+  Chunk* chunk = &chunks[chunk_ix];
+  if (chunk->data) {
+    memcpy(buffer, chunk->data, chunk->stored.num_bytes);
+    return;
+  }
+
+  void* file_buffer = level_compressed ? malloc(chunk->stored.file_bytes) : buffer;
+  if (fseek(chunk_file, chunk->stored.offset, SEEK_SET) || fread(file_buffer, chunk->stored.file_bytes, 1, chunk_file) != 1)
+    error("reading chunk");
+
+  if (level_compressed) {
+    if (lzDecompress(file_buffer, chunk->stored.file_bytes, buffer, chunk->stored.num_bytes) != chunk->stored.num_bytes)
+      error("decompressing chunk");
+    free(file_buffer);
+  }
+}
+
+// read a chunk's stored entities into a new array (chunk->stored.len_entities long)
+Entity* readChunk(int chunk_ix) {
+  Chunk* chunk = &chunks[chunk_ix];
+  void* buffer = malloc(chunk->stored.num_bytes + 1);
+  if (chunk->stored.num_bytes)
+    readChunkBytes(chunk_ix, buffer);
+  if (!validChunk(buffer, chunk->stored.num_bytes, chunk->stored.len_entities))
+    error("validating chunk");
+
+  Entity* chunk_entities = (Entity*)calloc(chunk->stored.len_entities + 1, sizeof(Entity));
+  void* buffer_ix = buffer;
+  for (int i = 0; i < chunk->stored.len_entities; ++i)
+    buffer_ix = readEntity(buffer_ix, &chunk_entities[i]);
+
+  free(buffer);
+  return chunk_entities;
+}
+
+// page a chunk in on the calling thread (only used before the loader thread starts)
+void loadChunkNow(int chunk_ix) {
+  ChunkMsg msg = {
+    .type = CHUNK_LOAD,
+    .chunk_ix = chunk_ix,
+    .len_entities = chunks[chunk_ix].stored.len_entities,
+    .entities = readChunk(chunk_ix)
+  };
+  chunks[chunk_ix].state = CHUNK_LOADING;
+  live_chunks[len_live_chunks++] = chunk_ix;
+  chunk_msgs_out++;
+  pushChunkMsg(&chunk_replies, msg);
+  receiveChunks();
+}
+
+void sendChunkMsg(ChunkMsg msg) {
+  pushChunkMsg(&chunk_requests, msg);
+  chunk_msgs_out++;
+  SDL_SemPost(chunk_sem);
+}
+
+// pull a chunk's entities out of `entities` & hand them to the loader to page out
+// merge is for entities that wandered into a chunk that isn't loaded, so they're added to what's already stored
+void storeChunk(int chunk_ix, bool merge) {
+  Chunk* chunk = &chunks[chunk_ix];
+  ChunkMsg msg = {
+    .type = CHUNK_STORE,
+    .dirty = chunk->dirty || merge,
+    .merge = merge,
+    .chunk_ix = chunk_ix,
+    .len_entities = 0,
+    .entities = NULL
+  };
+
+  int max_chunk_entities = 0;
+  for (int i = 0; i < len_entities; ++i) {
+    if (chunkIndexAt(entities[i].x, entities[i].y) != chunk_ix)
+      continue;
+
+    if (msg.len_entities == max_chunk_entities) {
+      max_chunk_entities = max_chunk_entities ? max_chunk_entities * 2 : 64;
+      msg.entities = (Entity*)realloc(msg.entities, max_chunk_entities * sizeof(Entity));
+    }
+    msg.entities[msg.len_entities++] = entities[i];
+
+    // remove it by copying the tip entity over it (w/o freeing, the loader owns it now)
+    boxRemove(&box_index, i);
+    if (i != len_entities - 1)
+      boxMove(&box_index, len_entities - 1, i);
+    entities[i] = entities[len_entities - 1];
+    if (spawns)
+      spawns[i] = spawns[len_entities - 1];
+    memset(&entities[len_entities - 1], 0, sizeof(Entity));
+    len_entities--;
+    i--;
+  }
+
+  if (chunk->state == CHUNK_UNLOADED)
+    live_chunks[len_live_chunks++] = chunk_ix;
+  if (msg.len_entities)
+    world_version++;
+  chunk->state = CHUNK_STORING;
+  chunk->dirty = false;
+  sendChunkMsg(msg);
+}
+
+// handle the loader's replies: add paged-in entities to `entities` & mark paged-out chunks as unloaded
+void receiveChunks() {
+  ChunkMsg msg;
+  while (popChunkMsg(&chunk_replies, &msg)) {
+    chunk_msgs_out--;
+    Chunk* chunk = &chunks[msg.chunk_ix]; // (chunk_ix is 0 for saves)
+
+    if (msg.type == CHUNK_LOAD) {
+      reserveEntities(len_entities + msg.len_entities);
+      for (int i = 0; i < msg.len_entities; ++i) {
+        if (spawns) {
+          spawns[len_entities].x = msg.entities[i].x;
+          spawns[len_entities].y = msg.entities[i].y;
+        }
+        entities[len_entities] = msg.entities[i];
+        boxInsert(&box_index, len_entities);
+        len_entities++;
+
+        // dynamic entities can leave the chunk, so it'll need to be re-stored when paged out
+        if (isDynamic(&msg.entities[i]))
+          chunk->dirty = true;
+      }
+      free(msg.entities);
+      chunk->state = CHUNK_RESIDENT;
+      world_version++;
+    }
+    else if (msg.type == CHUNK_SAVE) {
+      save_in_flight = false;
+      if (msg.fatal)
+        error(msg.failure);
+      showNote(msg.failure ? "Save failed" : "Saved");
+      for (int i = 0; i < len_unfreed_entities; ++i)
+        freeEntity(&unfreed_entities[i]);
+      len_unfreed_entities = 0;
+    }
+    else {
+      chunk->state = CHUNK_UNLOADED;
+      for (int i = 0; i < len_live_chunks; ++i) {
+        if (live_chunks[i] == msg.chunk_ix) {
+          live_chunks[i] = live_chunks[--len_live_chunks];
+          break;
+        }
+      }
+    }
+  }
+}
+
+// page in chunks around a region (in world coords) & page out the ones that are far enough away
+void updateChunks(int x, int y, int w, int h) {
+  receiveChunks();
+
+  int x1, y1, x2, y2;
+  chunkRange(x, y, w, h, CHUNK_LOAD_MARGIN, &x1, &y1, &x2, &y2);
+  for (int cy = y1; cy <= y2; ++cy) {
+    for (int cx = x1; cx <= x2; ++cx) {
+      int chunk_ix = cy * chunks_w + cx;
+      if (chunks[chunk_ix].state == CHUNK_UNLOADED && chunk_msgs_out < CHUNK_QUEUE_LEN) {
+        chunks[chunk_ix].state = CHUNK_LOADING;
+        live_chunks[len_live_chunks++] = chunk_ix;
+        ChunkMsg msg = { .type = CHUNK_LOAD, .chunk_ix = chunk_ix };
+        sendChunkMsg(msg);
+      }
+    }
+  }
+
+  // page out resident chunks outside the (larger) keep range
+  chunkRange(x, y, w, h, CHUNK_KEEP_MARGIN, &x1, &y1, &x2, &y2);
+  for (int i = 0; i < len_live_chunks; ++i) {
+    int chunk_ix = live_chunks[i];
+    int cx = chunk_ix % chunks_w;
+    int cy = chunk_ix / chunks_w;
+    if (chunks[chunk_ix].state == CHUNK_RESIDENT && (cx < x1 || cx > x2 || cy < y1 || cy > y2) && chunk_msgs_out < CHUNK_QUEUE_LEN)
+      storeChunk(chunk_ix, false);
+  }
+
+  storeStrays();
+}
+
+// page out entities that wandered into chunks that aren't loaded
+void storeStrays() {
+  for (int i = 0; i < len_entities; ++i) {
+    int chunk_ix = chunkIndexAt(entities[i].x, entities[i].y);
+    if (chunks[chunk_ix].state == CHUNK_UNLOADED && chunk_msgs_out < CHUNK_QUEUE_LEN) {
+      storeChunk(chunk_ix, true);
+      i--; // storeChunk() moved another entity into this slot
+    }
+  }
+}
+
+// whether every chunk overlapping a region (in world coords) is resident
+bool chunksResident(int x, int y, int w, int h) {
+  int x1, y1, x2, y2;
+  chunkRange(x, y, w, h, 0, &x1, &y1, &x2, &y2);
+  for (int cy = y1; cy <= y2; ++cy)
+    for (int cx = x1; cx <= x2; ++cx)
+      if (chunks[cy * chunks_w + cx].state != CHUNK_RESIDENT)
+        return false;
+
+  return true;
+}
+
+// loader thread: reads chunks in from the level file (or memory) & writes changed chunks out to memory,
+// so the main thread never blocks on disk or on parsing
+int chunkLoader(void* data) {
+  while (true) {
+    SDL_SemWait(chunk_sem);
+
+    ChunkMsg msg;
+    while (popChunkMsg(&chunk_requests, &msg)) {
+      if (msg.type == CHUNK_QUIT)
+        return 0;
+
+      Chunk* chunk = &chunks[msg.chunk_ix];
+      Uint64 start = SDL_GetPerformanceCounter();
+      if (msg.type == CHUNK_LOAD) {
+        msg.len_entities = chunk->stored.len_entities;
+        msg.entities = readChunk(msg.chunk_ix);
+        traceEvent(TRACE_LOADER, "loadChunk", 'X', start, SDL_GetPerformanceCounter());
+      }
+      else if (msg.type == CHUNK_STORE) {
+        // unchanged chunks are still in the level file (or memory), so only changed ones need copying
+        if (msg.dirty) {
+          size_t stored_bytes = msg.merge ? chunk->stored.num_bytes : 0;
+          size_t num_bytes = stored_bytes;
+          for (int i = 0; i < msg.len_entities; ++i)
+            num_bytes += entityBytes(&msg.entities[i]);
+
+          void* buffer = malloc(num_bytes + 1);
+          void* buffer_ix = buffer;
+          if (stored_bytes) {
+            readChunkBytes(msg.chunk_ix, buffer_ix);
+            buffer_ix += stored_bytes;
+          }
+          for (int i = 0; i < msg.len_entities; ++i)
+            buffer_ix = writeEntity(buffer_ix, &msg.entities[i]);
+
+          free(chunk->data);
+          chunk->data = buffer;
+          chunk->stored.len_entities = (msg.merge ? chunk->stored.len_entities : 0) + msg.len_entities;
+          chunk->stored.num_bytes = num_bytes;
+        }
+
+        for (int i = 0; i < msg.len_entities; ++i)
+          freeEntity(&msg.entities[i]);
+        free(msg.entities);
+        msg.entities = NULL;
+        traceEvent(TRACE_LOADER, "storeChunk", 'X', start, SDL_GetPerformanceCounter());
+      }
+      else if (msg.type == CHUNK_SAVE) {
+        writeLevel(&msg);
+        traceEvent(TRACE_LOADER, "writeLevel", 'X', start, SDL_GetPerformanceCounter());
+        if (msg.copied_ix > -1)
+          freeEntity(&msg.entities[msg.copied_ix]);
+        free(msg.chunk_ixs);
+        msg.entities = NULL;
+        msg.chunk_ixs = NULL;
+      }
+
+      pushChunkMsg(&chunk_replies, msg);
+    }
+  }
+}
+
+// only call from the queue's (one) producer thread
+void pushChunkMsg(ChunkQueue* queue, ChunkMsg msg) {
+  int write_ix = SDL_AtomicGet(&queue->write_ix);
+  queue->msgs[write_ix & (CHUNK_QUEUE_LEN - 1)] = msg;
+  SDL_MemoryBarrierRelease(); // the message has to be visible before the new write_ix is
+  SDL_AtomicSet(&queue->write_ix, write_ix + 1);
+}
+
+// only call from the queue's (one) consumer thread
+bool popChunkMsg(ChunkQueue* queue, ChunkMsg* msg) {
+  int read_ix = SDL_AtomicGet(&queue->read_ix);
+  if (read_ix == SDL_AtomicGet(&queue->write_ix))
+    return false;
+
+  SDL_MemoryBarrierAcquire();
+  *msg = queue->msgs[read_ix & (CHUNK_QUEUE_LEN - 1)];
+  SDL_AtomicSet(&queue->read_ix, read_ix + 1);
+  return true;
+}
+
+void journalPath(char* path, int path_len, int generation) {
+  snprintf(path, path_len, "%s.journal%d", level_path, generation);
+}
+
+// a level's journals go from its generation up, 1 per save since, so the older ones stop at the first that's gone
+void removeJournalsBefore(int generation) {
+  char path[256];
+  for (int g = generation - 1; g >= 0; --g) {
+    journalPath(path, sizeof(path), g);
+    if (remove(path))
+      break;
+  }
+}
+
+void openJournal(int generation, char* mode) {
+  char path[256];
+  journalPath(path, sizeof(path), generation);
+  journal_file = fopen(path, mode);
+  if (!journal_file)
+    error("opening journal");
+
+  journal_gen = generation;
+}
+
+// append an editor operation to the journal
+// key is the entity as it was before the operation (replay finds it by x/y/w/h, like indexOfEntity())
+// & ent is the entity after it, for creates & vertex edits
+void journalOp(byte op, Entity* key, byte color_ix, Entity* ent) {
+  if (!journal_file) // (recording or replaying)
+    return;
+
+  fwrite(&op, sizeof(op), 1, journal_file);
+  fwrite(&key->x, sizeof(key->x), 1, journal_file);
+  fwrite(&key->y, sizeof(key->y), 1, journal_file);
+  fwrite(&key->w, sizeof(key->w), 1, journal_file);
+  fwrite(&key->h, sizeof(key->h), 1, journal_file);
+  journal_bytes += sizeof(op) + sizeof(key->x) + sizeof(key->y) + sizeof(key->w) + sizeof(key->h);
+
+  if (op == JOURNAL_RECOLOR) {
+    fwrite(&color_ix, sizeof(color_ix), 1, journal_file);
+    journal_bytes += sizeof(color_ix);
+  }
+  else if (op == JOURNAL_CREATE || op == JOURNAL_VERTEX) {
+    size_t num_bytes = entityBytes(ent);
+    byte buffer[num_bytes];
+    writeEntity(buffer, ent);
+    fwrite(buffer, num_bytes, 1, journal_file);
+    journal_bytes += num_bytes;
+  }
+
+  // flush so the edit survives the game crashing
+  if (!journal_holding)
+    flushJournal();
+}
+
+void flushJournal() {
+  if (!journal_file)
+    return;
+  fflush(journal_file);
+  if (ferror(journal_file))
+    error("writing journal");
+}
+
+// size of the entity record at the start of buffer, or 0 if it runs past num_bytes (e.g. a journal cut off by a crash)
+size_t entityRecordBytes(void* buffer, size_t num_bytes) {
+  if (num_bytes < sizeof(Entity))
+    return 0;
+
+  // only the counts & color indexes need checking: they size the copies & index arrays, the rest is just numbers
+  Entity entity;
+  memcpy(&entity, buffer, sizeof(Entity));
+  if (entity.len_shapes > MAX_SHAPES)
+    return 0;
+
+  size_t record_bytes = sizeof(Entity);
+  for (int j = 0; j < entity.len_shapes; ++j) {
+    Shape shape;
+    if (num_bytes - record_bytes < sizeof(Shape))
+      return 0;
+    memcpy(&shape, buffer + record_bytes, sizeof(Shape));
+    if (shape.len_vertices > MAX_VERTICES || shape.fill_color_ix > NO_COLOR || shape.stroke_color_ix > NO_COLOR ||
+      (shape.fill_color_ix == NO_COLOR && shape.stroke_color_ix == NO_COLOR))
+      return 0;
+
+    record_bytes += sizeof(Shape);
+    if (num_bytes - record_bytes < shape.len_vertices * sizeof(short) * 2)
+      return 0;
+    record_bytes += shape.len_vertices * sizeof(short) * 2;
+  }
+
+  return record_bytes;
+}
+
+// check that a chunk's bytes are exactly len_entities valid entity records, in one pass & before anything is allocated for them
+bool validChunk(void* buffer, size_t num_bytes, int len_entities) {
+  void* buffer_ix = buffer;
+  void* buffer_end = buffer + num_bytes;
+  for (int i = 0; i < len_entities; ++i) {
+    size_t record_bytes = entityRecordBytes(buffer_ix, buffer_end - buffer_ix);
+    if (!record_bytes)
+      return false;
+    buffer_ix += record_bytes;
+  }
+
+  return buffer_ix == buffer_end;
+}
+
+// check a level file's header before trusting its sizes (the chunk table comes right after it)
+bool validLevelHeader(LevelHeader* header) {
+  // keep the level small enough that chunk counts & pixel coordinates can't overflow an int
+  int max_level_px = 1 << 24;
+  if (memcmp(header->magic, "PLT4", 4) || header->level_w <= 0 || header->level_h <= 0 ||
+    header->level_w > max_level_px || header->level_h > max_level_px)
+    return false;
+
+  int px = CHUNK_TILES * grid_size;
+  return header->chunks_w == header->level_w / px + 1 && header->chunks_h == header->level_h / px + 1;
+}
+
+// check that a chunk table entry points inside the level file (file_len bytes, w/ the payloads starting at data_offset)
+bool validChunkEntry(ChunkEntry* entry, bool compressed, int64_t data_offset, int64_t file_len) {
+  if (entry->file_bytes < 0 || entry->num_bytes < 0 || entry->len_entities < 0)
+    return false;
+  if (entry->offset < data_offset || entry->offset > file_len || entry->file_bytes > file_len - entry->offset)
+    return false;
+
+  // every entity is at least an Entity record, & the codec can't expand data more than ~255x
+  if (entry->len_entities > entry->num_bytes / sizeof(Entity))
+    return false;
+  if (compressed)
+    return entry->num_bytes / 256 <= entry->file_bytes;
+  return entry->num_bytes == entry->file_bytes;
+}
+
+// apply a journal's operations to the level, paging in the chunks they touch (only used before the loader thread starts)
+// returns false if there's no such journal
+bool replayJournal(int generation) {
+  char path[256];
+  journalPath(path, sizeof(path), generation);
+  FILE* file = fopen(path, "rb"); // read binary
+  if (!file)
+    return false;
+
+  fseek(file, 0, SEEK_END);
+  size_t num_bytes = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  void* buffer = malloc(num_bytes ? num_bytes : 1);
+  if (!buffer)
+    error("allocating journal");
+  if (fread(buffer, 1, num_bytes, file) != num_bytes)
+    error("reading journal");
+  fclose(file);
+
+  void* buffer_ix = buffer;
+  void* buffer_end = buffer + num_bytes;
+  void* op_start = buffer; // (where the op being read starts, which is where a cut off one's dropped from)
+  while (true) {
+    op_start = buffer_ix;
+    Entity key = {};
+    byte op;
+    size_t key_bytes = sizeof(op) + sizeof(key.x) + sizeof(key.y) + sizeof(key.w) + sizeof(key.h);
+    if (buffer_end - buffer_ix < key_bytes)
+      break;
+
+    memcpy(&op, buffer_ix, sizeof(op));
+    buffer_ix += sizeof(op);
+    memcpy(&key.x, buffer_ix, sizeof(key.x));
+    buffer_ix += sizeof(key.x);
+    memcpy(&key.y, buffer_ix, sizeof(key.y));
+    buffer_ix += sizeof(key.y);
+    memcpy(&key.w, buffer_ix, sizeof(key.w));
+    buffer_ix += sizeof(key.w);
+    memcpy(&key.h, buffer_ix, sizeof(key.h));
+    buffer_ix += sizeof(key.h);
+
+    // the entity has to be resident to find it
+    int chunk_ix = chunkIndexAt(key.x, key.y);
+    if (chunks[chunk_ix].state == CHUNK_UNLOADED)
+      loadChunkNow(chunk_ix);
+    chunks[chunk_ix].dirty = true;
+    int entity_ix = op == JOURNAL_CREATE ? -1 : indexOfEntity(key.x, key.y, key.w, key.h);
+
+    if (op == JOURNAL_RECOLOR) {
+      if (buffer_end - buffer_ix < 1)
+        break;
+      if (entity_ix > -1)
+        memcpy(&entities[entity_ix].shapes[0].stroke_color_ix, buffer_ix, 1);
+      buffer_ix += 1;
+    }
+    else if (op == JOURNAL_CREATE || op == JOURNAL_VERTEX) {
+      size_t record_bytes = entityRecordBytes(buffer_ix, buffer_end - buffer_ix);
+      if (!record_bytes)
+        break;
+
+      if (op == JOURNAL_CREATE) {
+        reserveEntities(len_entities + 1);
+        entity_ix = len_entities++;
+      }
+      else if (entity_ix > -1) {
+        boxRemove(&box_index, entity_ix);
+        freeEntity(&entities[entity_ix]);
+      }
+
+      if (entity_ix > -1) {
+        readEntity(buffer_ix, &entities[entity_ix]);
+        boxInsert(&box_index, entity_ix);
+        chunks[chunkIndexAt(entities[entity_ix].x, entities[entity_ix].y)].dirty = true;
+      }
+      buffer_ix += record_bytes;
+    }
+    else if (op == JOURNAL_DELETE) {
+      if (entity_ix > -1)
+        deleteEntity(entity_ix);
+    }
+    else {
+      break;
+    }
+  }
+
+  // drop a cut off op at the end (all of it), so ops appended after it can be replayed
+  // (into a temp file that's renamed over the journal, like writeLevel() does, so a crash can't lose the rest of it)
+  if (op_start != buffer_end) {
+    printf("journal %d: dropping %ld bytes at the end (cut off?)\n", generation, (long)(buffer_end - op_start));
+    num_bytes = op_start - buffer;
+    char tmp_path[256 + 4];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    file = fopen(tmp_path, "wb"); // write binary
+    if (!file)
+      error("rewriting journal");
+    bool write_failed = fwrite(buffer, 1, num_bytes, file) != num_bytes;
+    if (fclose(file) || write_failed)
+      error("rewriting journal");
+#ifdef _WIN32
+    remove(path); // windows won't rename over an existing file
+#endif
+    if (rename(tmp_path, path))
+      error("renaming journal");
+  }
+
+  free(buffer);
+  journal_bytes += num_bytes;
+  return true;
+}
+
+// log an entity's creation (after it's made)
+void logCreate(Entity* ent) {
+  size_t num_bytes = entityBytes(ent);
+  byte record[num_bytes];
+  writeEntity(record, ent);
+  pushUndo(JOURNAL_CREATE, selected_shape == &ent->shapes[0] ? UNDO_SELECTS : 0, record, num_bytes, NULL, 0);
+}
+
+// log an entity's deletion (before it's deleted)
+void logDelete(Entity* ent) {
+  size_t num_bytes = entityBytes(ent);
+  byte record[num_bytes];
+  writeEntity(record, ent);
+  pushUndo(JOURNAL_DELETE, 0, record, num_bytes, NULL, 0);
+}
+
+// log a new color for the shape being drawn (after it's changed)
+void logRecolor(Entity* ent, byte old_color_ix) {
+  byte record[sizeof(ent->x) + sizeof(ent->y) + sizeof(ent->w) + sizeof(ent->h) + 2];
+  byte* colors = writeBox(record, ent);
+  colors[0] = old_color_ix;
+  colors[1] = ent->shapes[0].stroke_color_ix;
+  pushUndo(JOURNAL_RECOLOR, UNDO_SELECTED | UNDO_SELECTS, record, sizeof(record), NULL, 0);
+}
+
+// log an edit to the shape being drawn (after it's made), w/ the entity's record from before it
+void logVertex(void* before, int before_bytes, Entity* ent) {
+  size_t num_bytes = entityBytes(ent);
+  byte record[num_bytes];
+  writeEntity(record, ent);
+  pushUndo(JOURNAL_VERTEX, UNDO_SELECTED | (selected_shape ? UNDO_SELECTS : 0), before, before_bytes, record, num_bytes);
+}
+
+// an entity's box (x/y/w/h), for RECOLOR records, returns the position just after it
+void* writeBox(void* buffer_ix, Entity* ent) {
+  memcpy(buffer_ix, &ent->x, sizeof(ent->x));
+  buffer_ix += sizeof(ent->x);
+  memcpy(buffer_ix, &ent->y, sizeof(ent->y));
+  buffer_ix += sizeof(ent->y);
+  memcpy(buffer_ix, &ent->w, sizeof(ent->w));
+  buffer_ix += sizeof(ent->w);
+  memcpy(buffer_ix, &ent->h, sizeof(ent->h));
+  return buffer_ix + sizeof(ent->h);
+}
+
+void* readBox(void* buffer_ix, Entity* key) {
+  memcpy(&key->x, buffer_ix, sizeof(key->x));
+  buffer_ix += sizeof(key->x);
+  memcpy(&key->y, buffer_ix, sizeof(key->y));
+  buffer_ix += sizeof(key->y);
+  memcpy(&key->w, buffer_ix, sizeof(key->w));
+  buffer_ix += sizeof(key->w);
+  memcpy(&key->h, buffer_ix, sizeof(key->h));
+  return buffer_ix + sizeof(key->h);
+}
+
+// copy bytes into & out of the ring, wrapping around its end
+void undoWrite(long long offset, void* src, int num_bytes) {
+  int at = offset % undo_size;
+  int first = num_bytes < undo_size - at ? num_bytes : undo_size - at;
+  memcpy(undo_log + at, src, first);
+  memcpy(undo_log, (byte*)src + first, num_bytes - first);
+}
+
+void undoRead(long long offset, void* dst, int num_bytes) {
+  int at = offset % undo_size;
+  int first = num_bytes < undo_size - at ? num_bytes : undo_size - at;
+  memcpy(dst, undo_log + at, first);
+  memcpy((byte*)dst + first, undo_log, num_bytes - first);
+}
+
+// the size of the record at an offset (its n & the ints around it), or of the one that ends at it
+int undoRecordBytes(long long offset) {
+  int n;
+  undoRead(offset, &n, sizeof(n));
+  return n + 2 * sizeof(n);
+}
+
+int undoRecordBytesBefore(long long offset) {
+  int n;
+  undoRead(offset - sizeof(n), &n, sizeof(n));
+  return n + 2 * sizeof(n);
+}
+
+byte undoFlags(long long offset) {
+  byte flags;
+  undoRead(offset + sizeof(int) + 1, &flags, 1);
+  return flags;
+}
+
+// copy the body (op, flags & n - 2 bytes) of the record at an offset out of the ring
+byte* undoBody(long long offset, int* n_out) {
+  int n;
+  undoRead(offset, &n, sizeof(n));
+  *n_out = n;
+  if (n > max_undo_scratch) {
+    max_undo_scratch = n * 2;
+    undo_scratch = (byte*)realloc(undo_scratch, max_undo_scratch);
+    if (!undo_scratch)
+      error("allocating undo scratch");
+  }
+  undoRead(offset + sizeof(n), undo_scratch, n);
+  return undo_scratch;
+}
+
+// double the ring (up to UNDO_BYTES) instead of dropping anything, so a level that's barely edited doesn't pay for all of it
+void growUndo() {
+  int size = undo_size ? undo_size * 2 : UNDO_MIN_BYTES;
+  byte* grown = (byte*)malloc(size);
+  if (!grown)
+    error("growing undo log");
+  if (undo_head > undo_tail)
+    undoRead(undo_tail, grown, undo_head - undo_tail);
+  free(undo_log);
+  undo_log = grown;
+  undo_size = size;
+
+  // (the records start at the beginning of the new ring)
+  undo_cursor -= undo_tail;
+  undo_head -= undo_tail;
+  undo_txn -= undo_tail;
+  undo_tail = 0;
+}
+
+// append a record of a & b's bytes to the log (b can be NULL)
+// an edit after an undo means what was undone can't be redone, so it goes at the cursor
+void pushUndo(byte op, byte flags, void* a, int a_bytes, void* b, int b_bytes) {
+  if (undo_begin) {
+    undo_begin = false;
+    undo_dropped = false;
+    flags |= UNDO_FIRST;
+  }
+  else if (undo_dropped) {
+    return;
+  }
+  if (undo_cursor == undo_tail)
+    flags |= UNDO_FIRST; // (so the log always starts w/ a transaction)
+  undo_head = undo_cursor;
+  if (flags & UNDO_FIRST)
+    undo_txn = undo_head;
+
+  // make room by growing the ring, then by dropping the oldest transactions
+  int n = 2 + a_bytes + b_bytes;
+  int record_bytes = n + 2 * sizeof(n);
+  while (undo_head + record_bytes - undo_tail > undo_size && undo_size < UNDO_BYTES)
+    growUndo();
+  while (undo_head + record_bytes - undo_tail > undo_size) {
+    if (undo_tail == undo_txn) {
+      showNote("That's too big to undo");
+      undo_tail = undo_cursor = undo_head;
+      undo_dropped = true;
+      return;
+    }
+    do
+      undo_tail += undoRecordBytes(undo_tail);
+    while (undo_tail < undo_head && !(undoFlags(undo_tail) & UNDO_FIRST));
+  }
+
+  undoWrite(undo_head, &n, sizeof(n));
+  undoWrite(undo_head + sizeof(n), &op, 1);
+  undoWrite(undo_head + sizeof(n) + 1, &flags, 1);
+  undoWrite(undo_head + sizeof(n) + 2, a, a_bytes);
+  if (b_bytes)
+    undoWrite(undo_head + sizeof(n) + 2 + a_bytes, b, b_bytes);
+  undoWrite(undo_head + sizeof(n) + n, &n, sizeof(n));
+  undo_head += record_bytes;
+  undo_cursor = undo_head;
+}
+
+// undo the transaction before the cursor, or redo the one after it
+// the entities it touched are found by their boxes (like the journal's replay does), through an index of `entities`,
+// so a big stroke takes one pass over `entities` & not one per tile. Enemies that have moved since can't be found, so they're left
+void undoEdits(bool redo) {
+  undo_begin = true; // (the next edit starts its own transaction)
+  if (redo ? undo_cursor == undo_head : undo_cursor == undo_tail) {
+    showNote(redo ? "Nothing to redo" : "Nothing to undo");
+    return;
+  }
+
+  // back from the cursor to the transaction's first record, or forward to the next transaction's
+  long long start = undo_cursor;
+  long long end = undo_cursor;
+  if (redo) {
+    do
+      end += undoRecordBytes(end);
+    while (end < undo_head && !(undoFlags(end) & UNDO_FIRST));
+  }
+  else {
+    do
+      start -= undoRecordBytesBefore(start);
+    while (!(undoFlags(start) & UNDO_FIRST));
+  }
+
+  // everything it touched has to be resident, to find it (or put it back)
+  int len_records = 0;
+  for (long long offset = start; offset < end; offset += undoRecordBytes(offset)) {
+    int n;
+    byte* body = undoBody(offset, &n);
+    Entity key;
+    if (body[0] == JOURNAL_RECOLOR)
+      readBox(body + 2, &key);
+    else
+      memcpy(&key, body + 2, sizeof(Entity));
+    Entity after = key;
+    if (body[0] == JOURNAL_VERTEX)
+      memcpy(&after, body + 2 + entityRecordBytes(body + 2, n - 2), sizeof(Entity));
+
+    if (chunks[chunkIndexAt(key.x, key.y)].state != CHUNK_RESIDENT || chunks[chunkIndexAt(after.x, after.y)].state != CHUNK_RESIDENT) {
+      showNote(redo ? "Can't redo that until it's back on screen" : "Can't undo that until it's back on screen");
+      return;
+    }
+    len_records++;
+  }
+
+  journal_holding = true;
+  long long offset = redo ? start : end;
+  for (int r = 0; r < len_records; ++r) {
+    if (!redo)
+      offset -= undoRecordBytesBefore(offset);
+    int n;
+    byte* body = undoBody(offset, &n);
+    byte op = body[0];
+    byte flags = body[1];
+    void* record = body + 2;
+    if (redo)
+      offset += undoRecordBytes(offset);
+
+    Entity key;
+    int ix = -1;
+    if ((op == JOURNAL_CREATE && !redo) || (op == JOURNAL_DELETE && redo)) {
+      memcpy(&key, record, sizeof(Entity));
+      int found_ix = boxFind(&box_index, key.x, key.y, key.w, key.h);
+      if (found_ix > -1) {
+        journalOp(JOURNAL_DELETE, &entities[found_ix], 0, NULL);
+        deleteEntity(found_ix);
+      }
+    }
+    else if (op == JOURNAL_CREATE || op == JOURNAL_DELETE) {
+      ix = len_entities;
+      reserveEntities(len_entities + 1);
+      readEntity(record, &entities[ix]);
+      if (spawns) {
+        spawns[ix].x = entities[ix].x;
+        spawns[ix].y = entities[ix].y;
+      }
+      chunks[chunkIndexAt(entities[ix].x, entities[ix].y)].dirty = true;
+      world_version++;
+      boxInsert(&box_index, ix);
+      len_entities++;
+      journalOp(JOURNAL_CREATE, &entities[ix], 0, &entities[ix]);
+    }
+    else if (op == JOURNAL_VERTEX) {
+      void* before = record;
+      void* after = record + entityRecordBytes(record, n - 2);
+      memcpy(&key, redo ? before : after, sizeof(Entity));
+      ix = boxFind(&box_index, key.x, key.y, key.w, key.h);
+      if (ix > -1) {
+        Entity old = entities[ix];
+        boxRemove(&box_index, ix);
+        chunks[chunkIndexAt(old.x, old.y)].dirty = true;
+        releaseEntity(&entities[ix]);
+        readEntity(redo ? after : before, &entities[ix]);
+        if (spawns) {
+          spawns[ix].x = entities[ix].x;
+          spawns[ix].y = entities[ix].y;
+        }
+        chunks[chunkIndexAt(entities[ix].x, entities[ix].y)].dirty = true;
+        world_version++;
+        boxInsert(&box_index, ix);
+        journalOp(JOURNAL_VERTEX, &old, 0, &entities[ix]);
+      }
+    }
+    else if (op == JOURNAL_RECOLOR) {
+      byte* colors = readBox(record, &key);
+      ix = boxFind(&box_index, key.x, key.y, key.w, key.h);
+      if (ix > -1) {
+        // (recolored in a copy, since a save that's being written might be reading its shapes)
+        Entity* ent = &entities[ix];
+        byte copy[entityBytes(ent)];
+        writeEntity(copy, ent);
+        releaseEntity(ent);
+        readEntity(copy, ent);
+        ent->shapes[0].stroke_color_ix = colors[redo ? 1 : 0];
+        chunks[chunkIndexAt(ent->x, ent->y)].dirty = true;
+        world_version++;
+        journalOp(JOURNAL_RECOLOR, ent, ent->shapes[0].stroke_color_ix, NULL);
+      }
+    }
+
+    // drawing picks up where it was (the shape being drawn is always the last entity)
+    if (flags & (UNDO_SELECTED | UNDO_SELECTS)) {
+      bool selected = flags & (redo ? UNDO_SELECTS : UNDO_SELECTED);
+      selected_shape = selected && ix > -1 && ix == len_entities - 1 ? &entities[ix].shapes[0] : NULL;
+    }
+  }
+
+  journal_holding = false;
+  flushJournal();
+  undo_cursor = redo ? end : start;
+}
+
+// forget the undo history (it's the loaded level's)
+void freeUndo() {
+  free(undo_log);
+  free(undo_scratch);
+  undo_log = NULL;
+  undo_scratch = NULL;
+  undo_size = max_undo_scratch = 0;
+  undo_tail = undo_cursor = undo_head = undo_txn = 0;
+  undo_dropped = false;
+}
+
+// (tiles' coords are all multiples of grid_size, so the bits are mixed until the low ones are as good as the high ones)
+uint32_t boxHash(int x, int y, short w, short h) {
+  uint32_t hash = (uint32_t)x * 2654435761u ^ (uint32_t)y * 2246822519u ^ ((uint32_t)(unsigned short)w << 16 | (unsigned short)h) * 3266489917u;
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  return (hash ^ hash >> 16) & ~BOX_WIDE;
+}
+
+// rehash into num_slots slots
+void growBoxes(BoxIndex* index, int num_slots) {
+  int* old_slots = index->slots;
+  int old_num_slots = index->slots ? index->mask + 1 : 0;
+  index->slots = (int*)malloc(num_slots * sizeof(int));
+  if (!index->slots)
+    error("growing box index");
+  memset(index->slots, 0xff, num_slots * sizeof(int));
+  index->mask = num_slots - 1;
+
+  for (int i = 0; i < old_num_slots; ++i) {
+    if (old_slots[i] < 0)
+      continue;
+    int slot = index->hashes[old_slots[i]] & index->mask;
+    while (index->slots[slot] > -1)
+      slot = (slot + 1) & index->mask;
+    index->slots[slot] = old_slots[i];
+  }
+  free(old_slots);
+}
+
+void freeBoxes(BoxIndex* index) {
+  free(index->slots);
+  free(index->hashes);
+  free(index->wide);
+  index->slots = NULL;
+  index->hashes = NULL;
+  index->wide = NULL;
+  index->mask = index->len = index->max_hashes = 0;
+  index->wide_mask = index->len_wide = 0;
+}
+
+// file entity ix under its box (kept under half full, so probes stay short), & under its squares if it's a static wide box
+void boxInsert(BoxIndex* index, int ix) {
+  if (!index->slots || (index->len + 1) * 2 > index->mask + 1)
+    growBoxes(index, index->slots ? (index->mask + 1) * 2 : 64);
+  if (ix >= index->max_hashes) {
+    index->max_hashes = index->max_hashes ? index->max_hashes * 2 : 64;
+    while (index->max_hashes <= ix)
+      index->max_hashes *= 2;
+    index->hashes = (uint32_t*)realloc(index->hashes, index->max_hashes * sizeof(uint32_t));
+    if (!index->hashes)
+      error("growing box index");
+  }
+
+  Entity* ent = &entities[ix];
+  index->hashes[ix] = boxHash(ent->x, ent->y, ent->w, ent->h);
+  int slot = index->hashes[ix] & index->mask;
+  while (index->slots[slot] > -1)
+    slot = (slot + 1) & index->mask;
+  index->slots[slot] = ix;
+  index->len++;
+
+  if (!isDynamic(ent) && isWideBox(ent)) {
+    index->hashes[ix] |= BOX_WIDE;
+    int sx1, sy1, sx2, sy2;
+    wideRange(ent, &sx1, &sy1, &sx2, &sy2);
+    for (int sy = sy1; sy <= sy2; ++sy)
+      for (int sx = sx1; sx <= sx2; ++sx)
+        wideInsert(index, sx, sy, ix);
+  }
+}
+
+// shifts the entities probed past it back, so the probe for them doesn't stop at the hole it leaves
+// (entity ix still has the box it was inserted w/, or it's a mover that's filed by its hash)
+void boxRemove(BoxIndex* index, int ix) {
+  if (index->hashes[ix] & BOX_WIDE) {
+    int sx1, sy1, sx2, sy2;
+    wideRange(&entities[ix], &sx1, &sy1, &sx2, &sy2);
+    for (int sy = sy1; sy <= sy2; ++sy)
+      for (int sx = sx1; sx <= sx2; ++sx)
+        wideRemove(index, wideSlot(index, sx, sy, ix));
+  }
+
+  int slot = index->hashes[ix] & index->mask;
+  while (index->slots[slot] != ix)
+    slot = (slot + 1) & index->mask;
+
+  for (int next = (slot + 1) & index->mask; index->slots[next] > -1; next = (next + 1) & index->mask) {
+    int home = index->hashes[index->slots[next]] & index->mask;
+    // it can fill the hole unless its probe starts between the hole & where it is
+    if (((next - home) & index->mask) >= ((next - slot) & index->mask)) {
+      index->slots[slot] = index->slots[next];
+      slot = next;
+    }
+  }
+  index->slots[slot] = -1;
+  index->len--;
+}
+
+// an entity's about to be copied from from_ix to to_ix (like deleteEntity() does w/ the last one)
+void boxMove(BoxIndex* index, int from_ix, int to_ix) {
+  index->hashes[to_ix] = index->hashes[from_ix];
+  if (index->hashes[from_ix] & BOX_WIDE) {
+    int sx1, sy1, sx2, sy2;
+    wideRange(&entities[from_ix], &sx1, &sy1, &sx2, &sy2);
+    for (int sy = sy1; sy <= sy2; ++sy)
+      for (int sx = sx1; sx <= sx2; ++sx)
+        index->wide[wideSlot(index, sx, sy, from_ix) * 3 + 2] = to_ix;
+  }
+
+  int slot = index->hashes[from_ix] & index->mask;
+  while (index->slots[slot] != from_ix)
+    slot = (slot + 1) & index->mask;
+  index->slots[slot] = to_ix;
+}
+
+// file a mover again under the box it's moved to (if it's moved since it was filed)
+void boxRefile(BoxIndex* index, int ix) {
+  Entity* ent = &entities[ix];
+  if (!index->slots || (index->hashes[ix] & BOX_WIDE) || index->hashes[ix] == boxHash(ent->x, ent->y, ent->w, ent->h))
+    return;
+  boxRemove(index, ix);
+  boxInsert(index, ix);
+}
+
+// the last entity w/ a box (the one a scan of `entities` would end on), or -1
+int boxFind(BoxIndex* index, int x, int y, short w, short h) {
+  if (!index->slots)
+    return -1;
+
+  uint32_t hash = boxHash(x, y, w, h);
+  int found_ix = -1;
+  for (int slot = hash & index->mask; index->slots[slot] > -1; slot = (slot + 1) & index->mask) {
+    int ix = index->slots[slot];
+    if (ix > found_ix && (index->hashes[ix] & ~BOX_WIDE) == hash && entities[ix].x == x && entities[ix].y == y &&
+      entities[ix].w == w && entities[ix].h == h)
+      found_ix = ix;
+  }
+  return found_ix;
+}
+
+// filed under its squares too, if it's static (whose box only changes after it's removed, so this is the same then)
+bool isWideBox(Entity* ent) {
+  return (ent->w > grid_size || ent->h > grid_size) && !(ent->x % grid_size) && !(ent->y % grid_size) && !(ent->w % grid_size) &&
+    !(ent->h % grid_size);
+}
+
+// the (inclusive) range of squares a box overlaps (anything left of or above the level's in the first ones)
+void wideRange(Entity* ent, int* sx1, int* sy1, int* sx2, int* sy2) {
+  int square_px = WIDE_TILES * grid_size;
+  *sx1 = ent->x < 0 ? 0 : ent->x / square_px;
+  *sy1 = ent->y < 0 ? 0 : ent->y / square_px;
+  *sx2 = ent->x + ent->w - 1 < 0 ? 0 : (ent->x + ent->w - 1) / square_px;
+  *sy2 = ent->y + ent->h - 1 < 0 ? 0 : (ent->y + ent->h - 1) / square_px;
+}
+
+// rehash the squares into num_slots slots
+void growWide(BoxIndex* index, int num_slots) {
+  int* old_wide = index->wide;
+  int old_num_slots = index->wide ? index->wide_mask + 1 : 0;
+  index->wide = (int*)malloc(num_slots * 3 * sizeof(int));
+  if (!index->wide)
+    error("growing box index");
+  memset(index->wide, 0xff, num_slots * 3 * sizeof(int));
+  index->wide_mask = num_slots - 1;
+  index->len_wide = 0;
+
+  for (int i = 0; i < old_num_slots; ++i)
+    if (old_wide[i * 3 + 2] > -1)
+      wideInsert(index, old_wide[i * 3], old_wide[i * 3 + 1], old_wide[i * 3 + 2]);
+  free(old_wide);
+}
+
+void wideInsert(BoxIndex* index, int sx, int sy, int ix) {
+  if (!index->wide || (index->len_wide + 1) * 2 > index->wide_mask + 1)
+    growWide(index, index->wide ? (index->wide_mask + 1) * 2 : 64);
+
+  int slot = boxHash(sx, sy, 0, 0) & index->wide_mask;
+  while (index->wide[slot * 3 + 2] > -1)
+    slot = (slot + 1) & index->wide_mask;
+  index->wide[slot * 3] = sx;
+  index->wide[slot * 3 + 1] = sy;
+  index->wide[slot * 3 + 2] = ix;
+  index->len_wide++;
+}
+
+// where entity ix is filed under a square
+int wideSlot(BoxIndex* index, int sx, int sy, int ix) {
+  int slot = boxHash(sx, sy, 0, 0) & index->wide_mask;
+  while (index->wide[slot * 3 + 2] != ix || index->wide[slot * 3] != sx || index->wide[slot * 3 + 1] != sy)
+    slot = (slot + 1) & index->wide_mask;
+  return slot;
+}
+
+// (like boxRemove(), shifting the ones probed past it back)
+void wideRemove(BoxIndex* index, int slot) {
+  int* wide = index->wide;
+  int mask = index->wide_mask;
+  for (int next = (slot + 1) & mask; wide[next * 3 + 2] > -1; next = (next + 1) & mask) {
+    int home = boxHash(wide[next * 3], wide[next * 3 + 1], 0, 0) & mask;
+    if (((next - home) & mask) >= ((next - slot) & mask)) {
+      memcpy(&wide[slot * 3], &wide[next * 3], 3 * sizeof(int));
+      slot = next;
+    }
+  }
+  wide[slot * 3 + 2] = -1;
+  index->len_wide--;
+}
+
+// the last filled rectangle (see isRectTile()) whose box covers a box, or -1
+// (it overlaps the square the box's corner's in, so it's filed under that)
+int boxCovering(BoxIndex* index, int x, int y, short w, short h) {
+  if (!index->wide)
+    return -1;
+
+  int square_px = WIDE_TILES * grid_size;
+  int sx = x < 0 ? 0 : x / square_px;
+  int sy = y < 0 ? 0 : y / square_px;
+  int found_ix = -1;
+  for (int slot = boxHash(sx, sy, 0, 0) & index->wide_mask; index->wide[slot * 3 + 2] > -1; slot = (slot + 1) & index->wide_mask) {
+    int ix = index->wide[slot * 3 + 2];
+    Entity* ent = &entities[ix];
+    if (ix > found_ix && index->wide[slot * 3] == sx && index->wide[slot * 3 + 1] == sy && ent->x <= x && ent->y <= y &&
+      ent->x + ent->w >= x + w && ent->y + ent->h >= y + h && isRectTile(ent))
+      found_ix = ix;
+  }
+  return found_ix;
+}
+
+// whether an entity's just a filled rectangle the size of its box, like the tile tools make (& not a drawn shape)
+bool isRectTile(Entity* ent) {
+  if (ent->len_shapes != 1 || ent->shapes[0].len_vertices != 5 || ent->shapes[0].fill_color_ix == NO_COLOR)
+    return false;
+  short xs[5] = { 0, ent->w, ent->w, 0, 0 };
+  short ys[5] = { 0, 0, ent->h, ent->h, 0 };
+  for (int i = 0; i < 5; ++i) {
+    if (ent->shapes[0].x[i] != xs[i] || ent->shapes[0].y[i] != ys[i])
+      return false;
+  }
+  return true;
+}
+
+// level compression: a small LZ77 codec (LZ4-style sequences), so level files aren't mostly zeros & repeated records
+// each sequence is a token (literal length in the high 4 bits, match length - LZ_MIN_MATCH in the low 4 bits,
+// 15 meaning more length bytes follow), any extra literal length bytes, the literals, a 2-byte offset back to the match
+// & any extra match length bytes. The last sequence is just literals
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 14
+
+// the most lzCompress() can write for num_bytes of input
+size_t lzBound(size_t num_bytes) {
+  return num_bytes + num_bytes / 255 + 16;
+}
+
+uint32_t lzRead32(byte* p) {
+  uint32_t n;
+  memcpy(&n, p, sizeof(n));
+  return n;
+}
+
+uint64_t lzRead64(byte* p) {
+  uint64_t n;
+  memcpy(&n, p, sizeof(n));
+  return n;
+}
+
+byte* lzWriteLength(byte* op, size_t len) {
+  for (; len >= 255; len -= 255)
+    *op++ = 255;
+  *op++ = len;
+  return op;
+}
+
+// compress src into dst (which needs lzBound(src_len) bytes), returns the compressed size
+size_t lzCompress(byte* src, size_t src_len, byte* dst) {
+  uint32_t table[1 << LZ_HASH_BITS] = {}; // most recent position of each hashed 4-byte sequence
+  byte* ip = src;
+  byte* anchor = src; // start of the literals not yet written
+  byte* ip_end = src + src_len;
+  byte* op = dst;
+
+  // don't start matches too close to the end, so the 4 & 8-byte reads stay in bounds
+  byte* match_limit = src_len > 12 ? ip_end - 12 : src;
+  int misses = 0;
+  while (ip < match_limit) {
+    uint32_t seq = lzRead32(ip);
+    uint32_t hash = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+    byte* ref = src + table[hash];
+    table[hash] = ip - src;
+
+    if (ref >= ip || ip - ref > LZ_MAX_OFFSET || lzRead32(ref) != seq) {
+      // skip ahead faster through data that isn't compressing
+      ip += 1 + (misses++ >> 6);
+      continue;
+    }
+    misses = 0;
+
+    // extend the match 8 bytes at a time
+    size_t match_len = LZ_MIN_MATCH;
+    while (ip + match_len + 8 <= ip_end) {
+      uint64_t diff = lzRead64(ip + match_len) ^ lzRead64(ref + match_len);
+      if (diff) {
+        match_len += __builtin_ctzll(diff) / 8;
+        goto found_match_end;
+      }
+      match_len += 8;
+    }
+    while (ip + match_len < ip_end && ip[match_len] == ref[match_len])
+      match_len++;
+found_match_end:;
+
+    size_t lit_len = ip - anchor;
+    size_t extra_match = match_len - LZ_MIN_MATCH;
+    *op++ = (lit_len >= 15 ? 15 : lit_len) << 4 | (extra_match >= 15 ? 15 : extra_match);
+    if (lit_len >= 15)
+      op = lzWriteLength(op, lit_len - 15);
+    memcpy(op, anchor, lit_len);
+    op += lit_len;
+
+    size_t offset = ip - ref;
+    *op++ = offset & 0xff;
+    *op++ = offset >> 8;
+    if (extra_match >= 15)
+      op = lzWriteLength(op, extra_match - 15);
+
+    ip += match_len;
+    anchor = ip;
+  }
+
+  // last literals
+  size_t lit_len = ip_end - anchor;
+  *op++ = (lit_len >= 15 ? 15 : lit_len) << 4;
+  if (lit_len >= 15)
+    op = lzWriteLength(op, lit_len - 15);
+  memcpy(op, anchor, lit_len);
+  op += lit_len;
+
+  return op - dst;
+}
+
+// decompress src into dst, returns the decompressed size (or 0 if src is malformed or doesn't fit in dst_len)
+// every read & write is bounds checked, so it's safe on untrusted files
+size_t lzDecompress(byte* src, size_t src_len, byte* dst, size_t dst_len) {
+  byte* ip = src;
+  byte* ip_end = src + src_len;
+  byte* op = dst;
+  byte* op_end = dst + dst_len;
+
+  while (ip < ip_end) {
+    unsigned int token = *ip++;
+
+    size_t lit_len = token >> 4;
+    if (lit_len == 15) {
+      byte len_byte;
+      do {
+        if (ip >= ip_end)
+          return 0;
+        len_byte = *ip++;
+        lit_len += len_byte;
+      } while (len_byte == 255);
+    }
+    if (lit_len > ip_end - ip || lit_len > op_end - op)
+      return 0;
+
+    // short literal runs are the common case, so copy them w/ one fixed-size copy when there's room
+    if (lit_len <= 16 && ip_end - ip >= 16 && op_end - op >= 16)
+      memcpy(op, ip, 16);
+    else
+      memcpy(op, ip, lit_len);
+    ip += lit_len;
+    op += lit_len;
+
+    // the last sequence has no match
+    if (ip == ip_end)
+      break;
+
+    if (ip_end - ip < 2)
+      return 0;
+    size_t offset = ip[0] | ip[1] << 8;
+    ip += 2;
+    if (offset == 0 || offset > op - dst)
+      return 0;
+
+    size_t match_len = (token & 15) + LZ_MIN_MATCH;
+    if ((token & 15) == 15) {
+      byte len_byte;
+      do {
+        if (ip >= ip_end)
+          return 0;
+        len_byte = *ip++;
+        match_len += len_byte;
+      } while (len_byte == 255);
+    }
+    if (match_len > op_end - op)
+      return 0;
+
+    // the match can overlap what it's writing (that's how runs are encoded), so copy in steps no bigger than the offset
+    byte* match = op - offset;
+    if (offset == 1) {
+      memset(op, *match, match_len);
+    }
+    else if (offset >= 8 && op_end - op >= match_len + 8) {
+      for (size_t i = 0; i < match_len; i += 8)
+        memcpy(op + i, match + i, 8);
+    }
+    else {
+      for (size_t i = 0; i < match_len; ++i)
+        op[i] = match[i];
+    }
+    op += match_len;
+  }
+
+  return op - dst;
+}
+
+#if PROFILE
+int compareTicks(const void* a, const void* b) {
+  Uint64 ticks_a = *(Uint64*)a;
+  Uint64 ticks_b = *(Uint64*)b;
+  return ticks_a < ticks_b ? -1 : ticks_a > ticks_b;
+}
+
+// finish timing the last frame & start timing a new one
+void profileFrame() {
+  Uint64 now = SDL_GetPerformanceCounter();
+  if (profile_starts[PHASE_FRAME]) {
+    profile_times[profile_frame][PHASE_FRAME] = now - profile_starts[PHASE_FRAME];
+    profile_queries[profile_frame] = collide_queries;
+    profile_tests[profile_frame] = collide_tests;
+    traceEvent(TRACE_MAIN, phase_names[PHASE_FRAME], 'X', profile_starts[PHASE_FRAME], now);
+    profile_frame = (profile_frame + 1) % PROFILE_FRAMES;
+    if (profile_len_frames < PROFILE_FRAMES - 1)
+      profile_len_frames++;
+  }
+  memset(profile_times[profile_frame], 0, sizeof(profile_times[0]));
+  profile_latency[profile_frame] = -1;
+  profile_starts[PHASE_FRAME] = now;
+  collide_queries = 0;
+  collide_tests = 0;
+  if (show_heatmap)
+    heatFrame();
+
+  // sorting for the p99s isn't free, so only do it a few times a second (& only when they're shown)
+  if (!show_profiler || profile_frame % 16 || !profile_len_frames)
+    return;
+
+  float ms_per_tick = 1000.0 / SDL_GetPerformanceFrequency();
+  Uint64 sorted[PROFILE_FRAMES];
+  for (int phase = 0; phase < NUM_PHASES; ++phase) {
+    Uint64 total = 0;
+    for (int i = 1; i <= profile_len_frames; ++i) {
+      sorted[i - 1] = profile_times[(profile_frame - i + PROFILE_FRAMES) % PROFILE_FRAMES][phase];
+      total += sorted[i - 1];
+    }
+    qsort(sorted, profile_len_frames, sizeof(Uint64), compareTicks);
+
+    profile_stats[phase][0] = sorted[0] * ms_per_tick;
+    profile_stats[phase][1] = total * ms_per_tick / profile_len_frames;
+    profile_stats[phase][2] = sorted[profile_len_frames * 99 / 100] * ms_per_tick;
+    profile_stats[phase][3] = sorted[profile_len_frames - 1] * ms_per_tick;
+  }
+
+  memset(collide_stats, 0, sizeof(collide_stats));
+  for (int i = 1; i <= profile_len_frames; ++i) {
+    int frame = (profile_frame - i + PROFILE_FRAMES) % PROFILE_FRAMES;
+    collide_stats[0] += (float)profile_queries[frame] / profile_len_frames;
+    collide_stats[1] = fmaxf(collide_stats[1], profile_queries[frame]);
+    collide_stats[2] += (float)profile_tests[frame] / profile_len_frames;
+    collide_stats[3] = fmaxf(collide_stats[3], profile_tests[frame]);
+  }
+
+  memset(latency_counts, 0, sizeof(latency_counts));
+  memset(latency_stats, 0, sizeof(latency_stats));
+  float total_latency = 0;
+  for (int i = 1; i <= profile_len_frames; ++i) {
+    int ms = profile_latency[(profile_frame - i + PROFILE_FRAMES) % PROFILE_FRAMES];
+    if (ms < 0)
+      continue;
+    latency_counts[ms / LATENCY_BUCKET_MS < LATENCY_BUCKETS ? ms / LATENCY_BUCKET_MS : LATENCY_BUCKETS - 1]++;
+    latency_stats[0]++;
+    total_latency += ms;
+    latency_stats[2] = fmaxf(latency_stats[2], ms);
+  }
+  if (latency_stats[0])
+    latency_stats[1] = total_latency / latency_stats[0];
+}
+
+// w/ --threaded, phases only go to the trace (which has a buffer per thread)
+void profileStop(int phase) {
+  Uint64 now = SDL_GetPerformanceCounter();
+  if (!threaded)
+    profile_times[profile_frame][phase] += now - profile_starts[phase];
+  traceEvent(phase >= PHASE_CHUNKS && phase <= PHASE_ENEMIES ? trace_world : TRACE_MAIN, phase_names[phase], 'X', profile_starts[phase], now);
+}
+
+// a table of phase timings, a graph of recent frame times & a histogram of input to present latency
+void renderProfiler(SDL_Renderer* renderer) {
+  int x = 10;
+  int y = 30;
+  int graph_h = 100;
+  int hist_h = 40;
+  int num_lines = NUM_PHASES + 3 + show_heatmap;
+#ifdef TRACK_ALLOCS
+  num_lines++;
+#endif
+  boxColor(renderer, x - 5, y - 5, x + PROFILE_FRAMES * 2 + 5, y + num_lines * 10 + graph_h + hist_h + 30, 0xc0000000);
+
+  if (SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255) < 0)
+    error("setting profiler color");
+  render_text(renderer, "phase       min    avg    p99    max (ms)", x, y, 1);
+  for (int phase = 0; phase < NUM_PHASES; ++phase) {
+    char line[64];
+    snprintf(line, sizeof(line), "%-8s %6.2f %6.2f %6.2f %6.2f", phase_names[phase],
+      profile_stats[phase][0], profile_stats[phase][1], profile_stats[phase][2], profile_stats[phase][3]);
+    render_text(renderer, line, x, y + (phase + 1) * 10, 1);
+  }
+  int line_y = y + (NUM_PHASES + 1) * 10;
+  char line[64];
+  snprintf(line, sizeof(line), "collides/frame %.0f (max %.0f), box tests %.0f (max %.0f)",
+    collide_stats[0], collide_stats[1], collide_stats[2], collide_stats[3]);
+  render_text(renderer, line, x, line_y, 1);
+  line_y += 10;
+  snprintf(line, sizeof(line), "input to present %.1f ms avg, %.0f max (%.0f frames)", latency_stats[1], latency_stats[2], latency_stats[0]);
+  render_text(renderer, line, x, line_y, 1);
+  line_y += 10;
+  if (show_heatmap) {
+    int cell_px = HEAT_CELL_TILES * grid_size;
+    snprintf(line, sizeof(line), "hottest cell %d,%d: %d box tests in %d frames",
+      heat_hot_cell % heat_w * cell_px, heat_hot_cell / heat_w * cell_px, heat_hot_tests, HEAT_FRAMES);
+    render_text(renderer, line, x, line_y, 1);
+    line_y += 10;
+  }
+#ifdef TRACK_ALLOCS
+  snprintf(line, sizeof(line), "heap %lld KB live, %lld KB peak, %d allocs last frame",
+    alloc_live_bytes / 1024, alloc_peak_bytes / 1024, allocs_last_frame);
+  render_text(renderer, line, x, line_y, 1);
+#endif
+
+  // a bar per frame (oldest on the left), w/ lines at 60 & 30 fps
+  int graph_y = y + num_lines * 10 + graph_h + 5;
+  float px_per_ms = graph_h / 40.0;
+  float ms_per_tick = 1000.0 / SDL_GetPerformanceFrequency();
+  for (int i = profile_len_frames; i >= 1; --i) {
+    float ms = profile_times[(profile_frame - i + PROFILE_FRAMES) % PROFILE_FRAMES][PHASE_FRAME] * ms_per_tick;
+    int bar_h = ms * px_per_ms < graph_h ? ms * px_per_ms : graph_h;
+    int bar_x = x + (PROFILE_FRAMES - i) * 2;
+    boxColor(renderer, bar_x, graph_y - bar_h, bar_x + 1, graph_y, ms > 1000.0 / 30 ? 0xff3232ac : 0xff50e599);
+  }
+  hlineColor(renderer, x, x + PROFILE_FRAMES * 2, graph_y - 1000.0 / 60 * px_per_ms, 0xffffffff);
+  hlineColor(renderer, x, x + PROFILE_FRAMES * 2, graph_y - 1000.0 / 30 * px_per_ms, 0xff6357d9);
+
+  // a bar per latency bucket, scaled to the fullest, w/ each bucket's lowest ms under it
+  int hist_y = graph_y + 5 + hist_h;
+  int bucket_w = PROFILE_FRAMES * 2 / LATENCY_BUCKETS;
+  int max_count = 1;
+  for (int i = 0; i < LATENCY_BUCKETS; ++i)
+    if (latency_counts[i] > max_count)
+      max_count = latency_counts[i];
+  for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+    int bar_x = x + i * bucket_w;
+    if (latency_counts[i])
+      boxColor(renderer, bar_x, hist_y - latency_counts[i] * hist_h / max_count, bar_x + bucket_w - 2, hist_y, 0xffe5a050);
+    snprintf(line, sizeof(line), i == LATENCY_BUCKETS - 1 ? "%d+" : "%d", i * LATENCY_BUCKET_MS);
+    render_text(renderer, line, bar_x, hist_y + 5, 1);
+  }
+}
+
+// the cell a spot in the level falls in (spots off the level count toward the nearest cell)
+int heatCellAt(int x, int y) {
+  int cell_px = HEAT_CELL_TILES * grid_size;
+  int cx = x < 0 ? 0 : x / cell_px >= heat_w ? heat_w - 1 : x / cell_px;
+  int cy = y < 0 ? 0 : y / cell_px >= heat_h ? heat_h - 1 : y / cell_px;
+  return cy * heat_w + cx;
+}
+
+// the counts are only kept while the heatmap's up (the first time it comes up for a level, they're allocated to cover it)
+void toggleHeatmap() {
+  show_heatmap = !show_heatmap;
+  if (!show_heatmap || heat_queries[0])
+    return;
+
+  int cell_px = HEAT_CELL_TILES * grid_size;
+  heat_w = level_w / cell_px + 1;
+  heat_h = level_h / cell_px + 1;
+  for (int i = 0; i < 2; ++i) {
+    heat_queries[i] = (int*)calloc(heat_w * heat_h, sizeof(int));
+    heat_tests[i] = (int*)calloc(heat_w * heat_h, sizeof(int));
+    if (!heat_queries[i] || !heat_tests[i])
+      error("allocating heatmap");
+  }
+  heat_frames = 0;
+  heat_hot_tests = 0;
+}
+
+void freeHeatmap() {
+  for (int i = 0; i < 2; ++i) {
+    free(heat_queries[i]);
+    free(heat_tests[i]);
+    heat_queries[i] = NULL;
+    heat_tests[i] = NULL;
+  }
+  show_heatmap = false;
+}
+
+// count a collides() query into the heatmap: the same box tests it did (up to its hit), by where the entities tested are
+void heatQuery(int x, int y, int w, int h, int ix, byte type, int hit) {
+  heat_queries[heat_window][heatCellAt(x + w / 2, y + h / 2)]++;
+  int end = hit == -1 ? len_entities : hit + 1;
+  for (int i = 0; i < end; ++i)
+    if (i != ix && entities[i].flags & type)
+      heat_tests[heat_window][heatCellAt(entities[i].x, entities[i].y)]++;
+
+  if (len_heat_boxes < HEAT_MAX_BOXES && x < vp.x + vp.w && x + w > vp.x && y < vp.y + vp.h && y + h > vp.y) {
+    HeatBox box = { .x = x, .y = y, .w = w, .h = h, .hit = hit != -1 };
+    heat_boxes[len_heat_boxes++] = box;
+  }
+}
+
+// start a frame's counting, & a new window every HEAT_FRAMES frames
+void heatFrame() {
+  len_heat_boxes = 0;
+  if (++heat_frames < HEAT_FRAMES)
+    return;
+
+  heat_frames = 0;
+  heat_window = !heat_window;
+  memset(heat_queries[heat_window], 0, heat_w * heat_h * sizeof(int));
+  memset(heat_tests[heat_window], 0, heat_w * heat_h * sizeof(int));
+
+  int* tests = heat_tests[!heat_window];
+  heat_hot_cell = 0;
+  for (int i = 1; i < heat_w * heat_h; ++i)
+    if (tests[i] > tests[heat_hot_cell])
+      heat_hot_cell = i;
+  heat_hot_tests = tests[heat_hot_cell];
+}
+
+// shade the cells in the viewport from blue (few box tests) to red (the most of any cell in view), w/ their counts,
+// then outline this frame's query boxes (red for a hit) & the box each dynamic entity sweeps this tick
+void renderHeatmap(SDL_Renderer* renderer) {
+  int cell_px = HEAT_CELL_TILES * grid_size;
+  int* queries = heat_queries[!heat_window];
+  int* tests = heat_tests[!heat_window];
+  int cx1 = vp.x / cell_px;
+  int cy1 = vp.y / cell_px;
+  int cx2 = (vp.x + vp.w) / cell_px < heat_w ? (vp.x + vp.w) / cell_px : heat_w - 1;
+  int cy2 = (vp.y + vp.h) / cell_px < heat_h ? (vp.y + vp.h) / cell_px : heat_h - 1;
+
+  int max_tests = 1;
+  for (int cy = cy1; cy <= cy2; ++cy)
+    for (int cx = cx1; cx <= cx2; ++cx)
+      if (tests[cy * heat_w + cx] > max_tests)
+        max_tests = tests[cy * heat_w + cx];
+
+  if (SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255) < 0)
+    error("setting heatmap color");
+  for (int cy = cy1; cy <= cy2; ++cy) {
+    for (int cx = cx1; cx <= cx2; ++cx) {
+      int cell = cy * heat_w + cx;
+      if (!queries[cell] && !tests[cell])
+        continue;
+
+      int x = cx * cell_px - vp.x;
+      int y = cy * cell_px - vp.y;
+      float heat = (float)tests[cell] / max_tests;
+      Uint32 alpha = 0x30 + heat * 0x80;
+      Uint32 red = heat * 0xff;
+      Uint32 blue = 0xff - red;
+      boxColor(renderer, x, y, x + cell_px - 1, y + cell_px - 1, alpha << 24 | blue << 16 | red);
+
+      char line[32];
+      snprintf(line, sizeof(line), "%dq", queries[cell]);
+      render_text(renderer, line, x + 2, y + 2, 1);
+      snprintf(line, sizeof(line), "%dt", tests[cell]);
+      render_text(renderer, line, x + 2, y + 12, 1);
+    }
+  }
+
+  for (int i = 0; i < len_heat_boxes; ++i) {
+    HeatBox* box = &heat_boxes[i];
+    rectangleColor(renderer, box->x - vp.x, box->y - vp.y, box->x + box->w - vp.x - 1, box->y + box->h - vp.y - 1,
+      box->hit ? 0xff3232ac : 0xff36f2fb);
+  }
+
+  // swept paths: where each moving thing is, where it's headed this tick & the box covering both
+  for (int i = -1; i < len_entities; ++i) {
+    Entity* ent = i == -1 ? &world.player : &entities[i];
+    if (!(ent->dx || ent->dy) || ent->x > vp.x + vp.w || ent->x + ent->w < vp.x || ent->y > vp.y + vp.h || ent->y + ent->h < vp.y)
+      continue;
+
+    int x1 = (ent->dx < 0 ? ent->x + ent->dx : ent->x) - vp.x;
+    int y1 = (ent->dy < 0 ? ent->y + ent->dy : ent->y) - vp.y;
+    int x2 = x1 + ent->w + fabsf(ent->dx);
+    int y2 = y1 + ent->h + fabsf(ent->dy);
+    rectangleColor(renderer, x1, y1, x2, y2, 0xffe4cd5f);
+    int center_x = ent->x + ent->w / 2 - vp.x;
+    int center_y = ent->y + ent->h / 2 - vp.y;
+    lineColor(renderer, center_x, center_y, center_x + ent->dx, center_y + ent->dy, 0xffffffff);
+  }
+}
+#endif
+
+int traceWriter(void* data);
+
+// open the trace file & start the writer (before any other threads start, so they see `tracing`)
+void startTrace(char* path) {
+  trace_file = fopen(path, "w");
+  trace_rings = (TraceRing*)calloc(NUM_TRACE_THREADS, sizeof(TraceRing));
+  if (!trace_file || !trace_rings)
+    error("starting trace");
+
+  // the JSON array format, w/ names for the threads
+  fprintf(trace_file, "[\n"
+    "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"main\"}},\n"
+    "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"chunk loader\"}},\n"
+    "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"simulation\"}}",
+    TRACE_MAIN, TRACE_LOADER, TRACE_SIM);
+  trace_start = SDL_GetPerformanceCounter();
+  tracing = true;
+
+  trace_thread = SDL_CreateThread(traceWriter, "trace writer", NULL);
+  if (!trace_thread)
+    error("starting trace writer");
+}
+
+// write out the rest of the events & close the file (after the other threads have stopped)
+void stopTrace() {
+  SDL_AtomicSet(&trace_quit, 1);
+  SDL_WaitThread(trace_thread, NULL);
+
+  fprintf(trace_file, "\n]\n");
+  fclose(trace_file);
+  for (int i = 0; i < NUM_TRACE_THREADS; ++i)
+    if (trace_rings[i].num_dropped)
+      printf("trace: dropped %d events from thread %d (ring full)\n", trace_rings[i].num_dropped, i);
+  printf("trace: wrote %d events\n", trace_len_written);
+
+  tracing = false;
+  free(trace_rings);
+}
+
+// buffer an event on the calling thread's ring (dropping it if the writer has fallen behind, rather than stalling the thread)
+void traceEvent(int thread, char* name, char type, Uint64 start, Uint64 end) {
+  if (!tracing)
+    return;
+
+  TraceRing* ring = &trace_rings[thread];
+  int write_ix = SDL_AtomicGet(&ring->write_ix);
+  if (write_ix - SDL_AtomicGet(&ring->read_ix) == TRACE_RING_LEN) {
+    ring->num_dropped++;
+    return;
+  }
+
+  TraceEvent event = { .name = name, .type = type, .start = start, .end = end };
+  ring->events[write_ix & (TRACE_RING_LEN - 1)] = event;
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicSet(&ring->write_ix, write_ix + 1);
+}
+
+void traceInstant(int thread, char* name) {
+  if (!tracing)
+    return;
+
+  Uint64 now = SDL_GetPerformanceCounter();
+  traceEvent(thread, name, 'i', now, now);
+}
+
+// every so often, write out whatever's in the rings
+int traceWriter(void* data) {
+  double us_per_tick = 1e6 / SDL_GetPerformanceFrequency();
+  while (true) {
+    bool quit = SDL_AtomicGet(&trace_quit);
+
+    for (int i = 0; i < NUM_TRACE_THREADS; ++i) {
+      TraceRing* ring = &trace_rings[i];
+      int read_ix = SDL_AtomicGet(&ring->read_ix);
+      int write_ix = SDL_AtomicGet(&ring->write_ix);
+      SDL_MemoryBarrierAcquire();
+      for (; read_ix != write_ix; ++read_ix) {
+        TraceEvent* event = &ring->events[read_ix & (TRACE_RING_LEN - 1)];
+        double ts = (event->start - trace_start) * us_per_tick;
+        if (event->type == 'X')
+          fprintf(trace_file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+            event->name, i, ts, (event->end - event->start) * us_per_tick);
+        else
+          fprintf(trace_file, ",\n{\"name\": \"%s\", \"ph\": \"i\", \"s\": \"t\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f}",
+            event->name, i, ts);
+        trace_len_written++;
+      }
+      SDL_AtomicSet(&ring->read_ix, read_ix);
+    }
+
+    // the quit flag was read before draining, so everything written before it was set is out
+    if (quit)
+      return 0;
+    SDL_Delay(50);
+  }
+}
+
+// wait out the rest of the frame
+void paceFrame() {
+  Uint64 freq = SDL_GetPerformanceFrequency();
+  Uint64 period = pace_frame_ms * freq / 1000;
+  Uint64 now = SDL_GetPerformanceCounter();
+  if (!pace_deadline)
+    pace_deadline = now + period;
+
+  // a frame that overran its deadline by less than a frame just eats into the next one's budget, keeping the cadence,
+  // but one that overran it by more starts the schedule over (so a hitch isn't followed by a burst of catch-up frames)
+  if (now >= pace_deadline) {
+    pace_deadline = now - pace_deadline < period ? pace_deadline + period : now + period;
+    return;
+  }
+
+  Uint64 spin = pace_spin_ms * freq / 1000;
+  if (pace_deadline - now > spin)
+    SDL_Delay((pace_deadline - now - spin) * 1000 / freq);
+  while (SDL_GetPerformanceCounter() < pace_deadline)
+    ;
+  pace_deadline += period;
+}
+
+// the next batch from the front of a worker's own range, or -1
+int takeBatch(int worker) {
+  SDL_atomic_t* batches = &job_workers[worker].batches;
+  while (true) {
+    int range = SDL_AtomicGet(batches);
+    int first = range >> 16;
+    int end = range & 0xffff;
+    if (first >= end)
+      return -1;
+    if (SDL_AtomicCAS(batches, range, (first + 1) << 16 | end))
+      return first;
+  }
+}
+
+// move the back half of another worker's range (all of it, if it's down to one) into this worker's empty one
+bool stealBatches(int worker) {
+  for (int i = 1; i <= num_workers; ++i) {
+    int victim = (worker + i) % (num_workers + 1);
+    SDL_atomic_t* batches = &job_workers[victim].batches;
+    int range = SDL_AtomicGet(batches);
+    int first = range >> 16;
+    int end = range & 0xffff;
+    if (first >= end)
+      continue;
+    int mid = first + (end - first) / 2;
+    if (SDL_AtomicCAS(batches, range, first << 16 | mid)) {
+      SDL_AtomicSet(&job_workers[worker].batches, mid << 16 | end);
+      return true;
+    }
+    --i; // (it changed under us, look again)
+  }
+  return false;
+}
+
+void runBatches(int worker) {
+  while (true) {
+    int batch = takeBatch(worker);
+    if (batch < 0) {
+      if (!stealBatches(worker))
+        return;
+      continue;
+    }
+    int start = batch * job_batch_len;
+    int end = start + job_batch_len < job_len ? start + job_batch_len : job_len;
+    job_fn(start, end, worker, job_data);
+  }
+}
+
+int jobWorker(void* data) {
+  int worker = (int)(intptr_t)data;
+  while (true) {
+    SDL_SemWait(job_workers[worker].start);
+    if (SDL_AtomicGet(&job_quit))
+      return 0;
+    runBatches(worker);
+    SDL_SemPost(job_done);
+  }
+}
+
+void startJobs() {
+  if (num_workers < 0)
+    num_workers = SDL_GetCPUCount() - 1;
+  if (num_workers > MAX_WORKERS)
+    num_workers = MAX_WORKERS;
+  if (!num_workers)
+    return;
+
+  job_done = SDL_CreateSemaphore(0);
+  if (!job_done)
+    error("creating job sync");
+  for (int w = 1; w <= num_workers; ++w) {
+    job_workers[w].start = SDL_CreateSemaphore(0);
+    if (!job_workers[w].start)
+      error("creating job sync");
+    job_workers[w].thread = SDL_CreateThread(jobWorker, "worker", (void*)(intptr_t)w);
+    if (!job_workers[w].thread)
+      error("starting worker");
+  }
+}
+
+void stopJobs() {
+  if (!job_done)
+    return;
+
+  SDL_AtomicSet(&job_quit, 1);
+  for (int w = 1; w <= num_workers; ++w)
+    SDL_SemPost(job_workers[w].start);
+  for (int w = 1; w <= num_workers; ++w) {
+    SDL_WaitThread(job_workers[w].thread, NULL);
+    SDL_DestroySemaphore(job_workers[w].start);
+  }
+  SDL_DestroySemaphore(job_done);
+  memset(job_workers, 0, sizeof(job_workers));
+  job_done = NULL;
+  SDL_AtomicSet(&job_quit, 0);
+}
+
+// call fn on [start, end) batches of [0, len), spread across the workers & the calling thread, returning once they're all done
+// (fn gets which worker it's running on, 0 to num_workers, for anything it keeps per worker)
+void parallelFor(int len, int batch_len, JobFn fn, void* data) {
+  if (!job_done || len <= batch_len) {
+    if (len > 0)
+      fn(0, len, 0, data);
+    return;
+  }
+
+  if ((len + batch_len - 1) / batch_len > JOB_MAX_BATCHES)
+    batch_len = (len + JOB_MAX_BATCHES - 1) / JOB_MAX_BATCHES;
+  int num_batches = (len + batch_len - 1) / batch_len;
+  job_fn = fn;
+  job_data = data;
+  job_len = len;
+  job_batch_len = batch_len;
+
+  for (int w = 0; w <= num_workers; ++w) {
+    int first = num_batches * w / (num_workers + 1);
+    int end = num_batches * (w + 1) / (num_workers + 1);
+    SDL_AtomicSet(&job_workers[w].batches, first << 16 | end);
+  }
+  for (int w = 1; w <= num_workers; ++w)
+    SDL_SemPost(job_workers[w].start);
+  runBatches(0);
+  for (int w = 1; w <= num_workers; ++w)
+    SDL_SemWait(job_done);
+}
+
+// queue a change in an input's state (if the ring's full, its oldest event is folded into the held state early, losing only its tap)
+void pushInput(byte input, bool down, Uint32 timestamp) {
+  if (input_pushed[input] == down)
+    return;
+  input_pushed[input] = down;
+
+  SDL_AtomicLock(&input_lock);
+  if (input_write_ix - input_read_ix == INPUT_RING_LEN) {
+    InputEvent* oldest = &input_ring[input_read_ix++ % INPUT_RING_LEN];
+    input_held[oldest->input] = oldest->down;
+  }
+  InputEvent evt = { .timestamp = timestamp, .input = input, .down = down };
+  input_ring[input_write_ix++ % INPUT_RING_LEN] = evt;
+  SDL_AtomicUnlock(&input_lock);
+}
+
+// by scancode, so the arrows are where they are whatever the keyboard layout (key repeats don't change anything & aren't queued)
+void pushArrowKey(SDL_KeyboardEvent* key) {
+  bool down = key->type == SDL_KEYDOWN;
+  if (key->keysym.scancode == SDL_SCANCODE_LEFT)
+    pushInput(INPUT_LEFT, down, key->timestamp);
+  else if (key->keysym.scancode == SDL_SCANCODE_RIGHT)
+    pushInput(INPUT_RIGHT, down, key->timestamp);
+  else if (key->keysym.scancode == SDL_SCANCODE_UP)
+    pushInput(INPUT_UP, down, key->timestamp);
+  else if (key->keysym.scancode == SDL_SCANCODE_DOWN)
+    pushInput(INPUT_DOWN, down, key->timestamp);
+}
+
+// resolve the events queued since the last tick into this one's input: an input's pressed if it's held now or went down at any point
+// since (so taps shorter than a tick aren't lost), & this runs right before the tick's stepped, after everything else in the frame
+void latchInput() {
+  bool went_down[NUM_INPUTS] = {};
+  SDL_AtomicLock(&input_lock);
+  input_latched_any = input_read_ix != input_write_ix;
+  if (input_latched_any)
+    input_oldest = input_ring[input_read_ix % INPUT_RING_LEN].timestamp;
+  for (; input_read_ix != input_write_ix; ++input_read_ix) {
+    InputEvent* evt = &input_ring[input_read_ix % INPUT_RING_LEN];
+    input_held[evt->input] = evt->down;
+    if (evt->down)
+      went_down[evt->input] = true;
+  }
+  SDL_AtomicUnlock(&input_lock);
+
+  bool pressed[NUM_INPUTS];
+  for (int i = 0; i < NUM_INPUTS; ++i)
+    pressed[i] = input_held[i] || went_down[i];
+  world.left_pressed = pressed[INPUT_LEFT] || pressed[INPUT_PAD_LEFT];
+  world.right_pressed = pressed[INPUT_RIGHT] || pressed[INPUT_PAD_RIGHT];
+  world.up_pressed = pressed[INPUT_UP] || (pressed[INPUT_PAD_JUMP] && world.player.grav_y > 0);
+  world.down_pressed = pressed[INPUT_DOWN] || (pressed[INPUT_PAD_JUMP] && world.player.grav_y < 0);
+}
+
+// the sim thread (w/ --threaded): run the main thread's commands, then tick, publish & wait out the rest of the tick
+// (while paused, it sleeps until the main thread has something for it)
+int simLoop(void* data) {
+  bool was_paused = false;
+  while (!SDL_AtomicGet(&sim_quit)) {
+    SDL_LockMutex(sim_commands_lock);
+    CommandQueue* queue = &sim_commands[sim_commands_in];
+    sim_commands_in = !sim_commands_in;
+    SDL_UnlockMutex(sim_commands_lock);
+    for (int i = 0; i < queue->len; ++i)
+      runCommand(queue->actions[i]);
+    queue->len = 0;
+
+    if (SDL_AtomicGet(&sim_paused)) {
+      was_paused = true;
+      SDL_SemWait(sim_wake);
+      continue;
+    }
+
+    int stepped = tick();
+#if PROFILE
+    // (nothing reads these w/ the profiler off, so just keep them from overflowing)
+    collide_queries = 0;
+    collide_tests = 0;
+#endif
+    if (stepped < 0) {
+      SDL_AtomicSet(&sim_done, 1);
+      SDL_SemPost(snapshot_ready);
+      return 0;
+    }
+    if (!stepped) {
+      SDL_Delay(1);
+      continue;
+    }
+
+    // the first tick after a pause: its input waited out the pause, which isn't latency
+    if (was_paused) {
+      input_latched_any = false;
+      pace_deadline = 0;
+      was_paused = false;
+    }
+    publishSnapshot();
+    if (telemetry)
+      publishTelemetry(false);
+    paceFrame();
+  }
+  return 0;
+}
+
+// publish a snapshot of the world as it is (before the sim's started, too) & start the sim
+void startSim() {
+  snapshot_ready = SDL_CreateSemaphore(0);
+  sim_wake = SDL_CreateSemaphore(0);
+  sim_commands_lock = SDL_CreateMutex();
+  if (!snapshot_ready || !sim_wake || !sim_commands_lock)
+    error("creating sim sync");
+
+  for (int i = 0; i < 3; ++i)
+    snapshots[i].static_version = world_version - 1;
+  snapshot_back = 0;
+  snapshot_front = 1;
+  SDL_AtomicSet(&snapshot_newest, 2);
+  trace_world = TRACE_SIM;
+  publishSnapshot();
+
+  sim_thread = SDL_CreateThread(simLoop, "simulation", NULL);
+  if (!sim_thread)
+    error("starting sim");
+}
+
+void freeLayer(SnapshotLayer* layer) {
+  free(layer->ents);
+  free(layer->shapes);
+  free(layer->vertices);
+}
+
+// stop the sim (the main thread has the world to itself again)
+void stopSim() {
+  SDL_AtomicSet(&sim_quit, 1);
+  SDL_SemPost(sim_wake);
+  SDL_WaitThread(sim_thread, NULL);
+  trace_world = TRACE_MAIN;
+  threaded = false;
+
+  // commands that came in after the sim's last look still happen (& get recorded, along w/ the rest of the tick's edits)
+  CommandQueue* queue = &sim_commands[sim_commands_in];
+  for (int i = 0; i < queue->len; ++i)
+    runCommand(queue->actions[i]);
+
+  for (int i = 0; i < 3; ++i) {
+    freeLayer(&snapshots[i].statics);
+    freeLayer(&snapshots[i].dynamics);
+  }
+  memset(snapshots, 0, sizeof(snapshots));
+  for (int i = 0; i < 2; ++i)
+    free(sim_commands[i].actions);
+  memset(sim_commands, 0, sizeof(sim_commands));
+  SDL_DestroySemaphore(snapshot_ready);
+  SDL_DestroySemaphore(sim_wake);
+  SDL_DestroyMutex(sim_commands_lock);
+}
+
+bool inRect(Entity* ent, SDL_Rect* rect) {
+  return !(ent->x > rect->x + rect->w || ent->x + ent->w < rect->x || ent->y > rect->y + rect->h || ent->y + ent->h < rect->y);
+}
+
+// copy the static or dynamic entities in a region into a layer (counting first, so the layer only grows once)
+void copyLayer(SnapshotLayer* layer, SDL_Rect* rect, bool dynamic) {
+  int len_ents = 0;
+  int len_vertices = 0;
+  for (int i = 0; i < len_entities; ++i) {
+    if (isDynamic(&entities[i]) == dynamic && inRect(&entities[i], rect)) {
+      len_ents++;
+      len_vertices += entities[i].shapes[0].len_vertices * 2;
+    }
+  }
+  if (len_ents > layer->max_ents) {
+    layer->max_ents = len_ents * 2;
+    layer->ents = (Entity*)realloc(layer->ents, layer->max_ents * sizeof(Entity));
+    layer->shapes = (Shape*)realloc(layer->shapes, layer->max_ents * sizeof(Shape));
+  }
+  if (len_vertices > layer->max_vertices) {
+    layer->max_vertices = len_vertices * 2;
+    layer->vertices = (short*)realloc(layer->vertices, layer->max_vertices * sizeof(short));
+  }
+  if ((len_ents && (!layer->ents || !layer->shapes)) || (len_vertices && !layer->vertices))
+    error("copying snapshot");
+
+  layer->len_ents = 0;
+  short* vertices = layer->vertices;
+  for (int i = 0; i < len_entities; ++i) {
+    Entity* ent = &entities[i];
+    if (isDynamic(ent) != dynamic || !inRect(ent, rect))
+      continue;
+
+    Shape* shape = &layer->shapes[layer->len_ents];
+    *shape = ent->shapes[0];
+    shape->x = vertices;
+    shape->y = vertices + shape->len_vertices;
+    memcpy(shape->x, ent->shapes[0].x, shape->len_vertices * sizeof(short));
+    memcpy(shape->y, ent->shapes[0].y, shape->len_vertices * sizeof(short));
+    vertices += shape->len_vertices * 2;
+
+    Entity* copy = &layer->ents[layer->len_ents++];
+    *copy = *ent;
+    copy->shapes = shape;
+    copy->len_shapes = 1;
+    copy->max_shapes = 1;
+  }
+}
+
+// fill in the sim's snapshot & swap it in as the newest
+void publishSnapshot() {
+  Snapshot* snap = &snapshots[snapshot_back];
+  snap->player = world.player;
+  snap->vp = vp;
+  snap->won_game = world.won_game;
+  snap->note = note;
+  snap->note_time = note_time;
+  snap->fill_rect = fillPreview();
+  snap->input_latched_any = input_latched_any;
+  snap->input_oldest = input_oldest;
+
+  // the statics cover the viewport & half a viewport around it
+  SDL_Rect view = { vp.x, vp.y, vp.w, vp.h };
+  SDL_Rect* statics = &snap->static_rect;
+  if (snap->static_version != world_version || vp.x < statics->x || vp.y < statics->y ||
+    vp.x + vp.w > statics->x + statics->w || vp.y + vp.h > statics->y + statics->h) {
+    SDL_Rect around = { vp.x - vp.w / 2, vp.y - vp.h / 2, vp.w * 2, vp.h * 2 };
+    *statics = around;
+    snap->static_version = world_version;
+    copyLayer(&snap->statics, statics, false);
+  }
+  copyLayer(&snap->dynamics, &view, true);
+
+  // everything written above has to be visible before the swap is
+  SDL_MemoryBarrierRelease();
+  snapshot_back = SDL_AtomicSet(&snapshot_newest, snapshot_back | SNAPSHOT_FRESH) & ~SNAPSHOT_FRESH;
+  SDL_SemPost(snapshot_ready);
+}
+
+// the newest snapshot (fresh is whether it's one the renderer hasn't had before)
+Snapshot* takeSnapshot(bool* fresh) {
+  *fresh = SDL_AtomicGet(&snapshot_newest) & SNAPSHOT_FRESH;
+  if (*fresh) {
+    snapshot_front = SDL_AtomicSet(&snapshot_newest, snapshot_front) & ~SNAPSHOT_FRESH;
+    SDL_MemoryBarrierAcquire();
+  }
+  return &snapshots[snapshot_front];
+}
+
+// sleep until the sim publishes again (or a bit, so events still get handled if it's waiting on chunks)
+void waitForSnapshot() {
+  SDL_SemWaitTimeout(snapshot_ready, 100);
+  while (!SDL_SemTryWait(snapshot_ready))
+    ;
+}
+
+// the block has room for a fixed number of phases
+#if NUM_PHASES > TELEMETRY_PHASES
+#error "raise TELEMETRY_PHASES (& TELEMETRY_VERSION) in telemetry.h to fit every phase"
+#endif
+
+// create the shared memory segment & fill in the parts of the block that don't change
+void startTelemetry(char* name) {
+#ifdef _WIN32
+  printf("telemetry uses POSIX shared memory, which this build doesn't have\n");
+#else
+  int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+  if (fd < 0 || ftruncate(fd, sizeof(Telemetry)) < 0)
+    error("creating telemetry shared memory");
+  telemetry = (Telemetry*)mmap(NULL, sizeof(Telemetry), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (telemetry == MAP_FAILED)
+    error("mapping telemetry shared memory");
+  telemetry_name = name;
+
+  memset(telemetry, 0, sizeof(Telemetry));
+  telemetry->version = TELEMETRY_VERSION;
+  telemetry->pid = getpid();
+  telemetry->num_phases = NUM_PHASES;
+#if PROFILE
+  if (!threaded)
+    telemetry->flags |= TELEMETRY_PROFILE;
+  for (int phase = 0; phase < NUM_PHASES; ++phase)
+    snprintf(telemetry->phase_names[phase], sizeof(telemetry->phase_names[0]), "%s", phase_names[phase]);
+#endif
+#ifdef TRACK_ALLOCS
+  telemetry->flags |= TELEMETRY_ALLOCS;
+#endif
+
+  // readers check the magic last, so they never see a half-filled block
+  SDL_MemoryBarrierRelease();
+  telemetry->magic = TELEMETRY_MAGIC;
+#endif
+}
+
+// the stats of the frame that just finished (called at the start of the next one)
+void publishTelemetry(bool paused) {
+  // odd while writing: a reader that sees an odd seq, or a different one after copying, tries again
+  SDL_AtomicIncRef(&telemetry->seq);
+  SDL_MemoryBarrierRelease();
+
+  Uint64 now = SDL_GetPerformanceCounter();
+  float ms_per_tick = 1000.0 / SDL_GetPerformanceFrequency();
+  telemetry->frame++;
+  telemetry->frame_ms = telemetry_frame_start ? (now - telemetry_frame_start) * ms_per_tick : 0;
+  telemetry_frame_start = now;
+#if PROFILE
+  int last_frame = (profile_frame - 1 + PROFILE_FRAMES) % PROFILE_FRAMES;
+  for (int phase = 0; phase < NUM_PHASES && !threaded; ++phase)
+    telemetry->phase_ms[phase] = profile_times[last_frame][phase] * ms_per_tick;
+  telemetry->collide_queries = profile_queries[last_frame];
+  telemetry->collide_tests = profile_tests[last_frame];
+#endif
+  telemetry->len_entities = len_entities;
+  telemetry->resident_chunks = len_live_chunks;
+  telemetry->chunk_msgs_out = chunk_msgs_out;
+  telemetry->player_x = world.player.x;
+  telemetry->player_y = world.player.y;
+  telemetry->paused = paused;
+#ifdef TRACK_ALLOCS
+  telemetry->allocs_last_frame = allocs_last_frame;
+  telemetry->heap_live_bytes = alloc_live_bytes;
+  telemetry->heap_peak_bytes = alloc_peak_bytes;
+#endif
+
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicIncRef(&telemetry->seq);
+}
+
+// readers that already have the segment mapped keep it (& see the game's pid is gone), new ones won't find it
+void stopTelemetry() {
+#ifndef _WIN32
+  munmap(telemetry, sizeof(Telemetry));
+  shm_unlink(telemetry_name);
+  telemetry = NULL;
+#endif
+}
+
+// FNV-1a, for the level & world hashes in recordings
+#define HASH_START 0xcbf29ce484222325ULL
+
+uint64_t hashBytes(uint64_t hash, void* data, size_t num_bytes) {
+  byte* bytes = (byte*)data;
+  for (size_t i = 0; i < num_bytes; ++i) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// hash a file's contents into hash, or return false if it doesn't exist
+bool hashFile(uint64_t* hash, char* path) {
+  FILE* file = fopen(path, "rb"); // read binary
+  if (!file)
+    return false;
+
+  byte buffer[1 << 16];
+  size_t num_bytes;
+  while ((num_bytes = fread(buffer, 1, sizeof(buffer), file)))
+    *hash = hashBytes(*hash, buffer, num_bytes);
+  fclose(file);
+  return true;
+}
+
+// hash of the level file & the journals loaded on top of it
+uint64_t levelHash() {
+  uint64_t hash = HASH_START;
+  LevelHeader header = {};
+  FILE* file = fopen(level_path, "rb"); // read binary
+  if (file) {
+    if (fread(&header, sizeof(header), 1, file) != 1)
+      error("reading level file header");
+    fclose(file);
+  }
+  hashFile(&hash, level_path);
+
+  char path[256];
+  for (int generation = header.generation; ; ++generation) {
+    journalPath(path, sizeof(path), generation);
+    if (!hashFile(&hash, path))
+      break;
+  }
+  return hash;
+}
+
+uint64_t hashEntity(uint64_t hash, Entity* ent) {
+  hash = hashBytes(hash, &ent->flags, sizeof(ent->flags));
+  hash = hashBytes(hash, &ent->x, sizeof(ent->x));
+  hash = hashBytes(hash, &ent->y, sizeof(ent->y));
+  hash = hashBytes(hash, &ent->w, sizeof(ent->w));
+  hash = hashBytes(hash, &ent->h, sizeof(ent->h));
+  hash = hashBytes(hash, &ent->dx, sizeof(ent->dx));
+  hash = hashBytes(hash, &ent->dy, sizeof(ent->dy));
+  hash = hashBytes(hash, &ent->grav_y, sizeof(ent->grav_y));
+  for (int j = 0; j < ent->len_shapes; ++j) {
+    Shape* shape = &ent->shapes[j];
+    hash = hashBytes(hash, &shape->fill_color_ix, sizeof(shape->fill_color_ix));
+    hash = hashBytes(hash, &shape->stroke_color_ix, sizeof(shape->stroke_color_ix));
+    hash = hashBytes(hash, &shape->len_vertices, sizeof(shape->len_vertices));
+    hash = hashBytes(hash, shape->x, shape->len_vertices * sizeof(short));
+    hash = hashBytes(hash, shape->y, shape->len_vertices * sizeof(short));
+  }
+  return hash;
+}
+
+// hash of everything the simulation changes (the player, the resident entities & the checkpoint)
+uint64_t worldHash() {
+  uint64_t hash = hashEntity(HASH_START, &world.player);
+  hash = hashBytes(hash, &world.start_x, sizeof(world.start_x));
+  hash = hashBytes(hash, &world.start_y, sizeof(world.start_y));
+  hash = hashBytes(hash, &world.start_grav, sizeof(world.start_grav));
+  hash = hashBytes(hash, &len_entities, sizeof(len_entities));
+  for (int i = 0; i < len_entities; ++i)
+    hash = hashEntity(hash, &entities[i]);
+  return hash;
+}
+
+// wait for the loader to answer everything, so chunks arrive in the same tick every time (recording & replaying)
+void settleChunks() {
+  while (chunk_msgs_out) {
+    SDL_Delay(1);
+    receiveChunks();
+  }
+}
+
+void startRecording(char* path, uint32_t seed) {
+  rec_file = fopen(path, "wb"); // write binary
+  if (!rec_file)
+    error("opening recording");
+
+  RecordingHeader header = {
+    .magic = {'P', 'L', 'R', '1'},
+    .seed = seed,
+    .vp_w = vp.w,
+    .vp_h = vp.h,
+    .level_hash = levelHash()
+  };
+  rec_header = header;
+  if (fwrite(&header, sizeof(header), 1, rec_file) != 1)
+    error("writing recording");
+
+  rec_vp_w = vp.w;
+  rec_vp_h = vp.h;
+  printf("recording to %s (edits won't be saved)\n", path);
+}
+
+void startReplay(char* path) {
+  rec_file = fopen(path, "rb"); // read binary
+  if (!rec_file || fread(&rec_header, sizeof(rec_header), 1, rec_file) != 1 || memcmp(rec_header.magic, "PLR1", 4) ||
+    rec_header.vp_w <= 0 || rec_header.vp_h <= 0 || rec_header.vp_w > 1 << 16 || rec_header.vp_h > 1 << 16)
+    error("reading recording");
+
+  replaying = true;
+  rec_run = 0;
+  rec_len_ticks = 0;
+  rec_x = 0;
+  rec_y = 0;
+  rec_done = false;
+}
+
+void recWriteVarint(uint32_t n) {
+  while (n >= 0x80) {
+    fputc(n | 0x80, rec_file);
+    n >>= 7;
+  }
+  fputc(n, rec_file);
+}
+
+byte recReadByte() {
+  int c = fgetc(rec_file);
+  if (c == EOF)
+    error("reading recording (cut off?)");
+  return c;
+}
+
+uint32_t recReadVarint() {
+  uint32_t n = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    byte b = recReadByte();
+    n |= (uint32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return n;
+  }
+  error("reading recording (bad varint)");
+  return 0;
+}
+
+// (zigzag, so small negative deltas are small varints too)
+void recWriteDelta(int delta) {
+  recWriteVarint(((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+}
+
+int recReadDelta() {
+  uint32_t n = recReadVarint();
+  return (int)(n >> 1) ^ -(int)(n & 1);
+}
+
+// write out the run of ticks w/ the same input that's been building up
+void recordRun() {
+  if (!rec_run)
+    return;
+
+  fputc(rec_input | (rec_run > 1 ? TICK_RUN : 0), rec_file);
+  if (rec_run > 1)
+    recWriteVarint(rec_run - 1);
+  rec_run = 0;
+}
+
+void recordEdits() {
+  recWriteVarint(len_rec_edits);
+  for (int i = 0; i < len_rec_edits; ++i) {
+    EditAction* action = &rec_edits[i];
+    fputc(action->type, rec_file);
+    if (action->type == EDIT_PRESS || action->type == EDIT_DRAG) {
+      recWriteDelta(action->x - rec_x);
+      recWriteDelta(action->y - rec_y);
+      rec_x = action->x;
+      rec_y = action->y;
+    }
+    else if (action->type == EDIT_COLOR || action->type == EDIT_MODE || action->type == EDIT_TOOL) {
+      fputc(action->x, rec_file);
+    }
+  }
+  len_rec_edits = 0;
+}
+
+void replayEdits() {
+  int len_edits = recReadVarint();
+  for (int i = 0; i < len_edits; ++i) {
+    EditAction action = { .type = recReadByte() };
+    if (action.type == EDIT_PRESS || action.type == EDIT_DRAG) {
+      rec_x += recReadDelta();
+      rec_y += recReadDelta();
+      action.x = rec_x;
+      action.y = rec_y;
+    }
+    else if (action.type == EDIT_COLOR || action.type == EDIT_MODE || action.type == EDIT_TOOL) {
+      action.x = recReadByte();
+      if (action.type == EDIT_COLOR && action.x > NO_COLOR)
+        error("reading recording (bad color)");
+    }
+    applyEdit(action);
+  }
+}
+
+// record this tick's input: most ticks just extend the current run, the rest get their own record
+void recordTick() {
+  byte input = (world.left_pressed ? TICK_LEFT : 0) | (world.right_pressed ? TICK_RIGHT : 0) | (world.up_pressed ? TICK_UP : 0) | (world.down_pressed ? TICK_DOWN : 0);
+  bool resized = vp.w != rec_vp_w || vp.h != rec_vp_h;
+  rec_len_ticks++;
+
+  if (!resized && !len_rec_edits) {
+    if (rec_run && input != rec_input)
+      recordRun();
+    rec_input = input;
+    rec_run++;
+    return;
+  }
+
+  recordRun();
+  fputc(input | (resized ? TICK_VIEWPORT : 0) | (len_rec_edits ? TICK_EDITS : 0), rec_file);
+  if (resized) {
+    recWriteVarint(vp.w);
+    recWriteVarint(vp.h);
+    rec_vp_w = vp.w;
+    rec_vp_h = vp.h;
+  }
+  if (len_rec_edits)
+    recordEdits();
+}
+
+// set up this tick's input from the recording, or return false if it's over
+bool replayTick() {
+  if (!rec_len_ticks)
+    rec_start = SDL_GetPerformanceCounter();
+
+  if (!rec_run) {
+    byte flags = recReadByte();
+    if (flags & TICK_END) {
+      if (flags & TICK_EDITS)
+        replayEdits();
+      if (fread(&rec_world_hash, sizeof(rec_world_hash), 1, rec_file) != 1)
+        error("reading recording (cut off?)");
+      rec_done = true;
+      return false;
+    }
+
+    rec_input = flags & TICK_INPUT;
+    rec_run = 1;
+    if (flags & TICK_RUN)
+      rec_run += recReadVarint();
+    if (flags & TICK_VIEWPORT) {
+      vp.w = recReadVarint();
+      vp.h = recReadVarint();
+    }
+    if (flags & TICK_EDITS)
+      replayEdits();
+  }
+
+  rec_run--;
+  world.left_pressed = rec_input & TICK_LEFT;
+  world.right_pressed = rec_input & TICK_RIGHT;
+  world.up_pressed = rec_input & TICK_UP;
+  world.down_pressed = rec_input & TICK_DOWN;
+  rec_len_ticks++;
+  return true;
+}
+
+// end the recording w/ a hash of where the world ended up (& any edits made since the last tick)
+void stopRecording() {
+  recordRun();
+  fputc(TICK_END | (len_rec_edits ? TICK_EDITS : 0), rec_file);
+  if (len_rec_edits)
+    recordEdits();
+  uint64_t hash = worldHash();
+  fwrite(&hash, sizeof(hash), 1, rec_file);
+  if (ferror(rec_file))
+    error("writing recording");
+  fclose(rec_file);
+  free(rec_edits);
+  printf("recorded %d ticks\n", rec_len_ticks);
+}
+
+// report how fast the replay ran & whether it ended up where the recording did
+bool stopReplay() {
+  double secs = (SDL_GetPerformanceCounter() - rec_start) / (double)SDL_GetPerformanceFrequency();
+  printf("replay: %d ticks in %.3f s (%.0f ticks/sec)\n", rec_len_ticks, secs, secs > 0 ? rec_len_ticks / secs : 0);
+  fclose(rec_file);
+
+  if (!rec_done) {
+    printf("replay: stopped before the end\n");
+    return true;
+  }
+
+  uint64_t hash = worldHash();
+  if (hash != rec_world_hash) {
+    printf("replay: the world doesn't match the recording (hash %016llx, recorded %016llx)\n",
+      (unsigned long long)hash, (unsigned long long)rec_world_hash);
+    return false;
+  }
+  printf("replay: the world matches the recording\n");
+  return true;
+}
+
+#ifdef TRACK_ALLOCS
+// the real allocator is called as (malloc)() etc., since allocs.h makes plain malloc() call these
+
+AllocSite* allocSite(char* file, int line) {
+  // open addressing on the file name's address & the line (the same file name always has the same address w/in a file)
+  unsigned int hash = ((uintptr_t)file * 31 + line) * 2654435761u;
+  for (int i = 0; i < ALLOC_SITES; ++i) {
+    AllocSite* site = &alloc_sites[(hash + i) & (ALLOC_SITES - 1)];
+    if (site->file == file && site->line == line)
+      return site;
+    if (!site->file) {
+      site->file = file;
+      site->line = line;
+      return site;
+    }
+  }
+  error("tracking allocations (too many call sites)");
+  return NULL;
+}
+
+// count an allocation (or a free, w/ negative bytes) against its call site, call w/ alloc_lock held
+void countAlloc(AllocSite* site, long long num_bytes, bool is_alloc) {
+  site->live_bytes += num_bytes;
+  alloc_live_bytes += num_bytes;
+  if (alloc_live_bytes > alloc_peak_bytes)
+    alloc_peak_bytes = alloc_live_bytes;
+  if (!is_alloc)
+    return;
+
+  site->num_allocs++;
+  site->num_bytes += num_bytes;
+  if (alloc_in_frame_loop && SDL_ThreadID() == alloc_main_thread) {
+    allocs_this_frame++;
+    if (!site->flagged) {
+      site->flagged = true;
+      printf("alloc: %s:%d allocated %lld bytes in the frame loop\n", site->file, site->line, num_bytes);
+    }
+  }
+}
+
+void* trackedMalloc(size_t num_bytes, char* file, int line) {
+  byte* block = (byte*)(malloc)(num_bytes + ALLOC_HEADER);
+  if (!block)
+    return NULL;
+
+  SDL_AtomicLock(&alloc_lock);
+  AllocSite* site = allocSite(file, line);
+  countAlloc(site, num_bytes, true);
+  SDL_AtomicUnlock(&alloc_lock);
+
+  memcpy(block, &num_bytes, sizeof(num_bytes));
+  memcpy(block + sizeof(num_bytes), &site, sizeof(site));
+  return block + ALLOC_HEADER;
+}
+
+void* trackedCalloc(size_t num, size_t size, char* file, int line) {
+  void* ptr = trackedMalloc(num * size, file, line);
+  if (ptr)
+    memset(ptr, 0, num * size);
+  return ptr;
+}
+
+void* trackedRealloc(void* ptr, size_t num_bytes, char* file, int line) {
+  if (!ptr)
+    return trackedMalloc(num_bytes, file, line);
+
+  byte* block = (byte*)ptr - ALLOC_HEADER;
+  size_t old_bytes;
+  AllocSite* old_site;
+  memcpy(&old_bytes, block, sizeof(old_bytes));
+  memcpy(&old_site, block + sizeof(old_bytes), sizeof(old_site));
+
+  block = (byte*)(realloc)(block, num_bytes + ALLOC_HEADER);
+  if (!block)
+    return NULL;
+
+  // the block now belongs to the realloc's call site
+  SDL_AtomicLock(&alloc_lock);
+  countAlloc(old_site, -(long long)old_bytes, false);
+  AllocSite* site = allocSite(file, line);
+  countAlloc(site, num_bytes, true);
+  SDL_AtomicUnlock(&alloc_lock);
+
+  memcpy(block, &num_bytes, sizeof(num_bytes));
+  memcpy(block + sizeof(num_bytes), &site, sizeof(site));
+  return block + ALLOC_HEADER;
+}
+
+void trackedFree(void* ptr) {
+  if (!ptr)
+    return;
+
+  byte* block = (byte*)ptr - ALLOC_HEADER;
+  size_t num_bytes;
+  AllocSite* site;
+  memcpy(&num_bytes, block, sizeof(num_bytes));
+  memcpy(&site, block + sizeof(num_bytes), sizeof(site));
+
+  SDL_AtomicLock(&alloc_lock);
+  countAlloc(site, -(long long)num_bytes, false);
+  SDL_AtomicUnlock(&alloc_lock);
+  (free)(block);
+}
+
+SDL_Surface* trackedSurface(SDL_Surface* surface, char* file, int line) {
+  if (!surface)
+    return NULL;
+
+  SDL_AtomicLock(&alloc_lock);
+  AllocSite* site = allocSite(file, line);
+  site->num_allocs++;
+  site->num_bytes += surface->h * surface->pitch;
+  if (alloc_in_frame_loop && SDL_ThreadID() == alloc_main_thread) {
+    allocs_this_frame++;
+    if (!site->flagged) {
+      site->flagged = true;
+      printf("alloc: %s:%d created a %dx%d surface in the frame loop\n", file, line, surface->w, surface->h);
+    }
+  }
+  SDL_AtomicUnlock(&alloc_lock);
+  return surface;
+}
+
+// called at the top of each frame: once the game has warmed up, anything allocating in the frame loop gets flagged
+void allocFrame() {
+  if (!alloc_frame)
+    alloc_main_thread = SDL_ThreadID();
+  alloc_frame++;
+  alloc_in_frame_loop = alloc_frame > ALLOC_WARMUP_FRAMES;
+
+  allocs_last_frame = allocs_this_frame;
+  allocs_this_frame = 0;
+}
+
+int compareAllocSites(const void* a, const void* b) {
+  long long allocs_a = ((AllocSite*)a)->num_allocs;
+  long long allocs_b = ((AllocSite*)b)->num_allocs;
+  return allocs_a < allocs_b ? 1 : allocs_a > allocs_b ? -1 : 0;
+}
+
+// print the call sites by number of allocations
+void allocReport() {
+  AllocSite sites[ALLOC_SITES];
+  int len_sites = 0;
+  for (int i = 0; i < ALLOC_SITES; ++i)
+    if (alloc_sites[i].file)
+      sites[len_sites++] = alloc_sites[i];
+  qsort(sites, len_sites, sizeof(AllocSite), compareAllocSites);
+
+  printf("alloc: %lld bytes peak, %lld bytes still live\n", alloc_peak_bytes, alloc_live_bytes);
+  for (int i = 0; i < len_sites; ++i)
+    printf("alloc: %s:%d %lld allocs, %lld bytes, %lld live%s\n", sites[i].file, sites[i].line,
+      sites[i].num_allocs, sites[i].num_bytes, sites[i].live_bytes, sites[i].flagged ? " (in frame loop)" : "");
 }
+#endif
@@ -0,0 +1,285 @@
+// offscreen render benchmark, built & run w/ `make renderbench`
+// draws the game's scene (renderScene()) into memory w/ SDL's software renderer, w/ the camera on a fixed path over a stress level,
+// so render cost can be measured w/out a display, vsync or a compositor in the way
+// reports pixels/sec, SDL calls per frame & what each kind of call costs, as CSV rows (w/ the summary as # comments)
+// `./renderbench --hashes <path>` also writes a hash of every frame, so a render optimization can be checked against the frames from before it
+// (the hashes come from SDL's software rasterizer, so only compare them on the same SDL version)
+#include <stdbool.h>
+#include "SDL.h"
+#include "SDL2_gfxPrimitives.h"
+
+#define RENDER_FRAMES 600
+#define RENDER_ENTITIES 100000
+#define RENDER_SEED 1529597895u
+
+// the calls the scene makes: SDL's renderer calls & the gfx primitives the game calls directly (which make SDL calls of their own)
+#define PRIM_CLEAR          0
+#define PRIM_DRAW_COLOR     1
+#define PRIM_BLEND_MODE     2
+#define PRIM_DRAW_POINT     3
+#define PRIM_DRAW_LINE      4
+#define PRIM_DRAW_LINES     5
+#define PRIM_DRAW_RECT      6
+#define PRIM_FILL_RECT      7
+#define PRIM_FILL_RECTS     8
+#define PRIM_COPY           9
+#define PRIM_PRESENT        10
+#define PRIM_GFX            11 // the first gfx primitive
+#define PRIM_AAPOLYGON      11
+#define PRIM_FILLED_POLYGON 12
+#define PRIM_AALINE         13
+#define PRIM_BOX            14
+#define NUM_PRIMS           15
+
+typedef struct {
+  char* name;
+  long long calls;
+  Uint64 ticks;
+} Prim;
+
+Prim prims[NUM_PRIMS] = {
+  {"SDL_RenderClear"}, {"SDL_SetRenderDrawColor"}, {"SDL_SetRenderDrawBlendMode"}, {"SDL_RenderDrawPoint"},
+  {"SDL_RenderDrawLine"}, {"SDL_RenderDrawLines"}, {"SDL_RenderDrawRect"}, {"SDL_RenderFillRect"},
+  {"SDL_RenderFillRects"}, {"SDL_RenderCopy"}, {"SDL_RenderPresent"},
+  {"aapolygonColor"}, {"filledPolygonColor"}, {"aalineColor"}, {"boxColor"}
+};
+
+// counting is only on for the passes that break the frame down, & only one level of call is timed per pass,
+// so timing the gfx primitives doesn't also pay for timing every SDL call they make
+bool counting = false;
+bool timing_gfx = false;
+
+#define TIMED(prim, call) \
+  if (!counting) \
+    return call; \
+  prims[prim].calls++; \
+  if (timing_gfx != (prim >= PRIM_GFX)) \
+    return call; \
+  Uint64 start = SDL_GetPerformanceCounter(); \
+  int result = call; \
+  prims[prim].ticks += SDL_GetPerformanceCounter() - start; \
+  return result;
+
+int timedRenderClear(SDL_Renderer* renderer) {
+  TIMED(PRIM_CLEAR, SDL_RenderClear(renderer))
+}
+
+int timedSetRenderDrawColor(SDL_Renderer* renderer, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+  TIMED(PRIM_DRAW_COLOR, SDL_SetRenderDrawColor(renderer, r, g, b, a))
+}
+
+int timedSetRenderDrawBlendMode(SDL_Renderer* renderer, SDL_BlendMode mode) {
+  TIMED(PRIM_BLEND_MODE, SDL_SetRenderDrawBlendMode(renderer, mode))
+}
+
+int timedRenderDrawPoint(SDL_Renderer* renderer, int x, int y) {
+  TIMED(PRIM_DRAW_POINT, SDL_RenderDrawPoint(renderer, x, y))
+}
+
+int timedRenderDrawLine(SDL_Renderer* renderer, int x1, int y1, int x2, int y2) {
+  TIMED(PRIM_DRAW_LINE, SDL_RenderDrawLine(renderer, x1, y1, x2, y2))
+}
+
+int timedRenderDrawLines(SDL_Renderer* renderer, const SDL_Point* points, int count) {
+  TIMED(PRIM_DRAW_LINES, SDL_RenderDrawLines(renderer, points, count))
+}
+
+int timedRenderDrawRect(SDL_Renderer* renderer, const SDL_Rect* rect) {
+  TIMED(PRIM_DRAW_RECT, SDL_RenderDrawRect(renderer, rect))
+}
+
+int timedRenderFillRect(SDL_Renderer* renderer, const SDL_Rect* rect) {
+  TIMED(PRIM_FILL_RECT, SDL_RenderFillRect(renderer, rect))
+}
+
+int timedRenderFillRects(SDL_Renderer* renderer, const SDL_Rect* rects, int count) {
+  TIMED(PRIM_FILL_RECTS, SDL_RenderFillRects(renderer, rects, count))
+}
+
+int timedRenderCopy(SDL_Renderer* renderer, SDL_Texture* texture, const SDL_Rect* src, const SDL_Rect* dst) {
+  TIMED(PRIM_COPY, SDL_RenderCopy(renderer, texture, src, dst))
+}
+
+void timedRenderPresent(SDL_Renderer* renderer) {
+  if (counting)
+    prims[PRIM_PRESENT].calls++;
+  Uint64 start = SDL_GetPerformanceCounter();
+  SDL_RenderPresent(renderer);
+  if (counting && !timing_gfx)
+    prims[PRIM_PRESENT].ticks += SDL_GetPerformanceCounter() - start;
+}
+
+int timedAapolygonColor(SDL_Renderer* renderer, Sint16 x, Sint16 y, const Sint16* vx, const Sint16* vy, int n, Uint32 color) {
+  TIMED(PRIM_AAPOLYGON, aapolygonColor(renderer, x, y, vx, vy, n, color))
+}
+
+int timedFilledPolygonColor(SDL_Renderer* renderer, Sint16 x, Sint16 y, const Sint16* vx, const Sint16* vy, int n, Uint32 color) {
+  TIMED(PRIM_FILLED_POLYGON, filledPolygonColor(renderer, x, y, vx, vy, n, color))
+}
+
+int timedAalineColor(SDL_Renderer* renderer, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color) {
+  TIMED(PRIM_AALINE, aalineColor(renderer, x1, y1, x2, y2, color))
+}
+
+int timedBoxColor(SDL_Renderer* renderer, Sint16 x1, Sint16 y1, Sint16 x2, Sint16 y2, Uint32 color) {
+  TIMED(PRIM_BOX, boxColor(renderer, x1, y1, x2, y2, color))
+}
+
+// the game & the gfx code call SDL through the wrappers
+#define SDL_RenderClear timedRenderClear
+#define SDL_SetRenderDrawColor timedSetRenderDrawColor
+#define SDL_SetRenderDrawBlendMode timedSetRenderDrawBlendMode
+#define SDL_RenderDrawPoint timedRenderDrawPoint
+#define SDL_RenderDrawLine timedRenderDrawLine
+#define SDL_RenderDrawLines timedRenderDrawLines
+#define SDL_RenderDrawRect timedRenderDrawRect
+#define SDL_RenderFillRect timedRenderFillRect
+#define SDL_RenderFillRects timedRenderFillRects
+#define SDL_RenderCopy timedRenderCopy
+#define SDL_RenderPresent timedRenderPresent
+
+// & only the game calls the gfx primitives through them (the gfx code calling its own primitives is part of their cost)
+#define aapolygonColor timedAapolygonColor
+#define filledPolygonColor timedFilledPolygonColor
+#define aalineColor timedAalineColor
+#define boxColor timedBoxColor
+
+#define PLATFORMER_NO_MAIN
+#include "platformer.c"
+
+#undef aapolygonColor
+#undef filledPolygonColor
+#undef aalineColor
+#undef boxColor
+
+#include "SDL2_gfxPrimitives.c"
+#include "SDL2_rotozoom.c"
+#include "stress.c"
+
+SDL_Surface* target;
+SDL_Renderer* renderer;
+FILE* hash_file;
+
+// the camera's path: a pan from one end of the level to the other, bobbing up & down over the ground, w/ the player in the middle
+void moveCamera(int frame, int num_frames) {
+  vp.x = (long long)(level_w - vp.w) * frame / (num_frames > 1 ? num_frames - 1 : 1);
+  vp.y = level_h - vp.h - (1 - cos(frame * 2 * M_PI / 240)) * grid_size * 8;
+  if (vp.x < 0)
+    vp.x = 0;
+  if (vp.y < 0)
+    vp.y = 0;
+  world.player.x = vp.x + vp.w / 2;
+  world.player.y = vp.y + vp.h / 2;
+}
+
+int compareFrameTicks(const void* a, const void* b) {
+  Uint64 a_ticks = *(Uint64*)a;
+  Uint64 b_ticks = *(Uint64*)b;
+  return (a_ticks > b_ticks) - (a_ticks < b_ticks);
+}
+
+// draw the frames along the camera path, timing each one in frame_ticks (if it isn't NULL)
+void renderFrames(int num_frames, Uint64* frame_ticks) {
+  for (int frame = 0; frame < num_frames; ++frame) {
+    moveCamera(frame, num_frames);
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    renderScene(renderer);
+    SDL_RenderPresent(renderer);
+    if (frame_ticks)
+      frame_ticks[frame] = SDL_GetPerformanceCounter() - start;
+
+    if (hash_file) {
+      uint64_t hash = HASH_START;
+      for (int y = 0; y < target->h; ++y)
+        hash = hashBytes(hash, (byte*)target->pixels + y * target->pitch, target->w * sizeof(Uint32));
+      fprintf(hash_file, "%d %016llx\n", frame, (unsigned long long)hash);
+    }
+  }
+}
+
+int main(int num_args, char* args[]) {
+  int num_frames = RENDER_FRAMES;
+  int num_entities = RENDER_ENTITIES;
+  char* hash_path = NULL;
+  vp.w = 1920;
+  vp.h = 1080;
+  for (int i = 1; i < num_args; ++i) {
+    if (!strcmp(args[i], "--frames") && i + 1 < num_args)
+      num_frames = atoi(args[++i]);
+    else if (!strcmp(args[i], "--entities") && i + 1 < num_args)
+      num_entities = atoi(args[++i]);
+    else if (!strcmp(args[i], "--size") && i + 1 < num_args && sscanf(args[i + 1], "%dx%d", &vp.w, &vp.h) == 2)
+      i++;
+    else if (!strcmp(args[i], "--hashes") && i + 1 < num_args)
+      hash_path = args[++i];
+    else {
+      printf("usage: renderbench [--frames <n>] [--entities <n>] [--size <w>x<h>] [--hashes <path>]\n");
+      return 1;
+    }
+  }
+  if (num_frames < 1 || num_entities < 1 || vp.w < 1 || vp.h < 1)
+    error("bad renderbench arguments");
+
+  target = SDL_CreateRGBSurface(0, vp.w, vp.h, 32, 0xff, 0xff00, 0xff0000, 0xff000000);
+  renderer = target ? SDL_CreateSoftwareRenderer(target) : NULL;
+  if (!renderer)
+    error("creating software renderer");
+  if (SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND) < 0)
+    error("setting blend mode");
+  palette_y = vp.h - palette_color_size;
+  stressLevel(num_entities, RENDER_SEED);
+
+  if (hash_path) {
+    hash_file = fopen(hash_path, "w");
+    if (!hash_file)
+      error("opening frame hashes");
+  }
+
+  // a plain pass for the frame times & pixels/sec (& the hashes), then a pass each timing the SDL calls & the gfx primitives
+  Uint64* frame_ticks = (Uint64*)malloc(num_frames * sizeof(Uint64));
+  renderFrames(num_frames, frame_ticks);
+  if (hash_file)
+    fclose(hash_file);
+  hash_file = NULL;
+
+  counting = true;
+  renderFrames(num_frames, NULL);
+  timing_gfx = true;
+  renderFrames(num_frames, NULL);
+  counting = false;
+
+  Uint64 total_ticks = 0;
+  for (int i = 0; i < num_frames; ++i)
+    total_ticks += frame_ticks[i];
+  qsort(frame_ticks, num_frames, sizeof(Uint64), compareFrameTicks);
+  double ticks_per_ms = SDL_GetPerformanceFrequency() / 1000.0;
+  double frame_ms = total_ticks / ticks_per_ms / num_frames;
+
+  // each kind of call was counted twice (once per breakdown pass)
+  long long sdl_calls = 0;
+  for (int i = 0; i < PRIM_GFX; ++i)
+    sdl_calls += prims[i].calls / 2;
+
+  printf("# %d frames of %dx%d over %d entities: %.3f ms/frame avg, %.3f ms p99, %.3f ms max\n", num_frames, vp.w, vp.h, len_entities,
+    frame_ms, frame_ticks[num_frames * 99 / 100] / ticks_per_ms, frame_ticks[num_frames - 1] / ticks_per_ms);
+  printf("# %.1f Mpixels/sec, %.1f SDL calls/frame\n", (double)vp.w * vp.h * num_frames / (total_ticks / ticks_per_ms / 1000) / 1e6,
+    (double)sdl_calls / num_frames);
+  if (hash_path)
+    printf("# frame hashes written to %s\n", hash_path);
+
+  // ms_per_frame is each call's share of the frame (the gfx primitives' includes the SDL calls they make)
+  printf("call,calls_per_frame,ns_per_call,ms_per_frame,pct_of_frame\n");
+  for (int i = 0; i < NUM_PRIMS; ++i) {
+    long long calls = prims[i].calls / 2;
+    if (!calls)
+      continue;
+    double ms = prims[i].ticks / ticks_per_ms / num_frames;
+    printf("%s,%.1f,%.1f,%.4f,%.1f\n", prims[i].name, (double)calls / num_frames, ms * 1e6 * num_frames / calls, ms, ms / frame_ms * 100);
+  }
+
+  free(frame_ticks);
+  SDL_DestroyRenderer(renderer);
+  SDL_FreeSurface(target);
+  return 0;
+}
@@ -0,0 +1,132 @@
+// seeded stress levels for the tools (bench.c, perfcheck.c), which include this after platformer.c
+// the same seed makes the same level everywhere
+uint32_t stress_rng;
+
+uint32_t stressRand() {
+  // xorshift32, so levels don't depend on the platform's rand()
+  stress_rng ^= stress_rng << 13;
+  stress_rng ^= stress_rng >> 17;
+  stress_rng ^= stress_rng << 5;
+  return stress_rng;
+}
+
+// how often each kind of entity turns up, as 1 in <n> columns of the level (0 for never), the rest being ground tiles
+// the default mix is what bench & the perfcheck sessions were measured on, so changing it changes their levels
+typedef struct {
+  int platforms;
+  int polygons;
+  int enemies;
+  int portals;
+  int triggers; // lava, checkpoints, reverse gravity & finishes
+  int max_vertices; // freehand polygons get 8 up to this many vertices
+} StressMix;
+
+StressMix stress_mix = { .platforms = 4, .polygons = 16, .enemies = 32, .max_vertices = 47 };
+
+byte trigger_types[] = {LAVA, CHECKPOINT, REVERSE_GRAV, FINISH};
+byte trigger_colors[] = {27, 9, 6, 19};
+
+// whether the next column gets one of a kind of entity that turns up 1 in odds columns
+bool stressChance(int odds) {
+  return odds && stressRand() % odds == 0;
+}
+
+// fill the level w/ about num_entities entities (in the proportions stress_mix says), laid out roughly like a hand-drawn level:
+// ground & platforms of tiles, some freehand polygons, enemies walking around & portals & triggers on the ground
+void stressLevel(int num_entities, uint32_t seed) {
+  for (int i = 0; i < len_entities; ++i)
+    freeEntity(&entities[i]);
+  memset(entities, 0, max_entities * sizeof(Entity));
+  len_entities = 0;
+  freeBoxes(&box_index);
+  free(chunks);
+
+  stress_rng = seed;
+  chunk_px = grid_size * CHUNK_TILES;
+  int tiles_h = 200;
+  int tiles_w = num_entities / 20 + CHUNK_TILES;
+  level_w = tiles_w * grid_size;
+  level_h = tiles_h * grid_size;
+  chunks_w = level_w / chunk_px + 1;
+  chunks_h = level_h / chunk_px + 1;
+  chunks = (Chunk*)calloc(chunks_w * chunks_h, sizeof(Chunk));
+
+  int x = 0;
+  while (len_entities < num_entities) {
+    // ground, w/ a platform above it now & then
+    int ground_y = tiles_h - 4 - stressRand() % 8;
+    for (int y = ground_y; y < tiles_h && len_entities < num_entities; ++y)
+      addRectPoints(&createEntity(0, 16 + y % 2, x * grid_size, y * grid_size, grid_size, grid_size)->shapes[0], 0, 0, grid_size, grid_size);
+
+    if (stressChance(stress_mix.platforms)) {
+      int platform_y = ground_y - 4 - stressRand() % 20;
+      for (int y = platform_y; y < platform_y + 2 && len_entities < num_entities; ++y)
+        addRectPoints(&createEntity(0, 11, x * grid_size, y * grid_size, grid_size, grid_size)->shapes[0], 0, 0, grid_size, grid_size);
+    }
+
+    if (stressChance(stress_mix.polygons) && len_entities < num_entities) {
+      Entity* ent = createEntity(0, stressRand() % 32, x * grid_size, (ground_y - 6) * grid_size, 0, 0);
+      int num_points = 8 + stressRand() % (stress_mix.max_vertices - 7);
+      for (int i = 0; i < num_points; ++i)
+        addPoint(&ent->shapes[0], stressRand() % 120, stressRand() % 120);
+      updateEntityBBox(ent);
+    }
+
+    if (stressChance(stress_mix.enemies) && len_entities < num_entities) {
+      Entity* ent = createEntity(ENEMY, 27, x * grid_size, (ground_y - 1) * grid_size, grid_size, grid_size);
+      addRectPoints(&ent->shapes[0], 0, 0, grid_size, grid_size);
+      fillShape(&ent->shapes[0]);
+      ent->dx = 1.5;
+      ent->grav_y = 0.1;
+    }
+
+    if (stressChance(stress_mix.portals) && len_entities < num_entities) {
+      Entity* ent = createEntity(PORTAL, 29, x * grid_size, (ground_y - 2) * grid_size, grid_size, grid_size);
+      addRectPoints(&ent->shapes[0], 0, 0, grid_size, grid_size);
+      fillShape(&ent->shapes[0]);
+    }
+
+    if (stressChance(stress_mix.triggers) && len_entities < num_entities) {
+      int type = stressRand() % sizeof(trigger_types);
+      Entity* ent = createEntity(trigger_types[type], trigger_colors[type], x * grid_size, (ground_y - 1) * grid_size, grid_size, grid_size);
+      addRectPoints(&ent->shapes[0], 0, 0, grid_size, grid_size);
+      fillShape(&ent->shapes[0]);
+    }
+
+    x = (x + 1) % tiles_w;
+  }
+}
+
+// write the generated level to path in the game's save format, then free it
+void saveStressLevel(char* path) {
+  int num_chunks = chunks_w * chunks_h;
+  ChunkMsg msg = {
+    .type = CHUNK_SAVE,
+    .len_entities = len_entities,
+    .entities = entities,
+    .len_resident = num_chunks,
+    .len_chunk_ixs = num_chunks,
+    .chunk_ixs = (int*)malloc(num_chunks * sizeof(int)),
+    .copied_ix = -1,
+    .generation = 0,
+    .level_flags = wake_reset ? LEVEL_WAKE_RESET : 0
+  };
+  for (int c = 0; c < num_chunks; ++c)
+    msg.chunk_ixs[c] = c;
+  level_path = path;
+  writeLevel(&msg);
+  free(msg.chunk_ixs);
+  if (msg.failure)
+    error(msg.failure);
+
+  fclose(chunk_file);
+  chunk_file = NULL;
+  for (int i = 0; i < len_entities; ++i)
+    freeEntity(&entities[i]);
+  free(entities);
+  free(chunks);
+  freeBoxes(&box_index);
+  entities = NULL;
+  chunks = NULL;
+  len_entities = max_entities = 0;
+}
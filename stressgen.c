@@ -0,0 +1,74 @@
+// writes a seeded stress level (see stress.c) in the game's save format, built w/ `make stressgen`
+// `./stressgen big.level4 --entities 1000000 --portals 64 --triggers 32` & then `./platformer --level big.level4` plays it,
+// renderbench & perfcheck measure the same levels, & small ones (`--entities 200 --uncompressed`) make good seeds for the fuzzer's corpus
+// (`--wake-reset` sets the level's wake policy, see LEVEL_WAKE_RESET)
+// the same arguments always write the same file
+#define PLATFORMER_NO_MAIN
+#include "platformer.c"
+#include "stress.c"
+
+#define STRESSGEN_SEED 1529597895u
+
+int countFlag(byte flag) {
+  int count = 0;
+  for (int i = 0; i < len_entities; ++i)
+    if (entities[i].flags & flag)
+      count++;
+  return count;
+}
+
+int main(int num_args, char* args[]) {
+  char* path = NULL;
+  int num_entities = 100000;
+  uint32_t seed = STRESSGEN_SEED;
+  bool bad_args = false;
+  for (int i = 1; i < num_args; ++i) {
+    bool has_value = i + 1 < num_args;
+    if (!strcmp(args[i], "--entities") && has_value)
+      num_entities = atoi(args[++i]);
+    else if (!strcmp(args[i], "--seed") && has_value)
+      seed = strtoul(args[++i], NULL, 10);
+    else if (!strcmp(args[i], "--platforms") && has_value)
+      stress_mix.platforms = atoi(args[++i]);
+    else if (!strcmp(args[i], "--polygons") && has_value)
+      stress_mix.polygons = atoi(args[++i]);
+    else if (!strcmp(args[i], "--enemies") && has_value)
+      stress_mix.enemies = atoi(args[++i]);
+    else if (!strcmp(args[i], "--portals") && has_value)
+      stress_mix.portals = atoi(args[++i]);
+    else if (!strcmp(args[i], "--triggers") && has_value)
+      stress_mix.triggers = atoi(args[++i]);
+    else if (!strcmp(args[i], "--max-vertices") && has_value)
+      stress_mix.max_vertices = atoi(args[++i]);
+    else if (!strcmp(args[i], "--uncompressed"))
+      compress_level = false;
+    else if (!strcmp(args[i], "--wake-reset"))
+      wake_reset = true;
+    else if (args[i][0] != '-' && !path)
+      path = args[i];
+    else
+      bad_args = true;
+  }
+  if (bad_args || !path || num_entities < 1 || stress_mix.platforms < 0 || stress_mix.polygons < 0 || stress_mix.enemies < 0 ||
+    stress_mix.portals < 0 || stress_mix.triggers < 0 || stress_mix.max_vertices < 8 || stress_mix.max_vertices > MAX_VERTICES) {
+    printf("usage: stressgen <path> [--entities <n>] [--seed <n>] [--platforms <1 in n columns>] [--polygons <1 in n>] [--enemies <1 in n>]\n");
+    printf("  [--portals <1 in n>] [--triggers <1 in n>] [--max-vertices <8 to %d>] [--uncompressed] [--wake-reset]\n", MAX_VERTICES);
+    printf("(0 leaves a kind of entity out, the defaults are bench's mix: platforms 4, polygons 16, enemies 32, no portals or triggers)\n");
+    return 1;
+  }
+
+  Uint64 start = SDL_GetPerformanceCounter();
+  stressLevel(num_entities, seed);
+  double gen_secs = (SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+
+  printf("%s: %d entities over %dx%d tiles (%d enemies, %d portals, %d lava, %d checkpoints, %d reverse gravity, %d finishes)\n",
+    path, len_entities, level_w / grid_size, level_h / grid_size, countFlag(ENEMY), countFlag(PORTAL), countFlag(LAVA),
+    countFlag(CHECKPOINT), countFlag(REVERSE_GRAV), countFlag(FINISH));
+
+  start = SDL_GetPerformanceCounter();
+  saveStressLevel(path);
+  double save_secs = (SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+
+  printf("generated in %.2f s, saved in %.2f s\n", gen_secs, save_secs);
+  return 0;
+}
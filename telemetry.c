@@ -0,0 +1,191 @@
+// watches a running game's live telemetry (see telemetry.h), built w/ `make telemetry`
+// start the game w/ `--telemetry`, then `./telemetry` prints a line of stats a second, from another terminal
+// `--log <path>` also writes a CSV row for every frame it sees (it polls every millisecond, so at high frame rates
+// some frames are missed: the frame column says which ones it got), `--interval <ms>` changes how often it prints
+// & `--name </name>` reads a game started w/ `--telemetry </name>`
+// the game never waits for this: it reads under the block's seqlock, retrying if the game wrote in the middle of a copy
+#ifdef _WIN32
+#error "telemetry uses POSIX shared memory"
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "SDL.h"
+#include "telemetry.h"
+
+// the mapping's read-only & SDL_AtomicGet() can be a locked read-modify-write (which would fault), so seq is read as a plain aligned int
+int readSeq(Telemetry* shared) {
+  int seq = *(volatile int*)&shared->seq.value;
+  SDL_MemoryBarrierAcquire();
+  return seq;
+}
+
+// the game's segment outlives it in our mapping, so check it's still running
+bool gameRunning(unsigned int pid) {
+  return !(kill(pid, 0) < 0 && errno == ESRCH);
+}
+
+// a consistent copy of the block
+// returns false if the game exited (e.g. it died mid-write, leaving seq odd for good)
+bool readTelemetry(Telemetry* shared, Telemetry* copy) {
+  for (int tries = 1; ; ++tries) {
+    // a write takes microseconds, so after a while back off & make sure there's still a game doing it
+    if (tries % 1000 == 0) {
+      if (!gameRunning(shared->pid)) // (pid's set before the magic & never changes)
+        return false;
+      SDL_Delay(1);
+    }
+    int seq = readSeq(shared);
+    if (seq & 1)
+      continue;
+    memcpy(copy, shared, sizeof(Telemetry));
+    SDL_MemoryBarrierAcquire();
+    if (readSeq(shared) == seq)
+      return true;
+  }
+}
+
+Telemetry* openTelemetry(char* name) {
+  bool said_waiting = false;
+  while (true) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd >= 0) {
+      Telemetry* shared = (Telemetry*)mmap(NULL, sizeof(Telemetry), PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);
+      if (shared == MAP_FAILED) {
+        printf("mapping %s failed: %s\n", name, strerror(errno));
+        exit(1);
+      }
+      // the game fills in the block before it sets the magic
+      if (shared->magic == TELEMETRY_MAGIC) {
+        SDL_MemoryBarrierAcquire();
+        return shared;
+      }
+      munmap(shared, sizeof(Telemetry));
+    }
+
+    if (!said_waiting)
+      printf("waiting for a game w/ --telemetry (%s)\n", name);
+    said_waiting = true;
+    SDL_Delay(500);
+  }
+}
+
+int main(int num_args, char* args[]) {
+  char* name = TELEMETRY_NAME;
+  char* log_path = NULL;
+  int interval_ms = 1000;
+  for (int i = 1; i < num_args; ++i) {
+    if (!strcmp(args[i], "--name") && i + 1 < num_args)
+      name = args[++i];
+    else if (!strcmp(args[i], "--log") && i + 1 < num_args)
+      log_path = args[++i];
+    else if (!strcmp(args[i], "--interval") && i + 1 < num_args)
+      interval_ms = atoi(args[++i]);
+    else {
+      printf("usage: telemetry [--name </name>] [--log <path>] [--interval <ms>]\n");
+      return 1;
+    }
+  }
+  if (interval_ms < 1)
+    interval_ms = 1;
+  setvbuf(stdout, NULL, _IOLBF, 0); // a line at a time, even into a pipe or a file
+
+  Telemetry* shared = openTelemetry(name);
+  Telemetry now;
+  if (!readTelemetry(shared, &now)) {
+    printf("the game (pid %u) exited\n", shared->pid);
+    return 1;
+  }
+  if (now.version != TELEMETRY_VERSION) {
+    printf("%s is telemetry version %u, this reads version %d\n", name, now.version, TELEMETRY_VERSION);
+    return 1;
+  }
+  int num_phases = now.num_phases < TELEMETRY_PHASES ? now.num_phases : TELEMETRY_PHASES;
+  printf("watching pid %u (%s%s)\n", now.pid,
+    now.flags & TELEMETRY_PROFILE ? "w/ phase times" : "w/out phase times (built w/ PROFILE=0 or run w/ --threaded)",
+    now.flags & TELEMETRY_ALLOCS ? ", heap stats" : "");
+
+  FILE* log_file = NULL;
+  if (log_path) {
+    log_file = fopen(log_path, "w");
+    if (!log_file) {
+      printf("opening %s failed: %s\n", log_path, strerror(errno));
+      return 1;
+    }
+    fprintf(log_file, "frame,frame_ms");
+    for (int phase = 1; phase < num_phases; ++phase) // (phase 0 is the whole frame)
+      fprintf(log_file, ",%s_ms", now.phase_names[phase]);
+    fprintf(log_file, ",entities,resident_chunks,chunk_msgs_out,collide_queries,collide_tests,player_x,player_y,paused,allocs,heap_live_bytes,heap_peak_bytes\n");
+  }
+
+  // what's printed is over the frames seen since the last line
+  uint64_t last_frame = now.frame;
+  uint64_t interval_start_frame = now.frame;
+  int seen = 0;
+  float total_ms = 0;
+  float max_ms = 0;
+  Uint32 interval_start = SDL_GetTicks();
+  while (true) {
+    SDL_Delay(1);
+    if (!readTelemetry(shared, &now)) {
+      printf("the game (pid %u) exited after %llu frames\n", now.pid, (unsigned long long)now.frame);
+      break;
+    }
+    if (now.frame != last_frame) {
+      last_frame = now.frame;
+      seen++;
+      total_ms += now.frame_ms;
+      if (now.frame_ms > max_ms)
+        max_ms = now.frame_ms;
+
+      if (log_file) {
+        fprintf(log_file, "%llu,%.3f", (unsigned long long)now.frame, now.frame_ms);
+        for (int phase = 1; phase < num_phases; ++phase)
+          fprintf(log_file, ",%.3f", now.phase_ms[phase]);
+        fprintf(log_file, ",%d,%d,%d,%d,%d,%d,%d,%d,%d,%lld,%lld\n", now.len_entities, now.resident_chunks, now.chunk_msgs_out,
+          now.collide_queries, now.collide_tests, now.player_x, now.player_y, now.paused, now.allocs_last_frame,
+          (long long)now.heap_live_bytes, (long long)now.heap_peak_bytes);
+      }
+    }
+
+    if (SDL_GetTicks() - interval_start < (Uint32)interval_ms)
+      continue;
+
+    if (!gameRunning(now.pid)) {
+      printf("the game (pid %u) exited after %llu frames\n", now.pid, (unsigned long long)now.frame);
+      break;
+    }
+
+    float secs = (SDL_GetTicks() - interval_start) / 1000.0;
+    printf("frame %llu: %.0f fps, %.2f ms avg, %.2f ms max", (unsigned long long)now.frame, (now.frame - interval_start_frame) / secs,
+      seen ? total_ms / seen : 0, max_ms);
+    if (now.flags & TELEMETRY_PROFILE)
+      printf(", %d collides, %d box tests", now.collide_queries, now.collide_tests);
+    printf(", %d entities, %d chunks", now.len_entities, now.resident_chunks);
+    if (now.flags & TELEMETRY_ALLOCS)
+      printf(", %lld KB heap (%lld KB peak), %d allocs", (long long)now.heap_live_bytes / 1024, (long long)now.heap_peak_bytes / 1024,
+        now.allocs_last_frame);
+    printf("%s\n", now.paused ? " (paused)" : "");
+    if (log_file)
+      fflush(log_file);
+
+    interval_start = SDL_GetTicks();
+    interval_start_frame = now.frame;
+    seen = 0;
+    total_ms = 0;
+    max_ms = 0;
+  }
+
+  if (log_file)
+    fclose(log_file);
+  munmap(shared, sizeof(Telemetry));
+  return 0;
+}
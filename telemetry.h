@@ -0,0 +1,46 @@
+// live telemetry: w/ `--telemetry`, the game publishes a Telemetry block into a POSIX shared memory segment every frame,
+// for tools like `telemetry.c` to read from another process w/out ever blocking the game
+// the block's updated under a seqlock: seq is odd while the game's writing, so readers copy the block & retry if seq was odd or changed
+// the layout only ever grows at the end (& bumps TELEMETRY_VERSION when it does)
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "SDL.h"
+
+#define TELEMETRY_NAME "/platformer" // the default segment name
+#define TELEMETRY_MAGIC 0x4d544c50 // "PLTM"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_PHASES 10
+
+// which parts of the block the game was built to fill in
+#define TELEMETRY_PROFILE 0x1 // the phase times & collision counts (PROFILE, w/out --threaded)
+#define TELEMETRY_ALLOCS  0x2 // the heap stats (TRACK_ALLOCS)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  SDL_atomic_t seq;
+  uint32_t pid; // the game's, so readers can tell when it's gone
+  uint32_t flags;
+  uint32_t num_phases;
+  char phase_names[TELEMETRY_PHASES][12];
+
+  // the last finished frame
+  uint64_t frame;
+  float frame_ms;
+  float phase_ms[TELEMETRY_PHASES];
+  int32_t len_entities;
+  int32_t resident_chunks;
+  int32_t chunk_msgs_out; // requests the chunk loader hasn't answered yet
+  int32_t collide_queries;
+  int32_t collide_tests;
+  int32_t player_x;
+  int32_t player_y;
+  int32_t allocs_last_frame;
+  int32_t paused;
+  int64_t heap_live_bytes;
+  int64_t heap_peak_bytes;
+} Telemetry;
+
+#endif